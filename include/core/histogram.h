@@ -0,0 +1,84 @@
+#ifndef KVM_CORE_HISTOGRAM_H
+#define KVM_CORE_HISTOGRAM_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace kvm {
+  /**
+   * Fixed-size histogram of unsigned values with log-linear buckets: each power of two is split into
+   * eight equal buckets, so any recorded value can be reported to within 12.5% while the histogram
+   * stays a few kilobytes regardless of how many values it holds. Recording never allocates.
+   */
+  class Histogram {
+  public:
+
+    /**
+     * Default Constructor
+     */
+    Histogram();
+
+    /**
+     * Record a value.
+     */
+    void Record(uint64_t value);
+
+    /**
+     * Discard all recorded values.
+     */
+    void Clear();
+
+    /**
+     * Get the number of values recorded.
+     */
+    uint64_t GetCount() const;
+
+    /**
+     * Get the smallest and largest values recorded, or zero if none have been.
+     */
+    uint64_t GetMin() const;
+    uint64_t GetMax() const;
+
+    /**
+     * Get the mean of the values recorded, or zero if none have been.
+     */
+    double GetMean() const;
+
+    /**
+     * Get an upper bound on the given percentile (0 to 100) of the values recorded, or zero if none
+     * have been.
+     */
+    uint64_t GetPercentile(double percentile) const;
+
+  private:
+
+    /// Each power of two is divided into 2^SubBucketBits buckets
+    static const unsigned SubBucketBits = 3;
+    static const unsigned SubBucketCount = 1 << SubBucketBits;
+    static const size_t BucketCount = SubBucketCount + (64 - SubBucketBits) * SubBucketCount;
+
+    /**
+     * Get the index of the bucket that holds the given value.
+     */
+    static size_t BucketFor(uint64_t value);
+
+    /**
+     * Get the largest value held by the given bucket.
+     */
+    static uint64_t BucketUpperBound(size_t bucket);
+
+    /// Number of values in each bucket
+    std::array<uint64_t, BucketCount> m_buckets;
+    /// Number of values recorded
+    uint64_t m_count;
+    /// Sum of values recorded
+    double m_sum;
+    /// Smallest value recorded
+    uint64_t m_min;
+    /// Largest value recorded
+    uint64_t m_max;
+  };
+}
+
+#endif // KVM_CORE_HISTOGRAM_H
\ No newline at end of file
@@ -0,0 +1,166 @@
+#ifndef KVM_CORE_SLOT_MAP_H
+#define KVM_CORE_SLOT_MAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace kvm {
+  /**
+   * Owns a set of objects and hands out handles to them. A handle pairs a slot index with the slot's
+   * generation, which is bumped whenever the slot is emptied, so a handle to an erased object never
+   * resolves to whatever reuses its slot. Objects are held by pointer and never copied or moved once
+   * inserted, and lookup by handle or by object is constant time.
+   */
+  template<typename T>
+  class SlotMap {
+    struct Slot {
+      std::unique_ptr<T>  value;
+      uint32_t            generation;
+    };
+
+  public:
+
+    struct Handle {
+      /// Slot that the object occupies
+      uint32_t index;
+      /// Generation of the slot when the object was inserted
+      uint32_t generation;
+
+      bool operator==(const Handle& other) const { return index == other.index && generation == other.generation; }
+      bool operator!=(const Handle& other) const { return !(*this == other); }
+      bool operator<(const Handle& other) const { return index < other.index || (index == other.index && generation < other.generation); }
+
+      struct Hash {
+        size_t operator()(const Handle& handle) const { return std::hash<uint64_t>()((static_cast<uint64_t>(handle.generation) << 32) | handle.index); }
+      };
+    };
+
+    /**
+     * Visits occupied slots in index order. Inserting invalidates iterators; erasing doesn't.
+     */
+    template<typename Value>
+    class Iterator {
+    public:
+
+      Iterator(Value* slots, size_t index, size_t count) :
+      m_slots(slots),
+      m_index(index),
+      m_count(count) {
+        SkipEmpty();
+      }
+
+      auto& operator*() const { return *m_slots[m_index].value; }
+      auto* operator->() const { return m_slots[m_index].value.get(); }
+      Handle GetHandle() const { return Handle{static_cast<uint32_t>(m_index), m_slots[m_index].generation}; }
+
+      Iterator& operator++() {
+        m_index++;
+        SkipEmpty();
+        return *this;
+      }
+
+      bool operator!=(const Iterator& other) const { return m_index != other.m_index; }
+
+    private:
+
+      void SkipEmpty() {
+        while(m_index < m_count && !m_slots[m_index].value) {
+          m_index++;
+        }
+      }
+
+      Value* m_slots;
+      size_t m_index;
+      size_t m_count;
+    };
+
+    /**
+     * Take ownership of an object and return its handle. Reuses the most recently emptied slot.
+     */
+    Handle Insert(std::unique_ptr<T> value) {
+      uint32_t index;
+      if(m_free.empty()) {
+        index = static_cast<uint32_t>(m_slots.size());
+        m_slots.push_back(Slot{nullptr, 0});
+      } else {
+        index = m_free.back();
+        m_free.pop_back();
+      }
+
+      auto& slot = m_slots[index];
+      m_handles[value.get()] = Handle{index, slot.generation};
+      slot.value = std::move(value);
+      m_size++;
+      return Handle{index, slot.generation};
+    }
+
+    /**
+     * Get the object with the given handle, or nullptr if it has been erased.
+     */
+    T* Get(Handle handle) const {
+      if(handle.index >= m_slots.size() || m_slots[handle.index].generation != handle.generation) {
+        return nullptr;
+      }
+      return m_slots[handle.index].value.get();
+    }
+
+    /**
+     * Get the handle of an object held by this map, or nothing if it isn't held here.
+     */
+    std::optional<Handle> Find(const T& value) const {
+      auto it = m_handles.find(&value);
+      if(it == m_handles.end()) {
+        return std::nullopt;
+      }
+      return it->second;
+    }
+
+    /**
+     * Destroy the object with the given handle. Returns false if it had already been erased.
+     */
+    bool Erase(Handle handle) {
+      auto value = Get(handle);
+      if(value == nullptr) {
+        return false;
+      }
+
+      auto& slot = m_slots[handle.index];
+      m_handles.erase(value);
+      slot.value.reset();
+      slot.generation++;
+      m_free.push_back(handle.index);
+      m_size--;
+      return true;
+    }
+
+    /**
+     * Get the number of objects held.
+     */
+    size_t Size() const {
+      return m_size;
+    }
+
+    Iterator<Slot> begin() { return Iterator<Slot>(m_slots.data(), 0, m_slots.size()); }
+    Iterator<Slot> end() { return Iterator<Slot>(m_slots.data(), m_slots.size(), m_slots.size()); }
+    Iterator<const Slot> begin() const { return Iterator<const Slot>(m_slots.data(), 0, m_slots.size()); }
+    Iterator<const Slot> end() const { return Iterator<const Slot>(m_slots.data(), m_slots.size(), m_slots.size()); }
+
+  private:
+
+    /// Slots, occupied or not
+    std::vector<Slot> m_slots;
+    /// Indices of empty slots
+    std::vector<uint32_t> m_free;
+    /// Handle of each held object, by address
+    std::unordered_map<const T*, Handle> m_handles;
+    /// Number of occupied slots
+    size_t m_size = 0;
+  };
+}
+
+#endif // KVM_CORE_SLOT_MAP_H
\ No newline at end of file
@@ -0,0 +1,77 @@
+#ifndef KVM_CORE_SPSC_RING_H
+#define KVM_CORE_SPSC_RING_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+namespace kvm {
+  /**
+   * Fixed-capacity queue that passes values from exactly one producer thread to exactly one consumer
+   * thread without locks. Each side only writes its own index and reads the other's, so pushing and
+   * popping never wait on each other; a full ring makes TryPush() fail rather than block.
+   */
+  template<typename T, size_t Capacity>
+  class SpscRing {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Ring capacity must be a power of two");
+
+  public:
+
+    SpscRing() :
+    m_head(0),
+    m_tail(0)
+    {}
+
+    /**
+     * Add a value to the ring. Producer thread only. Returns false, leaving the value untouched, if the
+     * ring is full.
+     */
+    bool TryPush(T&& value) {
+      auto tail = m_tail.load(std::memory_order_relaxed);
+      if(tail - m_head.load(std::memory_order_acquire) == Capacity) {
+        return false;
+      }
+
+      m_slots[tail & (Capacity - 1)] = std::move(value);
+      m_tail.store(tail + 1, std::memory_order_release);
+      return true;
+    }
+
+    /**
+     * Take the oldest value from the ring. Consumer thread only. Returns false if the ring is empty.
+     */
+    bool TryPop(T& value) {
+      auto head = m_head.load(std::memory_order_relaxed);
+      if(head == m_tail.load(std::memory_order_acquire)) {
+        return false;
+      }
+
+      value = std::move(m_slots[head & (Capacity - 1)]);
+      m_head.store(head + 1, std::memory_order_release);
+      return true;
+    }
+
+    /**
+     * Determine whether the ring is empty. Exact on the consumer thread; elsewhere the answer may be
+     * out of date by the time it's returned.
+     */
+    bool IsEmpty() const {
+      return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+    }
+
+  private:
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    /// Index of the next value to pop. Written by the consumer only.
+    alignas(64) std::atomic<size_t> m_head;
+    /// Index of the next slot to push into. Written by the producer only.
+    alignas(64) std::atomic<size_t> m_tail;
+    /// Values, indexed modulo the capacity
+    alignas(64) std::array<T, Capacity> m_slots;
+  };
+}
+
+#endif // KVM_CORE_SPSC_RING_H
\ No newline at end of file
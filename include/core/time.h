@@ -4,6 +4,36 @@
 #include <chrono>
 
 namespace kvm {
+  /**
+   * Monotonic clock read by every timer, deadline and timestamp in the cluster. Follows
+   * std::chrono::steady_clock unless a source has been set, which lets a simulator run clusters on
+   * virtual time. Time points are interchangeable with the steady clock's.
+   */
+  class Clock {
+  public:
+
+    typedef std::chrono::steady_clock::rep        rep;
+    typedef std::chrono::steady_clock::period     period;
+    typedef std::chrono::steady_clock::duration   duration;
+    typedef std::chrono::steady_clock::time_point time_point;
+
+    static constexpr bool is_steady = true;
+
+    /// Function that reports the current time in place of the steady clock
+    typedef time_point (*Source)();
+
+    /**
+     * Get the current time.
+     */
+    static time_point now();
+
+    /**
+     * Read the time from the given source, or from the steady clock again if it's null. Meant for
+     * simulations, which should set it before creating any cluster.
+     */
+    static void SetSource(Source source);
+  };
+
   /**
    * Utility class for spacing some actions out over time.
    */
@@ -24,7 +54,7 @@ namespace kvm {
   private:
 
     /// Last tick time
-    std::chrono::time_point<std::chrono::system_clock> m_last;
+    Clock::time_point m_last;
   };
 
 }
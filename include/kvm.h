@@ -2,14 +2,20 @@
 #define KVM_H
 
 #include <core/core.h>
+#include <core/time.h>
 #include <display/display.h>
 #include <usb/monitor.h>
 #include <usb/device.h>
 #include <networking/cluster.h>
+#include <networking/cluster_thread.h>
 
 namespace kvm {
-    class KVM : public Cluster::Listener,
-                public USBMonitor::Listener {
+    /**
+     * Ties the cluster to this machine's displays and USB devices. The cluster runs on a thread of its
+     * own once Pump() is first called, so nodes keep getting heartbeats and requests keep flowing while
+     * this thread waits on a slow monitor. Configure the KVM before the first Pump().
+     */
+    class KVM : public USBMonitor::Listener {
     public:
 
         enum class State {
@@ -24,13 +30,13 @@ namespace kvm {
             /**
              * Called when a new node connects to the cluster or we establish a connection to a node.
              */
-            virtual void OnNodeConnected(const Node& node)
+            virtual void OnNodeConnected(const NodeSummary& node)
             {}
 
             /**
              * Called when a node disconnects from the cluster or times out.
              */
-            virtual void OnNodeDisconnected(const Node& node)
+            virtual void OnNodeDisconnected(const NodeSummary& node)
             {}
 
             /**
@@ -48,7 +54,7 @@ namespace kvm {
             /**
              * Called when a connected node requests a set of display input changes from us.
              */
-            virtual void OnDisplayInputChangeRequestReceived(const Node& sender, const Display::InputMap& changes)
+            virtual void OnDisplayInputChangeRequestReceived(const NodeSummary& sender, const Display::InputMap& changes)
             {}
 
             /**
@@ -56,6 +62,13 @@ namespace kvm {
              */
             virtual void OnDisplayInputChangesRequested(const Display::InputMap& changes)
             {}
+
+            /**
+             * Called when every connected node has responded to our display input change request, or the
+             * request has failed. Latency covers the time from sending the request to the last response.
+             */
+            virtual void OnDisplayInputChangesCompleted(bool succeeded, std::chrono::microseconds latency)
+            {}
         };
 
         /**
@@ -94,12 +107,60 @@ namespace kvm {
          */
         void SetTriggerDevice(const USBDevice& device);
 
+        /**
+         * Set the ID that this machine presents to cluster nodes. Should be stable across restarts; see
+         * NodeIdentity::LoadOrCreate().
+         */
+        void SetNodeId(NodeId id);
+
+        /**
+         * Set how often heartbeats are sent to cluster nodes and how readily a silent node is declared
+         * failed.
+         */
+        void SetFailureDetection(const FailureDetector::Settings& settings);
+
+        /**
+         * Set how long to hold display input change requests so that requests made in quick succession,
+         * such as from a bouncing trigger device, reach nodes as one.
+         */
+        void SetCoalesceWindow(std::chrono::milliseconds window);
+
+        /**
+         * Set how long a machine that switches this machine's displays keeps them before another may
+         * switch them, so that two desks triggered at once don't fight over the monitors. Zero lets
+         * every request through.
+         */
+        void SetLeaseDuration(std::chrono::milliseconds duration);
+
         /**
          * Add a node to the KVM cluster. This machine will request display input changes by communicating with
          * cluster nodes.
          */
         void AddNode(const std::string& hostname, uint16_t port);
 
+        /**
+         * Send display input change requests to cluster nodes over multicast, joining each of the given
+         * groups on the given port. Nodes that don't acknowledge a request are sent it over TCP instead.
+         */
+        bool EnableMulticast(uint16_t port, const std::vector<std::string>& groups);
+
+        /**
+         * Find cluster nodes on the local subnet by broadcasting beacons on the given port, and connect to
+         * nodes as they're discovered. Beacons advertise this machine's displays.
+         */
+        bool EnableDiscovery(uint16_t port);
+
+        /**
+         * Record the traffic to and from every cluster node in the given file, which kvm_replay can play
+         * back. Must be called before the first Pump().
+         */
+        bool EnableCapture(const std::string& path);
+
+        /**
+         * Get round-trip time, traffic and liveness telemetry for the link to each cluster node.
+         */
+        std::vector<LinkStatistics> GetLinkStatistics() const;
+
         /**
          * Add an event listener.
          */
@@ -111,9 +172,16 @@ namespace kvm {
         void RemoveListener(Listener* listener);
 
         /**
-         * Watch for USB events and react to messages from connected nodes.
+         * Watch for USB events and react to messages from connected nodes. Waits up to the given duration,
+         * or the USB polling interval if that's shorter, for cluster events before returning. Starts the
+         * cluster thread on the first call.
+         */
+        void Pump(std::chrono::milliseconds timeout = std::chrono::milliseconds(0));
+
+        /**
+         * Destructor. Stops the cluster thread.
          */
-        void Pump();
+        ~KVM();
 
         /**
          * Called when a USB device is connected to this computer.
@@ -125,27 +193,27 @@ namespace kvm {
          */
         virtual void OnDeviceDisconnected(const kvm::USBDevice& device) override;
 
+    private:
+
         /**
-         * Called when a new node connects to the cluster or we establish a connection to a node.
+         * React to an event from the cluster thread.
          */
-        virtual void OnNodeConnected(const Node& node) override;
+        void OnClusterEvent(const ClusterThread::Event& event);
 
         /**
-         * Called when a node disconnects from the cluster or times out.
+         * Apply the input changes that a node requested and send it the results.
          */
-        virtual void OnNodeDisconnected(const Node& node) override;
+        void OnInputChangeRequested(const ClusterThread::Event& event);
 
         /**
-         * Called when a connected node requests an input change.
+         * Tell the cluster which displays are attached, if they've changed since it was last told.
          */
-        virtual void OnInputChangeRequested(const Node& sender, const Display::InputMap& changes) override;
+        void UpdateDisplays(const std::vector<Display>& displays);
 
         /**
-         * Called when we receive an input change response from a node.
+         * Called when every node has responded to one of our input change requests, or it has failed.
          */
-        virtual void OnInputChangeResponse(const Node& sender, const std::map<Display, bool>& results) override;
-
-    private:
+        void OnInputChangeCompleted(ChangeInputRequest::RequestId id, bool succeeded, std::chrono::microseconds latency);
 
         /**
          * Change the object state and inform listeners.
@@ -156,8 +224,14 @@ namespace kvm {
         std::vector<Listener*> m_listeners;
         /// Node Cluster
         Cluster m_cluster;
+        /// Runs the cluster once the KVM is pumped
+        ClusterThread m_network;
         /// Current State
         State m_state;
+        /// ID of the most recent input change request that we sent, or zero until the cluster has taken it
+        ChangeInputRequest::RequestId m_pendingRequest;
+        /// Requests passed to the cluster thread that it hasn't yet taken
+        size_t m_requestsInTransit;
         /// USB Monitor. Used to watch for changes in connected devices.
         USBMonitor m_monitor;
         /// Device to watch for connectivity changes.
@@ -166,6 +240,10 @@ namespace kvm {
         Display::InputMap m_inputs;
         /// Nodes to which this
         std::vector<std::string> m_nodes;
+        /// Serial numbers of the attached displays that the cluster was last told of, sorted
+        std::optional<std::vector<Display::SerialNumber>> m_displays;
+        /// Spaces out checks for displays that have been attached or detached
+        TimeSpacer m_displayRefresh;
     };
 }
 
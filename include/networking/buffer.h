@@ -2,21 +2,50 @@
 #define KVM_NETWORKING_BUFFER_H
 
 #include <cstdint>
+#include <cstddef>
 #include <string>
-#include <array>
+#include <string_view>
+#include <limits>
+#include <type_traits>
 
 namespace kvm {
     class Serializable;
 
+    /**
+     * Marks an unsigned integer field to be streamed as an LEB128 varint: seven bits per byte, least
+     * significant group first, with the top bit set on every byte except the last. Values below 128 take
+     * a single byte, so counts, IDs and durations cost only as many bytes as their magnitude needs.
+     * Written as buffer << Varint(value) and read as buffer >> Varint(value).
+     */
+    template<typename T>
+    class Varint {
+    public:
+
+        static_assert(std::is_unsigned<typename std::remove_const<T>::type>::value, "Varint fields must be unsigned integers");
+
+        Varint(T& value) :
+        m_value(value)
+        {}
+
+        /// Field being streamed
+        T& m_value;
+    };
+
+    template<typename T>
+    Varint(const T&) -> Varint<const T>;
+
     /**
      * Container class that handles serialization to and from buffers that are sent over the network
-     * through Socket instances.
+     * through Socket instances. Storage is drawn from the calling thread's BufferPool and grows on demand
+     * up to MaxCapacity bytes.
      */
     class NetworkBuffer {
     public:
 
-        typedef std::array<uint8_t, 2048>   Buffer;
-        typedef Buffer::size_type           Offset;
+        typedef size_t Offset;
+
+        /// Largest amount of storage a buffer will grow to
+        static const Offset MaxCapacity;
 
         enum class State {
             OK,
@@ -29,10 +58,26 @@ namespace kvm {
         NetworkBuffer();
 
         /**
-         * Copy Constructor
+         * Copy Constructor. Only copies the contained data, not the buffer's spare capacity.
          */
         NetworkBuffer(const NetworkBuffer& buffer);
 
+        /**
+         * Move Constructor. Takes over the other buffer's storage, leaving it empty.
+         */
+        NetworkBuffer(NetworkBuffer&& buffer);
+
+        /**
+         * Assignment Operators
+         */
+        NetworkBuffer& operator=(const NetworkBuffer& buffer);
+        NetworkBuffer& operator=(NetworkBuffer&& buffer);
+
+        /**
+         * Destructor. Returns the buffer's storage to the pool.
+         */
+        ~NetworkBuffer();
+
         /**
          * Get the network message's current state.
          */
@@ -44,48 +89,82 @@ namespace kvm {
         Offset GetCapacity() const;
 
         /**
-         * Get the current buffer offset.
+         * Ensure that the buffer can hold at least the given number of bytes without growing.
+         */
+        NetworkBuffer& Reserve(Offset capacity);
+
+        /**
+         * Get the current buffer offset, relative to the start of the current window.
          */
         Offset GetOffset() const;
 
         /**
-         * Get the underlying buffer.
+         * Get the underlying buffer, starting at the current window.
          */
         uint8_t* GetBuffer();
         const uint8_t* GetBuffer() const;
 
         /**
-         * Get the amount of data that's been serialized into this buffer.
+         * Get the amount of data that's been serialized into this buffer, or that lies within the
+         * current window.
          */
         Offset GetSize() const;
 
         /**
-         * Append data at the current offset
+         * Get the amount of contained data that lies beyond the current offset.
+         */
+        Offset GetRemaining() const;
+
+        /**
+         * Append data after the data already contained in this buffer. Does not move the offset.
+         */
+        NetworkBuffer& Append(const uint8_t* data, size_t size);
+
+        /**
+         * Advance the offset past the given number of bytes without reading them.
+         */
+        NetworkBuffer& Skip(Offset size);
+
+        /**
+         * Discard data that lies before the current offset and move the remaining data to the start
+         * of the buffer. Also removes any window.
+         */
+        NetworkBuffer& Compact();
+
+        /**
+         * Restrict this buffer to the given range of its underlying storage, measured from the start of
+         * the storage rather than the current window. Offsets, sizes and reads are then relative to the
+         * window, which lets a single message inside a larger buffer be read in place without copying.
          */
-        NetworkBuffer& Append(uint8_t* data, size_t size);
+        NetworkBuffer& Window(Offset start, Offset length);
 
         /**
          * Resets the internal offset value for this buffer. Subsequent reads and writes will
          * occur at the beginning of the buffer's storage space.
          */
         NetworkBuffer& Reset();
-        NetworkBuffer& Reset(uint8_t* data, size_t size);
-        NetworkBuffer& Reset(Buffer buffer);
+        NetworkBuffer& Reset(const uint8_t* data, size_t size);
 
         /**
-         * Attempt to peek at a value inside the buffer. This does not advance the internal offset.
+         * Attempt to peek at a value inside the buffer. This does not advance the internal offset, and a
+         * failed peek leaves the buffer's state untouched so that it can still be read from.
          * Returns false if the buffer is incapable of containing a value of the given type.
          */
         template<typename T>
         bool Peek(T& value) {
             auto offset = m_offset;
+            auto state  = m_state;
             *this >> value;
-            m_offset = offset;
-            return m_state == State::OK;
+            bool peeked = m_state == State::OK;
+            m_offset    = offset;
+            m_state     = state;
+            return peeked;
         }
 
         /**
-         * Output operator. Streams a value of the given type from the network message.
+         * Output operator. Streams a value of the given type from the network message. Strings may be
+         * read into a std::string_view, which points into the buffer's storage rather than copying the
+         * string out, and so is only valid until the buffer is next modified.
          */
         friend NetworkBuffer& operator>>(NetworkBuffer& message, uint8_t& value);
         friend NetworkBuffer& operator>>(NetworkBuffer& message, int8_t& value);
@@ -93,8 +172,10 @@ namespace kvm {
         friend NetworkBuffer& operator>>(NetworkBuffer& message, int16_t& value);
         friend NetworkBuffer& operator>>(NetworkBuffer& message, uint32_t& value);
         friend NetworkBuffer& operator>>(NetworkBuffer& message, int32_t& value);
+        friend NetworkBuffer& operator>>(NetworkBuffer& message, uint64_t& value);
         friend NetworkBuffer& operator>>(NetworkBuffer& message, bool& value);
         friend NetworkBuffer& operator>>(NetworkBuffer& message, std::string& value);
+        friend NetworkBuffer& operator>>(NetworkBuffer& message, std::string_view& value);
         friend NetworkBuffer& operator>>(NetworkBuffer& message, Serializable& value);
 
         /**
@@ -106,10 +187,22 @@ namespace kvm {
         friend NetworkBuffer& operator<<(NetworkBuffer& message, int16_t value);
         friend NetworkBuffer& operator<<(NetworkBuffer& message, uint32_t value);
         friend NetworkBuffer& operator<<(NetworkBuffer& message, int32_t value);
+        friend NetworkBuffer& operator<<(NetworkBuffer& message, uint64_t value);
         friend NetworkBuffer& operator<<(NetworkBuffer& message, bool value);
         friend NetworkBuffer& operator<<(NetworkBuffer& message, const std::string& value);
+        friend NetworkBuffer& operator<<(NetworkBuffer& message, std::string_view value);
         friend NetworkBuffer& operator<<(NetworkBuffer& message, const Serializable& value);
 
+        /**
+         * Stream an unsigned integer as a varint. See Varint.
+         */
+        NetworkBuffer& WriteVarint(uint64_t value);
+
+        /**
+         * Read a varint, failing if it's malformed or larger than the given maximum.
+         */
+        NetworkBuffer& ReadVarint(uint64_t& value, uint64_t maximum = std::numeric_limits<uint64_t>::max());
+
         /**
          * Boolean operator. Returns true if the network buffer is in the OK state, false otherwise.
          */
@@ -127,8 +220,18 @@ namespace kvm {
          */
         NetworkBuffer& Serialize(const void* in, Offset size);
 
-        /// Message Buffer
-        Buffer m_buffer;
+        /**
+         * Grow the underlying storage so that it can hold at least the given number of bytes, measured
+         * from the start of the storage. Returns false if that would exceed MaxCapacity.
+         */
+        bool Grow(Offset size);
+
+        /// Message Buffer, drawn from a BufferPool
+        uint8_t* m_buffer;
+        /// Size of the underlying storage
+        Offset m_capacity;
+        /// Start of the current window
+        Offset m_base;
         /// Current Offset
         Offset m_offset;
         /// Contained Data Length
@@ -136,6 +239,20 @@ namespace kvm {
         /// Current State
         State m_state;
     };
+
+    template<typename T>
+    NetworkBuffer& operator<<(NetworkBuffer& buffer, Varint<T> field) {
+        return buffer.WriteVarint(field.m_value);
+    }
+
+    template<typename T>
+    NetworkBuffer& operator>>(NetworkBuffer& buffer, Varint<T> field) {
+        uint64_t value = 0;
+        if(buffer.ReadVarint(value, std::numeric_limits<T>::max())) {
+            field.m_value = static_cast<T>(value);
+        }
+        return buffer;
+    }
 }
 
 #endif // KVM_NETWORKING_BUFFER_H
\ No newline at end of file
@@ -0,0 +1,142 @@
+#ifndef KVM_NETWORKING_CAPTURE_H
+#define KVM_NETWORKING_CAPTURE_H
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <platform/types.h>
+#include <networking/buffer.h>
+
+namespace kvm {
+    /**
+     * A framed message recorded in a capture.
+     */
+    struct CapturedMessage {
+        enum class Direction : uint8_t {
+            RECEIVED,
+            SENT
+        };
+
+        /// Time since the capture started
+        std::chrono::microseconds   timestamp;
+        /// Whether we received the message or sent it
+        Direction                   direction;
+        /// Address of the node at the other end of the connection
+        SocketAddress               peer;
+        /// Message, without its frame header
+        NetworkBuffer               message;
+    };
+
+    /**
+     * Records the messages that cross node connections to a file, for offline analysis and for replaying
+     * into a cluster with CaptureReader. A capture starts with the magic "KVMC", a format version byte
+     * and the wall-clock start time in microseconds since the Unix epoch. Each message follows as a
+     * varint of microseconds since the previous record, a direction byte, the peer's IPv4 address and
+     * port, a varint message length and the message itself, so that a heartbeat costs around a dozen
+     * bytes of overhead. Records are buffered until Flush() is called. Not thread-safe; write from the
+     * thread that pumps the cluster.
+     */
+    class CaptureWriter {
+    public:
+
+        /**
+         * Default Constructor
+         */
+        CaptureWriter();
+
+        /**
+         * Start a new capture in the given file, replacing its contents.
+         */
+        bool Open(const std::string& path);
+
+        /**
+         * Determine whether a capture is being written.
+         */
+        bool IsOpen() const;
+
+        /**
+         * Append a message to the capture. Does nothing if no capture is open.
+         */
+        void Write(CapturedMessage::Direction direction, const SocketAddress& peer, const NetworkBuffer& message);
+
+        /**
+         * Write buffered records out to the file, so that they survive the process being killed.
+         */
+        void Flush();
+
+        /**
+         * Flush and close the capture.
+         */
+        void Close();
+
+        /**
+         * Destructor. Closes the capture.
+         */
+        ~CaptureWriter();
+
+    private:
+
+        CaptureWriter(const CaptureWriter&) = delete;
+        CaptureWriter& operator=(const CaptureWriter&) = delete;
+
+        typedef std::chrono::time_point<std::chrono::steady_clock> TimePoint;
+
+        /// Capture file
+        std::ofstream m_file;
+        /// Time at which the last record was written
+        TimePoint m_last;
+        /// Record header scratch space, reused between records
+        NetworkBuffer m_header;
+    };
+
+    /**
+     * Reads back the messages recorded by a CaptureWriter, in the order they were written.
+     */
+    class CaptureReader {
+    public:
+
+        /**
+         * Default Constructor
+         */
+        CaptureReader();
+
+        /**
+         * Open a capture file. Fails if the file isn't a capture in a format we understand.
+         */
+        bool Open(const std::string& path);
+
+        /**
+         * Get the wall-clock time at which the capture started.
+         */
+        std::chrono::system_clock::time_point GetStartTime() const;
+
+        /**
+         * Read the next message. Returns false at the end of the capture, or at a damaged or truncated
+         * record, as left behind when a capturing process is killed; see IsAtEnd().
+         */
+        bool Next(CapturedMessage& record);
+
+        /**
+         * Determine whether every record in the capture has been read.
+         */
+        bool IsAtEnd();
+
+    private:
+
+        CaptureReader(const CaptureReader&) = delete;
+        CaptureReader& operator=(const CaptureReader&) = delete;
+
+        /// Capture file
+        std::ifstream m_file;
+        /// Wall-clock start time, in microseconds since the Unix epoch
+        uint64_t m_startTime;
+        /// Time since the start of the capture of the last record read
+        std::chrono::microseconds m_timestamp;
+        /// Message scratch space, reused between records
+        std::vector<uint8_t> m_payload;
+    };
+}
+
+#endif // KVM_NETWORKING_CAPTURE_H
\ No newline at end of file
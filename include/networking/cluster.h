@@ -2,28 +2,64 @@
 #define KVM_CLUSTER_H
 
 #include <map>
+#include <set>
+#include <memory>
+#include <unordered_map>
+#include <optional>
 #include <vector>
 #include <chrono>
+#include <core/slot_map.h>
 #include <display/display.h>
 #include <networking/socket.h>
+#include <networking/reactor.h>
 #include <networking/node.h>
+#include <networking/identity.h>
+#include <networking/multicast.h>
+#include <networking/discovery.h>
+#include <networking/waker.h>
+#include <networking/capture.h>
+#include <networking/lease.h>
+#include <networking/message/change_input_request.h>
+#include <networking/message/change_input_response.h>
+#include <networking/message/display_announcement.h>
+#include <networking/message/types.h>
 
 namespace kvm {
-    class Cluster : public Node::Listener {
+    class Cluster : public Node::Listener,
+                    public MulticastChannel::Listener,
+                    public Discovery::Listener,
+                    public Reactor::Handler {
     public:
 
         class Listener {
         public:
 
             /**
-             * Called when an input change request message is received.
+             * Called when an input change request message is received. The request should be answered
+             * with RespondToInputChangeRequest() using the same request ID.
              */
-            virtual void OnInputChangeRequested(const Node& sender, const std::map<Display, Display::Input>& changes) = 0;
+            virtual void OnInputChangeRequested(const Node& sender, ChangeInputRequest::RequestId id, const std::map<Display, Display::Input>& changes) = 0;
 
             /**
-             * Called when we receive an input change response from a node.
+             * Called when we receive an input change response from a node. The elapsed time is how long the
+             * node took to apply the changes.
              */
-            virtual void OnInputChangeResponse(const Node& sender, const std::map<Display, bool>& results) = 0;
+            virtual void OnInputChangeResponse(const Node& sender, ChangeInputRequest::RequestId id, const std::map<Display, bool>& results, std::chrono::microseconds elapsed) = 0;
+
+            /**
+             * Called once every node sent a request has responded to it, or the request has timed out or
+             * lost nodes. Succeeds only if every node responded and every change succeeded. Latency is
+             * measured from when the request was sent.
+             */
+            virtual void OnInputChangeCompleted(ChangeInputRequest::RequestId id, bool succeeded, std::chrono::microseconds latency)
+            {}
+
+            /**
+             * Called whenever a beacon arrives from another node on the local subnet, whether or not we're
+             * already connected to it.
+             */
+            virtual void OnNodeDiscovered(NodeId id, const SocketAddress& address, const std::vector<Display::SerialNumber>& displays)
+            {}
 
             /**
              * Called when a node connects to the cluster
@@ -38,6 +74,9 @@ namespace kvm {
             {}
         };
 
+        /// Refers to a node without keeping it alive, and never to a node that replaced it
+        typedef SlotMap<Node>::Handle NodeHandle;
+
         /**
          * Default Constructor
          */
@@ -48,20 +87,128 @@ namespace kvm {
          */
         bool Initialize();
 
+        /**
+         * Set the ID that this node presents to its peers. Should be stable across restarts so that peers
+         * can recognise duplicate connections to us; defaults to a random ID.
+         */
+        void SetNodeId(NodeId id);
+
+        /**
+         * Get the identity that this node presents to its peers.
+         */
+        const NodeIdentity& GetIdentity() const;
+
+        /**
+         * Set how often heartbeats are sent to nodes and how suspicious of a node we must become before
+         * its connection is closed and, where possible, another link to the peer is tried.
+         */
+        void SetFailureDetection(const FailureDetector::Settings& settings);
+
+        /**
+         * Set how many bytes of messages may wait to be sent to each node before the node is treated as
+         * stalled. Each node has its own queue, so a peer that stops reading never delays sends to the
+         * others. Queue depths are reported in the link statistics.
+         */
+        void SetSendQueueCapacity(size_t capacity);
+
+        /**
+         * Record every message sent to or received from a node in the given file, for offline analysis
+         * or for replaying into a cluster with kvm_replay. Off by default. See CaptureWriter.
+         */
+        bool EnableCapture(const std::string& path);
+
         /**
          * Add a new node to the cluster.
          */
         void AddNode(const std::string& hostname, uint16_t port);
 
         /**
-         * Request that connected nodes trigger an input change to the specified display input.
+         * Send input change requests over a multicast channel bound to the given port, so that a request
+         * reaches every node with one datagram per group instead of one TCP send per node. Nodes that
+         * don't acknowledge a request within the acknowledgement timeout are sent it over TCP instead.
+         * Must be called after Initialize().
+         */
+        bool EnableMulticast(uint16_t port);
+
+        /**
+         * Join a multicast group on the multicast port. Join one group per subnet that nodes are on.
+         */
+        bool JoinMulticastGroup(const std::string& group);
+
+        /**
+         * Find other nodes on the local subnet by broadcasting beacons on the given port, and connect to
+         * the nodes that we hear beacons from. Beacons advertise our listen port and the given displays.
+         * Of each pair of nodes that discover each other, only the one with the lower ID connects, since
+         * that's the connection that both would keep anyway. Must be called after Initialize().
+         */
+        bool EnableDiscovery(uint16_t port, const std::vector<Display::SerialNumber>& displays, std::chrono::milliseconds interval = std::chrono::seconds(2));
+
+        /**
+         * Set how long to wait for nodes to acknowledge a multicast request before sending it over TCP.
+         */
+        void SetMulticastAckTimeout(std::chrono::milliseconds timeout);
+
+        /**
+         * Set how long to wait for every node to respond to an input change request before reporting it
+         * as failed.
+         */
+        void SetRequestTimeout(std::chrono::milliseconds timeout);
+
+        /**
+         * Set how long to hold an input change request before sending it, so that requests made in quick
+         * succession go out as one. Defaults to 5ms; zero sends every request immediately.
+         */
+        void SetCoalesceWindow(std::chrono::milliseconds window);
+
+        /**
+         * Set the displays attached to this machine. Peers are told which displays we have, and of every
+         * change to them, so that they only send us requests for those displays. Requests for other
+         * displays are answered straight away without troubling listeners. Until this is called we're
+         * sent every request, and pass every request on.
          */
-        void RequestInputChange(const std::map<Display, Display::Input>& changes);
+        void SetDisplays(const std::vector<Display::SerialNumber>& displays);
 
         /**
-         * Respond to an input change request by indicating the changes that succeeded.
+         * Set how long a node that switches one of our displays holds its lease. While a node holds the
+         * lease, requests from other nodes to switch the display are refused, so two desks that trigger
+         * at once don't fight over the monitors. Our own requests acquire the leases on the displays
+         * they change, and quote the tokens of the leases we hold. Only applies once SetDisplays() has
+         * been called. Defaults to one second; zero turns arbitration off.
          */
-        void RespondToInputChangeRequest(const Node& sender, const std::map<Display, bool>& result);
+        void SetLeaseDuration(std::chrono::milliseconds duration);
+
+        /**
+         * Get the nodes that have announced that the display with the given serial number is attached to
+         * them.
+         */
+        std::vector<NodeHandle> GetDisplayOwners(Display::SerialNumber serial) const;
+
+        /**
+         * Request that connected nodes trigger an input change to the specified display input. Nodes that
+         * have announced their displays are only sent the changes for those displays. Returns the
+         * ID of the request, which is passed to listeners as responses arrive and when it completes. Any
+         * number of requests may be in flight at once. Requests made within the coalesce window of the
+         * first unsent request are merged into it, with later changes to a display replacing earlier
+         * ones, and share its ID.
+         */
+        ChangeInputRequest::RequestId RequestInputChange(const std::map<Display, Display::Input>& changes);
+
+        /**
+         * Respond to an input change request from the given node by indicating the changes that succeeded
+         * and how long they took to apply.
+         */
+        void RespondToInputChangeRequest(const Node& sender, ChangeInputRequest::RequestId id, const std::map<Display, bool>& result, std::chrono::microseconds elapsed);
+        void RespondToInputChangeRequest(NodeHandle sender, ChangeInputRequest::RequestId id, const std::map<Display, bool>& result, std::chrono::microseconds elapsed);
+
+        /**
+         * Get the handle of one of the cluster's nodes, which stays safe to use after the node is gone.
+         */
+        std::optional<NodeHandle> GetNodeHandle(const Node& node) const;
+
+        /**
+         * Get round-trip time, traffic and liveness telemetry for the link to each node.
+         */
+        std::vector<LinkStatistics> GetLinkStatistics() const;
 
         /**
          * Add an event listener.
@@ -74,12 +221,30 @@ namespace kvm {
         void RemoveListener(Listener* listener);
 
         /**
-         * Send heartbeats, attempt reconnects to nodes, etc.
+         * Wait up to the given duration for network activity and handle any messages that arrive, then
+         * send heartbeats, attempt reconnects to nodes, etc. Returns early when heartbeats are due, so
+         * the wait may be shorter than requested.
+         */
+        void Pump(std::chrono::milliseconds timeout = std::chrono::milliseconds(0));
+
+        /**
+         * Make a Pump() that's waiting for network activity on another thread return early. The only
+         * method that's safe to call from a thread other than the one pumping the cluster.
+         */
+        void Wake();
+
+        /**
+         * Called by the reactor when a new connection is waiting on the listen socket.
+         */
+        virtual void OnReadable() override;
+
+        /**
+         * Called when a node identifies itself. Closes duplicate connections to the same peer.
          */
-        void Pump();
+        virtual void OnNodeIdentified(Node& node) override;
 
         /**
-         * Called when a node is connected.
+         * Called when a connection to a node is established.
          */
         virtual void OnNodeConnected(const Node& node) override;
 
@@ -93,18 +258,233 @@ namespace kvm {
          */
         virtual void OnMessageReceived(Node& sender, NetworkBuffer& buffer) override;
 
+        /**
+         * Called when a request queued for a slow node is merged into a later one. The node won't answer
+         * the earlier request, so it stops waiting for it.
+         */
+        virtual void OnMessageSuperseded(Node& node, NetworkBuffer& buffer) override;
+
+        /**
+         * Called when a message arrives over the multicast channel.
+         */
+        virtual bool OnMulticastReceived(const SocketAddress& sender, NetworkBuffer& buffer) override;
+
+        /**
+         * Called when a node acknowledges a message sent over the multicast channel.
+         */
+        virtual void OnMulticastAcknowledged(const SocketAddress& sender, NodeId node, MulticastChannel::Sequence sequence) override;
+
+        /**
+         * Called when a beacon arrives from a node on the local subnet. Connects to nodes we don't yet know.
+         */
+        virtual void OnBeaconReceived(const SocketAddress& sender, const Beacon& beacon) override;
+
     private:
 
+        typedef std::chrono::time_point<std::chrono::steady_clock> TimePoint;
+
+        template<typename, NetworkMessageType...> friend class MessageDispatcher;
+
+        /// Number of request IDs remembered per node to recognize retried requests
+        static const size_t ReceivedRequestHistory;
+
+        /**
+         * A message sent over the multicast channel that some nodes haven't yet acknowledged.
+         */
+        struct PendingMulticast {
+            NetworkBuffer           message;
+            TimePoint               deadline;
+            std::vector<NodeHandle> awaiting;
+        };
+
+        /**
+         * An input change request that we sent and that some nodes haven't yet responded to.
+         */
+        struct PendingRequest {
+            TimePoint               sent;
+            TimePoint               deadline;
+            std::vector<NodeHandle> awaiting;
+            bool                    succeeded;
+        };
+
+        /**
+         * Input changes held back so that further requests can be merged into them.
+         */
+        struct CoalescedRequest {
+            ChangeInputRequest::RequestId   id;
+            Display::InputMap               changes;
+            TimePoint                       deadline;
+        };
+
+        /**
+         * Send an input change request to the nodes that can act on it and start waiting for their
+         * responses.
+         */
+        void SendInputChangeRequest(ChangeInputRequest::RequestId id, const Display::InputMap& changes);
+
+        /**
+         * A display lease that we've been granted.
+         */
+        struct HeldLease {
+            FencingToken    token;
+            /// When the lease lapses, measured conservatively from when the request was sent
+            TimePoint       expiry;
+        };
+
+        /**
+         * Get the tokens of the unexpired leases we hold on the displays being changed, from the given
+         * owner or, if none is given, from every owner of each display that we hold a lease from.
+         */
+        ChangeInputRequest::FenceMap GetFences(const Display::InputMap& changes, std::optional<NodeId> owner) const;
+
+        /**
+         * Send the coalesced request once its window has closed.
+         */
+        void FlushCoalescedRequest();
+
+        /**
+         * Pass an input change request from a node on to listeners, less any changes to displays whose
+         * leases the node can't have.
+         */
+        void OnMessage(const ChangeInputRequest& request, Node& sender);
+
+        /**
+         * Record a node's response to one of our requests and complete the request if it was the last.
+         */
+        void OnMessage(const ChangeInputResponse& response, Node& sender);
+
+        /**
+         * Record the displays that a node has announced.
+         */
+        void OnMessage(const DisplayAnnouncement& announcement, Node& sender);
+
+        /**
+         * Send a node an announcement of every display attached to this machine.
+         */
+        void AnnounceDisplays(Node& node);
+
+        /**
+         * Forget the displays that a node has announced.
+         */
+        void UnindexDisplays(NodeHandle handle);
+
+        /**
+         * Remove a node from the owners of a display.
+         */
+        void RemoveDisplayOwner(Display::SerialNumber serial, NodeHandle handle);
+
+        /**
+         * Take ownership of a node and hook it up to the cluster's reactor, identity and listeners.
+         */
+        NodeHandle AttachNode(std::unique_ptr<Node> node);
+
+        /**
+         * Destroy nodes that will never connect again, or that we no longer need to: inbound nodes whose
+         * connections have closed, discovered nodes that we've lost or parked, and nodes that turned
+         * out to be ourselves. Only called between reactor polls, so that no node is destroyed while
+         * one of its callbacks is running.
+         */
+        void RemoveClosedNodes();
+
+        /**
+         * Remove a node from the peer, address and display indices.
+         */
+        void Unindex(NodeHandle handle, const Node& node);
+
+        /**
+         * Find a connected node with the given IP address.
+         */
+        Node* FindConnectedNode(const SocketAddress& address);
+
+        /**
+         * Send pending multicast messages over TCP to nodes that didn't acknowledge them in time.
+         */
+        void RetryUnacknowledgedMulticasts();
+
+        /**
+         * Broadcast a beacon if one is due.
+         */
+        void AnnounceIfDue();
+
+        /**
+         * Stop waiting for the given node to respond to pending requests or acknowledge multicasts,
+         * marking the requests it was sent as failed.
+         */
+        void ForgetNode(NodeHandle node);
+
+        /**
+         * Inform listeners of requests that every node has responded to or that have timed out.
+         */
+        void CompleteRequests();
+
         /// Socket Listen Port
         uint16_t m_listenPort;
         /// Listen Socket
         Socket m_socket;
-        /// Connected Nodes
-        std::vector<Node> m_nodes;
+        /// Watches the listen socket and all node sockets for activity
+        Reactor m_reactor;
+        /// Interrupts reactor polls from other threads
+        Waker m_waker;
+        /// Identity presented to peers
+        NodeIdentity m_identity;
+        /// Heartbeat and failure detection settings applied to every node
+        FailureDetector::Settings m_failureDetection;
+        /// Send queue capacity applied to every node, if one has been set
+        std::optional<size_t> m_sendQueueCapacity;
+        /// Records node traffic once enabled
+        CaptureWriter m_capture;
+        /// Nodes, connected or not
+        SlotMap<Node> m_nodes;
+        /// Identified connection to each peer
+        std::unordered_map<NodeId, NodeHandle> m_peers;
+        /// A connected node at each IP address, keyed in network byte order, for attributing multicasts
+        std::unordered_map<uint32_t, NodeHandle> m_hosts;
+        /// Nodes that were added because we heard their beacons
+        std::set<NodeHandle> m_discovered;
         /// Event Listeners
         std::vector<Listener*> m_listeners;
-        /// Indicates when each connected node was last seen
-        std::map<Node, std::chrono::time_point<std::chrono::system_clock>> m_lastSeen;
+        /// Nodes that listeners have been told are connected
+        std::set<NodeHandle> m_announced;
+        /// Fast path for fanning requests out to every node
+        MulticastChannel m_multicast;
+        /// Port on which the multicast channel is bound
+        uint16_t m_multicastPort;
+        /// How long to wait for multicast acknowledgements before falling back to TCP
+        std::chrono::milliseconds m_multicastAckTimeout;
+        /// Multicast messages awaiting acknowledgement, keyed by sequence number
+        std::map<MulticastChannel::Sequence, PendingMulticast> m_pendingMulticasts;
+        /// ID to give the next input change request
+        ChangeInputRequest::RequestId m_nextRequestId;
+        /// How long to wait for every node to respond to an input change request
+        std::chrono::milliseconds m_requestTimeout;
+        /// How long to hold requests so that others can be merged into them
+        std::chrono::milliseconds m_coalesceWindow;
+        /// Request waiting for its coalesce window to close
+        std::optional<CoalescedRequest> m_coalescing;
+        /// Finds nodes on the local subnet
+        Discovery m_discovery;
+        /// Displays advertised in our beacons
+        std::vector<Display::SerialNumber> m_advertisedDisplays;
+        /// How often to broadcast beacons
+        std::chrono::milliseconds m_beaconInterval;
+        /// When the next beacon is due
+        TimePoint m_nextBeacon;
+        /// Input change requests awaiting responses, keyed by request ID
+        std::map<ChangeInputRequest::RequestId, PendingRequest> m_pendingRequests;
+        /// Displays attached to this machine, sorted. Only announced once set.
+        std::vector<Display::SerialNumber> m_displays;
+        /// Displays that each node has announced on its current connection
+        std::map<NodeHandle, std::set<Display::SerialNumber>> m_nodeDisplays;
+        /// Nodes that have announced each display. Usually one, but serial numbers aren't always unique.
+        std::unordered_map<Display::SerialNumber, std::vector<NodeHandle>> m_displayOwners;
+        /// Leases on the displays attached to this machine
+        LeaseTable m_leases;
+        /// Leases on other machines' displays that we hold, by display and owner
+        std::map<std::pair<Display::SerialNumber, NodeId>, HeldLease> m_heldLeases;
+        /// Lease on each display that each node's requests asked for, until listeners respond to them
+        std::map<NodeHandle, std::map<ChangeInputRequest::RequestId, ChangeInputResponse::LeaseMap>> m_leaseDecisions;
+        /// IDs of the most recent requests received from each node on its current connection
+        std::map<NodeHandle, std::set<ChangeInputRequest::RequestId>> m_receivedRequests;
     };
 }
 
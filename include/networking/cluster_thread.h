@@ -0,0 +1,190 @@
+#ifndef KVM_NETWORKING_CLUSTER_THREAD_H
+#define KVM_NETWORKING_CLUSTER_THREAD_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <core/spsc_ring.h>
+#include <networking/cluster.h>
+
+namespace kvm {
+    /**
+     * Runs a cluster on a thread of its own, so that heartbeats, reconnects and socket reads carry on
+     * while the owning thread is busy, e.g. waiting on a slow monitor. The owning thread talks to the
+     * cluster through a pair of lock-free rings: commands go in one, and cluster events come back in
+     * the other to be collected with NextEvent(). Nodes never cross threads; events identify them with
+     * a handle and a summary instead.
+     */
+    class ClusterThread : public Cluster::Listener {
+    public:
+
+        /**
+         * Something that happened on the cluster, to be handled on the owning thread.
+         */
+        struct Event {
+            enum class Type {
+                /// A node connected. Sets node and summary.
+                NODE_CONNECTED,
+                /// A node disconnected. Sets node and summary.
+                NODE_DISCONNECTED,
+                /// A node asked us to change inputs. Sets node, summary, id and changes.
+                INPUT_CHANGE_REQUESTED,
+                /// The cluster took one of our requests under the given ID. Sets id.
+                INPUT_CHANGE_ACCEPTED,
+                /// A node answered one of our requests. Sets node, summary, id, results and elapsed.
+                INPUT_CHANGE_RESPONSE,
+                /// One of our requests completed. Sets id, succeeded and elapsed, which holds the latency.
+                INPUT_CHANGE_COMPLETED
+            };
+
+            Type                            type;
+            Cluster::NodeHandle             node;
+            NodeSummary                     summary;
+            ChangeInputRequest::RequestId   id;
+            Display::InputMap               changes;
+            std::map<Display, bool>         results;
+            std::chrono::microseconds       elapsed;
+            bool                            succeeded;
+        };
+
+        /**
+         * Construct a thread to run the given, initialized cluster. The cluster should be configured
+         * before the thread is started, and not be touched directly while it runs.
+         */
+        ClusterThread(Cluster& cluster);
+
+        /**
+         * Start pumping the cluster on its own thread.
+         */
+        void Start();
+
+        /**
+         * Stop the thread and wait for it to finish.
+         */
+        void Stop();
+
+        /**
+         * Determine whether the thread is running.
+         */
+        bool IsRunning() const;
+
+        /**
+         * Ask the cluster to request an input change. The ID that the request goes out under is
+         * reported in an INPUT_CHANGE_ACCEPTED event, ahead of any events about the request itself.
+         */
+        void RequestInputChange(const Display::InputMap& changes);
+
+        /**
+         * Answer a node's input change request. Dropped if the node has gone in the meantime.
+         */
+        void RespondToInputChangeRequest(Cluster::NodeHandle sender, ChangeInputRequest::RequestId id, const std::map<Display, bool>& results, std::chrono::microseconds elapsed);
+
+        /**
+         * Tell the cluster which displays are attached to this machine. See Cluster::SetDisplays().
+         */
+        void SetDisplays(const std::vector<Display::SerialNumber>& displays);
+
+        /**
+         * Take the next waiting event. Returns false if there are none.
+         */
+        bool NextEvent(Event& event);
+
+        /**
+         * Wait up to the given duration for an event to arrive. Returns true if one is waiting.
+         */
+        bool WaitForEvents(std::chrono::milliseconds timeout);
+
+        /**
+         * Get the link statistics as of the cluster's last pump.
+         */
+        std::vector<LinkStatistics> GetLinkStatistics() const;
+
+        /**
+         * Destructor. Stops the thread.
+         */
+        ~ClusterThread();
+
+        virtual void OnNodeConnected(const Node& node) override;
+        virtual void OnNodeDisconnected(const Node& node) override;
+        virtual void OnInputChangeRequested(const Node& sender, ChangeInputRequest::RequestId id, const Display::InputMap& changes) override;
+        virtual void OnInputChangeResponse(const Node& sender, ChangeInputRequest::RequestId id, const std::map<Display, bool>& results, std::chrono::microseconds elapsed) override;
+        virtual void OnInputChangeCompleted(ChangeInputRequest::RequestId id, bool succeeded, std::chrono::microseconds latency) override;
+
+    private:
+
+        ClusterThread(const ClusterThread&) = delete;
+        ClusterThread& operator=(const ClusterThread&) = delete;
+
+        /**
+         * Something the owning thread wants the cluster to do.
+         */
+        struct Command {
+            enum class Type {
+                REQUEST_INPUT_CHANGE,
+                RESPOND_TO_INPUT_CHANGE,
+                SET_DISPLAYS
+            };
+
+            Type                                 type;
+            Cluster::NodeHandle                  node;
+            ChangeInputRequest::RequestId        id;
+            Display::InputMap                    changes;
+            std::map<Display, bool>              results;
+            std::chrono::microseconds            elapsed;
+            std::vector<Display::SerialNumber>   displays;
+        };
+
+        /**
+         * Pump the cluster and carry out commands until stopped. Runs on the cluster thread.
+         */
+        void Run();
+
+        /**
+         * Pass a command to the cluster thread and wake it. Runs on the owning thread.
+         */
+        void Post(Command&& command);
+
+        /**
+         * Move as many backlogged commands into the ring as fit and wake the cluster thread.
+         */
+        void FlushCommands();
+
+        /**
+         * Pass an event to the owning thread. Runs on the cluster thread.
+         */
+        void Publish(Event&& event);
+
+        /**
+         * Build an event about the given node.
+         */
+        Event MakeEvent(Event::Type type, const Node& node) const;
+
+        /// Cluster run by this thread
+        Cluster& m_cluster;
+        /// Cluster thread
+        std::thread m_thread;
+        /// Whether the cluster thread should keep running
+        std::atomic<bool> m_running;
+        /// Commands from the owning thread
+        SpscRing<Command, 64> m_commands;
+        /// Commands that didn't fit in the ring, in order. Owning thread only.
+        std::deque<Command> m_commandBacklog;
+        /// Events from the cluster thread
+        SpscRing<Event, 256> m_events;
+        /// Events that didn't fit in the ring, in order. Cluster thread only.
+        std::deque<Event> m_eventBacklog;
+        /// Lets the owning thread sleep until events arrive. Guards no data; the rings need no lock.
+        std::mutex m_eventMutex;
+        std::condition_variable m_eventArrived;
+        /// Link statistics published after each pump
+        mutable std::mutex m_statisticsMutex;
+        std::vector<LinkStatistics> m_statistics;
+    };
+}
+
+#endif // KVM_NETWORKING_CLUSTER_THREAD_H
\ No newline at end of file
@@ -0,0 +1,89 @@
+#ifndef KVM_NETWORKING_DATAGRAM_H
+#define KVM_NETWORKING_DATAGRAM_H
+
+#include <vector>
+#include <core/core.h>
+#include <platform/types.h>
+#include <networking/buffer.h>
+
+namespace kvm {
+    /**
+     * Connectionless UDP socket, used for traffic that can tolerate loss such as multicast fan-out.
+     */
+    class DatagramSocket {
+    public:
+
+        /// Largest payload sent in a single datagram. Keeps datagrams inside a typical Ethernet MTU.
+        static const size_t MaxPayloadSize;
+
+        /**
+         * Default Constructor
+         */
+        DatagramSocket();
+
+        /**
+         * Bind this socket to the given port on all interfaces.
+         */
+        bool Open(uint16_t port);
+
+        /**
+         * Join the given multicast group so that datagrams sent to it are received by this socket.
+         * Datagrams this socket sends to the group are not looped back to it.
+         */
+        bool JoinGroup(const SocketAddress& group);
+
+        /**
+         * Allow datagrams to be sent to broadcast addresses.
+         */
+        bool EnableBroadcast();
+
+        /**
+         * Send the given buffer to a single destination.
+         */
+        bool SendTo(const SocketAddress& destination, const NetworkBuffer& buffer);
+
+        /**
+         * Send the given buffer to every destination, using a single system call where the platform
+         * supports it. Returns the number of destinations the buffer was sent to.
+         */
+        size_t SendTo(const std::vector<SocketAddress>& destinations, const NetworkBuffer& buffer);
+
+        /**
+         * Receive a waiting datagram directly into the given buffer. Returns false if no datagram is
+         * waiting.
+         */
+        bool ReceiveFrom(NetworkBuffer& buffer, SocketAddress& sender);
+
+        /**
+         * Close this socket.
+         */
+        void Close();
+
+        /**
+         * Determine whether this socket is open.
+         */
+        bool IsOpen() const;
+
+        /**
+         * Get the underlying platform socket handle.
+         */
+        PlatformSocket GetHandle() const;
+
+        /**
+         * Destructor
+         */
+        ~DatagramSocket();
+
+    private:
+
+        DatagramSocket(const DatagramSocket&) = delete;
+        DatagramSocket& operator=(const DatagramSocket&) = delete;
+
+        /// Socket Handle
+        PlatformSocket m_socket;
+        /// Whether the socket is open
+        bool m_open;
+    };
+}
+
+#endif // KVM_NETWORKING_DATAGRAM_H
\ No newline at end of file
@@ -0,0 +1,92 @@
+#ifndef KVM_NETWORKING_DISCOVERY_H
+#define KVM_NETWORKING_DISCOVERY_H
+
+#include <networking/datagram.h>
+#include <networking/reactor.h>
+#include <networking/message/beacon.h>
+#include <networking/message/types.h>
+
+namespace kvm {
+    /**
+     * Finds other nodes on the local subnet by broadcasting beacons on a well-known port and listening for
+     * the beacons of others. Beacons are best-effort and repeated periodically, so a lost beacon only
+     * delays discovery until the next one.
+     */
+    class Discovery : public Reactor::Handler {
+    public:
+
+        class Listener {
+        public:
+
+            /**
+             * Called when a beacon arrives from another node, or from this node if it is looped back.
+             */
+            virtual void OnBeaconReceived(const SocketAddress& sender, const Beacon& beacon) = 0;
+        };
+
+        /**
+         * Default Constructor
+         */
+        Discovery();
+
+        /**
+         * Bind to the given port, allow broadcasts and start watching for beacons with the given reactor.
+         */
+        bool Open(uint16_t port, Reactor& reactor);
+
+        /**
+         * Determine whether discovery is open.
+         */
+        bool IsOpen() const;
+
+        /**
+         * Broadcast the given beacon on the local subnet.
+         */
+        bool Announce(const Beacon& beacon);
+
+        /**
+         * Set the listener that is informed of received beacons.
+         */
+        void SetListener(Listener* listener);
+
+        /**
+         * Stop watching for beacons and close the socket.
+         */
+        void Close();
+
+        /**
+         * Called by the reactor when beacons are waiting to be read.
+         */
+        virtual void OnReadable() override;
+
+        /**
+         * Destructor
+         */
+        ~Discovery();
+
+    private:
+
+        Discovery(const Discovery&) = delete;
+        Discovery& operator=(const Discovery&) = delete;
+
+        template<typename, NetworkMessageType...> friend class MessageDispatcher;
+
+        /**
+         * Pass a received beacon on to the listener.
+         */
+        void OnMessage(const Beacon& beacon, const SocketAddress& sender);
+
+        /// Beacon Socket
+        DatagramSocket m_socket;
+        /// Reactor watching the beacon socket
+        Reactor* m_reactor;
+        /// Port that beacons are broadcast to
+        uint16_t m_port;
+        /// Event Listener
+        Listener* m_listener;
+        /// Scratch buffer that beacons are received into
+        NetworkBuffer m_receiveBuffer;
+    };
+}
+
+#endif // KVM_NETWORKING_DISCOVERY_H
\ No newline at end of file
@@ -0,0 +1,103 @@
+#ifndef KVM_NETWORKING_FAILURE_DETECTOR_H
+#define KVM_NETWORKING_FAILURE_DETECTOR_H
+
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <core/time.h>
+
+namespace kvm {
+    /**
+     * Phi accrual failure detector. Learns the distribution of intervals between heartbeats from a peer
+     * and, rather than a yes/no answer, reports a suspicion level phi: the peer is 10^phi times less
+     * likely to still be alive than to have failed, given how long it's been since its last heartbeat.
+     * A stable link produces a narrow distribution and is suspected quickly; a noisy one widens the
+     * distribution and is given more slack.
+     */
+    class FailureDetector {
+    public:
+
+        typedef kvm::Clock                  Clock;
+        typedef Clock::time_point           TimePoint;
+
+        struct Settings {
+            /// How often heartbeats are sent, and the interval assumed before any have been measured
+            std::chrono::milliseconds   heartbeatInterval;
+            /// Suspicion level above which the peer is considered to have failed
+            double                      threshold;
+            /// Number of recent intervals the distribution is estimated from
+            size_t                      windowSize;
+            /// Floor on the estimated standard deviation, so that a perfectly regular link isn't
+            /// declared dead by a single late heartbeat
+            std::chrono::milliseconds   minStandardDeviation;
+            /// Extra delay tolerated on top of the estimated distribution, e.g. for GC or scheduling pauses
+            std::chrono::milliseconds   acceptablePause;
+
+            /**
+             * Default Constructor. Tuned to notice a dead peer on a wired LAN in under a second.
+             */
+            Settings();
+        };
+
+        /**
+         * Default Constructor
+         */
+        FailureDetector(const Settings& settings = Settings());
+
+        /**
+         * Replace the detector settings. Takes effect from the next call to Reset().
+         */
+        void SetSettings(const Settings& settings);
+
+        /**
+         * Get the detector settings.
+         */
+        const Settings& GetSettings() const;
+
+        /**
+         * Discard learned intervals and start watching a new connection, seeding the distribution with
+         * the configured heartbeat interval.
+         */
+        void Reset(TimePoint now);
+
+        /**
+         * Record the arrival of a heartbeat.
+         */
+        void OnHeartbeat(TimePoint now);
+
+        /**
+         * Get the time at which the last heartbeat arrived, or at which the detector was reset.
+         */
+        TimePoint GetLastHeartbeat() const;
+
+        /**
+         * Get the current suspicion level, phi, that the peer has failed.
+         */
+        double GetSuspicion(TimePoint now) const;
+
+        /**
+         * Determine whether the current suspicion level is below the configured threshold.
+         */
+        bool IsAvailable(TimePoint now) const;
+
+    private:
+
+        /**
+         * Add an interval to the sliding window, evicting the oldest if the window is full.
+         */
+        void AddInterval(double interval);
+
+        /// Detector Settings
+        Settings m_settings;
+        /// Recent heartbeat intervals, in milliseconds
+        std::deque<double> m_intervals;
+        /// Sum of the intervals in the window
+        double m_sum;
+        /// Sum of the squares of the intervals in the window
+        double m_sumOfSquares;
+        /// Time of the last heartbeat
+        TimePoint m_lastHeartbeat;
+    };
+}
+
+#endif // KVM_NETWORKING_FAILURE_DETECTOR_H
\ No newline at end of file
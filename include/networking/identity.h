@@ -0,0 +1,83 @@
+#ifndef KVM_NETWORKING_IDENTITY_H
+#define KVM_NETWORKING_IDENTITY_H
+
+#include <cstdint>
+#include <optional>
+#include <string>
+
+namespace kvm {
+    /// Identifies a node across restarts and address changes
+    typedef uint64_t NodeId;
+
+    /**
+     * Optional protocol features that a node can advertise to its peers.
+     */
+    enum class NodeFeature : uint32_t {
+        MULTICAST = 1 << 0,
+        /// Announces its displays, and so only needs to be sent requests for those
+        DISPLAY_DIRECTORY = 1 << 1
+    };
+
+    /**
+     * A node's stable ID and the set of optional features it supports, as exchanged in the hello
+     * handshake.
+     */
+    class NodeIdentity {
+    public:
+
+        /**
+         * Default Constructor. Generates a random ID that lasts for the lifetime of the process.
+         */
+        NodeIdentity();
+
+        /**
+         * Initializing Constructor
+         */
+        NodeIdentity(NodeId id, uint32_t features = 0);
+
+        /**
+         * Get this node's ID.
+         */
+        NodeId GetId() const;
+
+        /**
+         * Set this node's ID.
+         */
+        void SetId(NodeId id);
+
+        /**
+         * Get the bitmask of features supported by this node.
+         */
+        uint32_t GetFeatures() const;
+
+        /**
+         * Determine whether this node supports the given feature.
+         */
+        bool HasFeature(NodeFeature feature) const;
+
+        /**
+         * Mark the given feature as supported or unsupported.
+         */
+        void SetFeature(NodeFeature feature, bool supported);
+
+        /**
+         * Generate a new random node ID.
+         */
+        static NodeId Generate();
+
+        /**
+         * Read the node ID stored at the given path, generating and storing a new one if the file doesn't
+         * exist or can't be read.
+         */
+        static NodeId LoadOrCreate(const std::string& path);
+
+    private:
+
+        /// Node ID
+        NodeId m_id;
+        /// Supported Features
+        uint32_t m_features;
+    };
+}
+
+#endif // KVM_NETWORKING_IDENTITY_H
\ No newline at end of file
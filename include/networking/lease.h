@@ -0,0 +1,77 @@
+#ifndef KVM_NETWORKING_LEASE_H
+#define KVM_NETWORKING_LEASE_H
+
+#include <chrono>
+#include <unordered_map>
+#include <core/time.h>
+#include <display/display.h>
+#include <networking/identity.h>
+#include <networking/message/change_input_request.h>
+#include <networking/message/change_input_response.h>
+
+namespace kvm {
+    /**
+     * Arbitrates leases on the displays attached to this machine. A node must hold a display's lease to
+     * switch its input, and acquires it by asking for the switch: the lease is granted if nobody else
+     * holds it, and the change applied, or refused and the change dropped. Each grant comes with a higher
+     * fencing token than any before it. Requesters quote the token of the lease they hold, so a request
+     * made under a lease that has expired and been granted to someone else is rejected rather than
+     * undoing the newer holder's switch. Two desks that trigger at once are settled by whichever request
+     * reaches the owner first, in one round trip and one DDC write.
+     */
+    class LeaseTable {
+    public:
+
+        typedef kvm::Clock          Clock;
+        typedef Clock::time_point   TimePoint;
+
+        /**
+         * Default Constructor. Leases last for the given term.
+         */
+        LeaseTable(std::chrono::milliseconds term = std::chrono::milliseconds(1000));
+
+        /**
+         * Set how long leases last. Takes effect from the next grant.
+         */
+        void SetTerm(std::chrono::milliseconds term);
+
+        /**
+         * Get how long leases last.
+         */
+        std::chrono::milliseconds GetTerm() const;
+
+        /**
+         * Ask for the lease on a display on behalf of a node's request, quoting the token of the lease
+         * that the node believes it holds, or zero if it holds none. Grants the lease unless another
+         * node holds it, the node has already been granted it for a later request, or the token has been
+         * superseded.
+         */
+        LeaseResult Acquire(Display::SerialNumber display, NodeId requester, ChangeInputRequest::RequestId request, FencingToken fence, TimePoint now);
+
+        /**
+         * Forget the order of the requests that a node has made, since a node that restarts numbers its
+         * requests from the beginning again. Leases it holds are kept.
+         */
+        void ResetRequestOrder(NodeId requester);
+
+    private:
+
+        struct Lease {
+            /// Node granted the lease most recently
+            NodeId                          holder;
+            /// Token issued with the most recent grant
+            FencingToken                    token;
+            /// When the lease lapses
+            TimePoint                       expiry;
+            /// Request that the lease was most recently granted for
+            ChangeInputRequest::RequestId   request;
+        };
+
+        /// How long leases last
+        std::chrono::milliseconds m_term;
+        /// Lease on each display that has been asked for
+        std::unordered_map<Display::SerialNumber, Lease> m_leases;
+    };
+}
+
+#endif // KVM_NETWORKING_LEASE_H
\ No newline at end of file
@@ -0,0 +1,47 @@
+#ifndef KVM_NETWORKING_LINK_STATISTICS_H
+#define KVM_NETWORKING_LINK_STATISTICS_H
+
+#include <chrono>
+#include <optional>
+#include <core/histogram.h>
+#include <platform/types.h>
+#include <networking/identity.h>
+
+namespace kvm {
+    /**
+     * Telemetry for the connection to a single node, accumulated over the lifetime of the node so that
+     * reconnects don't hide a history of poor latency.
+     */
+    struct LinkStatistics {
+        /// Node Address
+        SocketAddress               address;
+        /// ID the node last identified itself with, if it ever has
+        std::optional<NodeId>       peerId;
+        /// Whether the node is currently connected
+        bool                        connected;
+        /// Round-trip times measured from heartbeat echoes, in microseconds
+        Histogram                   roundTripTime;
+        /// Differences between consecutive round-trip times, in microseconds
+        Histogram                   jitter;
+        /// Messages sent to the node, including heartbeats
+        uint64_t                    messagesSent;
+        /// Messages received from the node, including heartbeats
+        uint64_t                    messagesReceived;
+        /// Bytes sent to the node, including framing
+        uint64_t                    bytesSent;
+        /// Bytes received from the node, including framing
+        uint64_t                    bytesReceived;
+        /// Messages dropped or merged away while waiting in the send queue
+        uint64_t                    messagesShed;
+        /// Messages waiting in the send queue
+        size_t                      sendQueueDepth;
+        /// Bytes waiting in the send queue, including framing
+        size_t                      sendQueueBytes;
+        /// Time since the node's last heartbeat, or since we connected to it
+        std::chrono::milliseconds   lastSeenAge;
+        /// Current suspicion level that the node has failed. See FailureDetector.
+        double                      suspicion;
+    };
+}
+
+#endif // KVM_NETWORKING_LINK_STATISTICS_H
\ No newline at end of file
@@ -8,6 +8,10 @@ namespace kvm {
     public:
         typedef uint8_t Type;
 
+        /// Version of the wire encoding, exchanged in Hello messages. Nodes only talk to peers that use
+        /// the same version.
+        static constexpr uint32_t ProtocolVersion = 3;
+
         /**
          * Default Constructor. Specifies the type of this message.
          */
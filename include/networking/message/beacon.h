@@ -0,0 +1,71 @@
+#ifndef KVM_NETWORKING_BEACON_H
+#define KVM_NETWORKING_BEACON_H
+
+#include <networking/message.h>
+#include <networking/identity.h>
+#include <display/display.h>
+#include <vector>
+
+namespace kvm {
+    /**
+     * Broadcast periodically on the local subnet by nodes that take part in discovery. Tells other nodes
+     * who we are, which port we accept connections on and which displays we're attached to, so that they
+     * can connect to us without being configured with our address.
+     */
+    class Beacon : public NetworkMessage {
+    public:
+
+        /**
+         * Default Constructor
+         */
+        Beacon();
+
+        /**
+         * Initializing Constructor. Specifies the sending node's ID, listen port and attached displays.
+         */
+        Beacon(NodeId id, uint16_t port, const std::vector<Display::SerialNumber>& displays);
+
+        /**
+         * Get the version of the wire encoding that the sending node uses.
+         */
+        uint32_t GetProtocolVersion() const;
+
+        /**
+         * Get the ID of the sending node.
+         */
+        NodeId GetNodeId() const;
+
+        /**
+         * Get the port on which the sending node accepts connections.
+         */
+        uint16_t GetPort() const;
+
+        /**
+         * Get the serial numbers of the displays attached to the sending node.
+         */
+        const std::vector<Display::SerialNumber>& GetDisplays() const;
+
+        /**
+         * Serialize this message into the given buffer.
+         */
+        virtual bool Serialize(NetworkBuffer& buffer) const override;
+
+        /**
+         * Deserialize a message of this type out of the given buffer.
+         */
+        virtual bool Deserialize(NetworkBuffer& buffer) override;
+
+    private:
+
+        /// Sender's wire encoding version
+        uint32_t m_protocolVersion;
+        /// Sender ID
+        NodeId m_id;
+        /// Sender Listen Port
+        uint16_t m_port;
+        /// Serial numbers of the sender's displays
+        std::vector<Display::SerialNumber> m_displays;
+    };
+}
+
+#endif // KVM_NETWORKING_BEACON_H
\ No newline at end of file
@@ -6,20 +6,34 @@
 #include <map>
 
 namespace kvm {
+    /// Issued with each grant of a display's lease, higher than every token issued for it before
+    typedef uint64_t FencingToken;
+
     class ChangeInputRequest : public NetworkMessage {
     public:
 
+        /// Identifies a request so that responses can be matched to it
+        typedef uint32_t RequestId;
+
+        /// Token of the lease that the requester holds on each display, for displays it holds one on
+        typedef std::map<Display::SerialNumber, FencingToken> FenceMap;
+
         /**
          * Create a request input message that requests that the specified 
          * displays be set to the provided corresponding inputs.
          */
-        ChangeInputRequest(const Display::InputMap& map);
+        ChangeInputRequest(RequestId id, const Display::InputMap& map);
 
         /**
          * Default Constructor
          */
         ChangeInputRequest();
 
+        /**
+         * Get the ID of this request.
+         */
+        RequestId GetId() const;
+
         /**
          * Set the input map contained in this message.
          */
@@ -30,6 +44,17 @@ namespace kvm {
          */
         const Display::InputMap& GetInputMap() const;
 
+        /**
+         * Set the tokens of the display leases that the requester holds. Owners reject changes made
+         * under a lease that has since been granted to someone else.
+         */
+        void SetFences(const FenceMap& fences);
+
+        /**
+         * Get the tokens of the display leases that the requester holds.
+         */
+        const FenceMap& GetFences() const;
+
         /**
          * Serialize this message into the given buffer.
          */
@@ -42,8 +67,12 @@ namespace kvm {
 
     private:
 
+        /// Request ID
+        RequestId m_id;
         /// Input Map
         Display::InputMap m_map;
+        /// Lease tokens
+        FenceMap m_fences;
     };
 }
 
@@ -3,32 +3,85 @@
 
 #include <networking/message.h>
 #include <networking/message/types.h>
+#include <networking/message/change_input_request.h>
+#include <networking/identity.h>
 #include <display/display.h>
 #include <core/core.h>
 #include <map>
+#include <chrono>
 
 namespace kvm {
+    /**
+     * What became of a request for a display's lease.
+     */
+    enum class LeaseDecision : uint8_t {
+        /// The requester holds the lease, and its change was applied
+        GRANTED,
+        /// Another node holds the lease
+        HELD,
+        /// The request was overtaken by a later one from the same node, or carried the token of a lease
+        /// that has since been granted again
+        STALE
+    };
+
+    /**
+     * A display's lease, as reported by the display's owner to a node that asked for it.
+     */
+    struct LeaseResult {
+        LeaseDecision               decision;
+        /// Token of the current lease
+        FencingToken                token;
+        /// Node that holds the current lease
+        NodeId                      holder;
+        /// How long the lease lasts from when it was granted
+        std::chrono::milliseconds   term;
+    };
+
     class ChangeInputResponse : public NetworkMessage {
     public:
 
         typedef std::map<Display, bool> ResultMap;
 
+        /// Lease on each display that the request asked for, if the responder arbitrates leases
+        typedef std::map<Display::SerialNumber, LeaseResult> LeaseMap;
+
         /**
          * Default Constructor
          */
         ChangeInputResponse();
 
         /**
-         * Initializing Constructor. Specifies the result of the sending computer's
-         * attempt to switch each display's input.
+         * Initializing Constructor. Specifies the request being answered, the result of the sending
+         * computer's attempt to switch each display's input and how long the attempt took.
          */
-        ChangeInputResponse(const ResultMap& result);
+        ChangeInputResponse(ChangeInputRequest::RequestId id, const ResultMap& result, std::chrono::microseconds elapsed);
+
+        /**
+         * Get the ID of the request that this message answers.
+         */
+        ChangeInputRequest::RequestId GetRequestId() const;
 
         /**
          * Get the result map contained in this message.
          */
         const ResultMap& GetResultMap() const;
 
+        /**
+         * Get how long the sending computer took to switch its displays' inputs.
+         */
+        std::chrono::microseconds GetElapsed() const;
+
+        /**
+         * Set the state of the lease on each display that the request asked for.
+         */
+        void SetLeases(const LeaseMap& leases);
+
+        /**
+         * Get the state of the lease on each display that the request asked for. Empty if the sending
+         * computer doesn't arbitrate leases.
+         */
+        const LeaseMap& GetLeases() const;
+
         /**
          * Serialize this message into the given buffer.
          */
@@ -41,7 +94,14 @@ namespace kvm {
 
     private:
 
+        /// ID of the request being answered
+        ChangeInputRequest::RequestId m_requestId;
+        /// Result for each display
         ResultMap m_result;
+        /// Time taken to apply the changes
+        std::chrono::microseconds m_elapsed;
+        /// Lease on each display
+        LeaseMap m_leases;
     };
 }
 
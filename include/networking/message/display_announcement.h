@@ -0,0 +1,64 @@
+#ifndef KVM_NETWORKING_DISPLAY_ANNOUNCEMENT_H
+#define KVM_NETWORKING_DISPLAY_ANNOUNCEMENT_H
+
+#include <networking/message.h>
+#include <display/display.h>
+#include <vector>
+
+namespace kvm {
+    /**
+     * Tells a peer which displays the sending node can switch, so that the peer only sends it requests
+     * for those displays. The first announcement on a connection lists every display; later ones only
+     * list the displays that were attached or detached since.
+     */
+    class DisplayAnnouncement : public NetworkMessage {
+    public:
+
+        /**
+         * Default Constructor
+         */
+        DisplayAnnouncement();
+
+        /**
+         * Initializing Constructor. A complete announcement replaces whatever the peer knew of our
+         * displays with those added; otherwise the given displays are added to and removed from it.
+         */
+        DisplayAnnouncement(bool complete, const std::vector<Display::SerialNumber>& added, const std::vector<Display::SerialNumber>& removed = {});
+
+        /**
+         * Determine whether this announcement lists every display the sender has.
+         */
+        bool IsComplete() const;
+
+        /**
+         * Get the serial numbers of displays attached to the sender.
+         */
+        const std::vector<Display::SerialNumber>& GetAdded() const;
+
+        /**
+         * Get the serial numbers of displays detached from the sender.
+         */
+        const std::vector<Display::SerialNumber>& GetRemoved() const;
+
+        /**
+         * Serialize this message into the given buffer.
+         */
+        virtual bool Serialize(NetworkBuffer& buffer) const override;
+
+        /**
+         * Deserialize a message of this type out of the given buffer.
+         */
+        virtual bool Deserialize(NetworkBuffer& buffer) override;
+
+    private:
+
+        /// Whether the added displays are all of the sender's displays
+        bool m_complete;
+        /// Displays attached
+        std::vector<Display::SerialNumber> m_added;
+        /// Displays detached
+        std::vector<Display::SerialNumber> m_removed;
+    };
+}
+
+#endif // KVM_NETWORKING_DISPLAY_ANNOUNCEMENT_H
\ No newline at end of file
@@ -5,13 +5,67 @@
 #include <map>
 
 namespace kvm {
+    /**
+     * Periodic liveness message. Also carries the timestamp of the last heartbeat received from the peer
+     * and how long ago it arrived, so that the peer can measure the round-trip time without extra
+     * messages. Timestamps are in microseconds on the sender's monotonic clock and are only ever
+     * compared with that same clock.
+     */
     class Heartbeat : public NetworkMessage {
     public:
 
+        typedef uint64_t Timestamp;
+
         /**
          * Default Constructor
          */
         Heartbeat();
+
+        /**
+         * Initializing Constructor. Specifies when this heartbeat was sent, the timestamp of the peer's
+         * heartbeat being echoed (zero if none) and how long that heartbeat was held before this one was
+         * sent.
+         */
+        Heartbeat(Timestamp timestamp, Timestamp echoTimestamp, uint32_t echoDelay);
+
+        /**
+         * Get the time at which this heartbeat was sent.
+         */
+        Timestamp GetTimestamp() const;
+
+        /**
+         * Get the timestamp of the receiver's heartbeat that this heartbeat echoes, or zero if none.
+         */
+        Timestamp GetEchoTimestamp() const;
+
+        /**
+         * Get how long, in microseconds, the echoed heartbeat was held before this one was sent.
+         */
+        uint32_t GetEchoDelay() const;
+
+        /**
+         * Get the current time on the monotonic clock used for heartbeat timestamps.
+         */
+        static Timestamp Now();
+
+        /**
+         * Serialize this message into the given buffer.
+         */
+        virtual bool Serialize(NetworkBuffer& buffer) const override;
+
+        /**
+         * Deserialize a message of this type out of the given buffer.
+         */
+        virtual bool Deserialize(NetworkBuffer& buffer) override;
+
+    private:
+
+        /// Send Time
+        Timestamp m_timestamp;
+        /// Echoed Peer Timestamp
+        Timestamp m_echoTimestamp;
+        /// Time the echoed heartbeat was held for
+        uint32_t m_echoDelay;
     };
 }
 
@@ -0,0 +1,55 @@
+#ifndef KVM_NETWORKING_HELLO_H
+#define KVM_NETWORKING_HELLO_H
+
+#include <networking/message.h>
+#include <networking/identity.h>
+
+namespace kvm {
+    /**
+     * First message sent in each direction on a new connection. Tells the peer who we are, so that
+     * duplicate connections between the same pair of nodes can be detected, and which optional features
+     * we support.
+     */
+    class Hello : public NetworkMessage {
+    public:
+
+        /**
+         * Default Constructor
+         */
+        Hello();
+
+        /**
+         * Initializing Constructor. Specifies the identity of the sending node.
+         */
+        Hello(const NodeIdentity& identity);
+
+        /**
+         * Get the identity of the sending node.
+         */
+        const NodeIdentity& GetIdentity() const;
+
+        /**
+         * Get the version of the wire encoding that the sending node uses.
+         */
+        uint32_t GetProtocolVersion() const;
+
+        /**
+         * Serialize this message into the given buffer.
+         */
+        virtual bool Serialize(NetworkBuffer& buffer) const override;
+
+        /**
+         * Deserialize a message of this type out of the given buffer.
+         */
+        virtual bool Deserialize(NetworkBuffer& buffer) override;
+
+    private:
+
+        /// Sender Identity
+        NodeIdentity m_identity;
+        /// Sender's wire encoding version
+        uint32_t m_protocolVersion;
+    };
+}
+
+#endif // KVM_NETWORKING_HELLO_H
\ No newline at end of file
@@ -0,0 +1,57 @@
+#ifndef KVM_NETWORKING_MULTICAST_ACK_H
+#define KVM_NETWORKING_MULTICAST_ACK_H
+
+#include <networking/message.h>
+#include <networking/identity.h>
+
+namespace kvm {
+    /**
+     * Sent directly back to the sender of a multicast datagram to acknowledge that it was received and
+     * handled.
+     */
+    class MulticastAck : public NetworkMessage {
+    public:
+
+        typedef uint32_t Sequence;
+
+        /**
+         * Default Constructor
+         */
+        MulticastAck();
+
+        /**
+         * Initializing Constructor. Specifies the sequence number of the multicast datagram and the ID of
+         * the node acknowledging it.
+         */
+        MulticastAck(Sequence sequence, NodeId node);
+
+        /**
+         * Get the sequence number of the multicast datagram.
+         */
+        Sequence GetSequence() const;
+
+        /**
+         * Get the ID of the node that acknowledged the datagram.
+         */
+        NodeId GetNodeId() const;
+
+        /**
+         * Serialize this message into the given buffer.
+         */
+        virtual bool Serialize(NetworkBuffer& buffer) const override;
+
+        /**
+         * Deserialize a message of this type out of the given buffer.
+         */
+        virtual bool Deserialize(NetworkBuffer& buffer) override;
+
+    private:
+
+        /// Multicast Datagram Sequence Number
+        Sequence m_sequence;
+        /// Acknowledging Node ID
+        NodeId m_node;
+    };
+}
+
+#endif // KVM_NETWORKING_MULTICAST_ACK_H
\ No newline at end of file
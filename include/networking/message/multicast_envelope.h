@@ -0,0 +1,48 @@
+#ifndef KVM_NETWORKING_MULTICAST_ENVELOPE_H
+#define KVM_NETWORKING_MULTICAST_ENVELOPE_H
+
+#include <networking/message.h>
+
+namespace kvm {
+    /**
+     * Prefixes a message sent over the multicast channel. The sequence number identifies the datagram so
+     * that receivers can acknowledge it; the enclosed message follows the envelope in the same datagram.
+     */
+    class MulticastEnvelope : public NetworkMessage {
+    public:
+
+        typedef uint32_t Sequence;
+
+        /**
+         * Default Constructor
+         */
+        MulticastEnvelope();
+
+        /**
+         * Initializing Constructor. Specifies the sequence number of the multicast datagram.
+         */
+        MulticastEnvelope(Sequence sequence);
+
+        /**
+         * Get the sequence number of the multicast datagram.
+         */
+        Sequence GetSequence() const;
+
+        /**
+         * Serialize this message into the given buffer.
+         */
+        virtual bool Serialize(NetworkBuffer& buffer) const override;
+
+        /**
+         * Deserialize a message of this type out of the given buffer.
+         */
+        virtual bool Deserialize(NetworkBuffer& buffer) override;
+
+    private:
+
+        /// Multicast Datagram Sequence Number
+        Sequence m_sequence;
+    };
+}
+
+#endif // KVM_NETWORKING_MULTICAST_ENVELOPE_H
\ No newline at end of file
@@ -0,0 +1,84 @@
+#ifndef KVM_NETWORKING_MESSAGE_REGISTRY_H
+#define KVM_NETWORKING_MESSAGE_REGISTRY_H
+
+#include <networking/message/types.h>
+#include <networking/message/heartbeat.h>
+#include <networking/message/change_input_request.h>
+#include <networking/message/change_input_response.h>
+#include <networking/message/multicast_envelope.h>
+#include <networking/message/multicast_ack.h>
+#include <networking/message/hello.h>
+#include <networking/message/beacon.h>
+#include <networking/message/display_announcement.h>
+#include <array>
+#include <cstddef>
+
+namespace kvm {
+    /**
+     * Maps a message type ID to the class that represents it. Every type in NetworkMessageType must have
+     * a specialization here.
+     */
+    template<NetworkMessageType Type>
+    struct MessageTraits;
+
+    template<> struct MessageTraits<NetworkMessageType::HEARTBEAT>              { typedef Heartbeat Message; };
+    template<> struct MessageTraits<NetworkMessageType::CHANGE_INPUT_REQUEST>   { typedef ChangeInputRequest Message; };
+    template<> struct MessageTraits<NetworkMessageType::CHANGE_INPUT_RESPONSE>  { typedef ChangeInputResponse Message; };
+    template<> struct MessageTraits<NetworkMessageType::MULTICAST_ENVELOPE>     { typedef MulticastEnvelope Message; };
+    template<> struct MessageTraits<NetworkMessageType::MULTICAST_ACK>          { typedef MulticastAck Message; };
+    template<> struct MessageTraits<NetworkMessageType::HELLO>                  { typedef Hello Message; };
+    template<> struct MessageTraits<NetworkMessageType::BEACON>                 { typedef Beacon Message; };
+    template<> struct MessageTraits<NetworkMessageType::DISPLAY_ANNOUNCEMENT>   { typedef DisplayAnnouncement Message; };
+
+    /**
+     * Routes messages of the given types to a handler. The handler must have an OnMessage() overload for
+     * each type's message class, taking the decoded message followed by the context arguments passed to
+     * Dispatch(). The table that maps type IDs to decoders is built at compile time, so dispatch reads
+     * the type ID once and makes a single indirect call however many types are handled. Handlers with
+     * private OnMessage() overloads should befriend the dispatcher.
+     */
+    template<typename Handler, NetworkMessageType... Types>
+    class MessageDispatcher {
+    public:
+
+        /**
+         * Decode the message at the buffer's current offset and pass it to the handler. Returns false,
+         * leaving the buffer untouched, if the message isn't one of the dispatcher's types. Messages of
+         * a handled type that fail to decode are dropped.
+         */
+        template<typename... Context>
+        static bool Dispatch(NetworkBuffer& buffer, Handler& handler, Context&&... context) {
+            static constexpr auto table = MakeTable<Context&&...>();
+
+            NetworkMessage::Type type;
+            if(!buffer.Peek(type) || type >= table.size() || table[type] == nullptr) {
+                return false;
+            }
+
+            table[type](buffer, handler, std::forward<Context>(context)...);
+            return true;
+        }
+
+    private:
+
+        template<typename... Context>
+        using Entry = void (*)(NetworkBuffer&, Handler&, Context...);
+
+        template<NetworkMessageType Type, typename... Context>
+        static void Decode(NetworkBuffer& buffer, Handler& handler, Context... context) {
+            typename MessageTraits<Type>::Message message;
+            if(message.Deserialize(buffer)) {
+                handler.OnMessage(message, std::forward<Context>(context)...);
+            }
+        }
+
+        template<typename... Context>
+        static constexpr std::array<Entry<Context...>, NetworkMessageTypeCount> MakeTable() {
+            std::array<Entry<Context...>, NetworkMessageTypeCount> table{};
+            ((table[static_cast<size_t>(Types)] = &Decode<Types, Context...>), ...);
+            return table;
+        }
+    };
+}
+
+#endif // KVM_NETWORKING_MESSAGE_REGISTRY_H
\ No newline at end of file
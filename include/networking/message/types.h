@@ -2,13 +2,22 @@
 #define KVM_NETWORKING_MESSAGE_TYPES_H
 
 #include <networking/message.h>
+#include <cstddef>
 
 namespace kvm {
     enum class NetworkMessageType: NetworkMessage::Type {
         HEARTBEAT,
         CHANGE_INPUT_REQUEST,
-        CHANGE_INPUT_RESPONSE
+        CHANGE_INPUT_RESPONSE,
+        MULTICAST_ENVELOPE,
+        MULTICAST_ACK,
+        HELLO,
+        BEACON,
+        DISPLAY_ANNOUNCEMENT
     };
+
+    /// Number of message types. Must follow the last entry in NetworkMessageType.
+    constexpr size_t NetworkMessageTypeCount = static_cast<size_t>(NetworkMessageType::DISPLAY_ANNOUNCEMENT) + 1;
 }
 
 #endif // KVM_NETWORKING_MESSAGE_TYPES_H
\ No newline at end of file
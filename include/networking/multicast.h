@@ -0,0 +1,131 @@
+#ifndef KVM_NETWORKING_MULTICAST_H
+#define KVM_NETWORKING_MULTICAST_H
+
+#include <optional>
+#include <vector>
+#include <networking/datagram.h>
+#include <networking/reactor.h>
+#include <networking/identity.h>
+#include <networking/message/multicast_envelope.h>
+#include <networking/message/multicast_ack.h>
+#include <networking/message/types.h>
+
+namespace kvm {
+    /**
+     * Sends messages to every node in one or more multicast groups with a single datagram per group, and
+     * acknowledges messages received from other nodes. Delivery is best-effort; callers track which
+     * nodes have acknowledged a message and fall back to another transport for the rest.
+     */
+    class MulticastChannel : public Reactor::Handler {
+    public:
+
+        typedef MulticastEnvelope::Sequence Sequence;
+
+        class Listener {
+        public:
+
+            /**
+             * Called when a message arrives over the channel. The buffer holds the enclosed message only.
+             * Return true once the message has been handled so that it is acknowledged to the sender.
+             */
+            virtual bool OnMulticastReceived(const SocketAddress& sender, NetworkBuffer& buffer) = 0;
+
+            /**
+             * Called when a node acknowledges a message that was sent over the channel. Several nodes may
+             * share a sender address, so the acknowledging node is identified by its ID.
+             */
+            virtual void OnMulticastAcknowledged(const SocketAddress& sender, NodeId node, Sequence sequence) = 0;
+        };
+
+        /**
+         * Default Constructor
+         */
+        MulticastChannel();
+
+        /**
+         * Bind the channel to the given port and start watching it with the given reactor.
+         */
+        bool Open(uint16_t port, Reactor& reactor);
+
+        /**
+         * Join the given multicast group. Messages are sent to every joined group, so nodes on different
+         * subnets can be reached by joining a group on each.
+         */
+        bool JoinGroup(const SocketAddress& group);
+
+        /**
+         * Determine whether the channel is open and has joined at least one group.
+         */
+        bool IsActive() const;
+
+        /**
+         * Determine whether a message of the given size fits in a single datagram.
+         */
+        static bool CanCarry(const NetworkBuffer& message);
+
+        /**
+         * Send a message to every joined group. Returns the sequence number that acknowledgements of the
+         * message will carry, or nothing if the message couldn't be sent.
+         */
+        std::optional<Sequence> Send(const NetworkBuffer& message);
+
+        /**
+         * Set the listener that is informed of received messages and acknowledgements.
+         */
+        void SetListener(Listener* listener);
+
+        /**
+         * Set the ID that this node acknowledges received messages with.
+         */
+        void SetNodeId(NodeId id);
+
+        /**
+         * Stop watching the channel and close its socket.
+         */
+        void Close();
+
+        /**
+         * Called by the reactor when datagrams are waiting on the channel.
+         */
+        virtual void OnReadable() override;
+
+        /**
+         * Destructor
+         */
+        ~MulticastChannel();
+
+    private:
+
+        MulticastChannel(const MulticastChannel&) = delete;
+        MulticastChannel& operator=(const MulticastChannel&) = delete;
+
+        template<typename, NetworkMessageType...> friend class MessageDispatcher;
+
+        /**
+         * Inform the listener that a node has acknowledged one of our messages.
+         */
+        void OnMessage(const MulticastAck& ack, const SocketAddress& sender);
+
+        /**
+         * Pass the message enclosed in the envelope to the listener and acknowledge it if accepted.
+         */
+        void OnMessage(const MulticastEnvelope& envelope, const SocketAddress& sender);
+
+        /// Channel Socket
+        DatagramSocket m_socket;
+        /// Reactor watching the channel socket
+        Reactor* m_reactor;
+        /// Joined Groups
+        std::vector<SocketAddress> m_groups;
+        /// Sequence number of the next message sent
+        Sequence m_nextSequence;
+        /// Event Listener
+        Listener* m_listener;
+        /// ID of this node, sent in acknowledgements
+        NodeId m_nodeId;
+        /// Scratch buffer that datagrams are received into
+        NetworkBuffer m_receiveBuffer;
+    };
+}
+
+#endif // KVM_NETWORKING_MULTICAST_H
\ No newline at end of file
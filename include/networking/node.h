@@ -1,13 +1,37 @@
 #ifndef KVM_NODE_H
 #define KVM_NODE_H
 
+#include <deque>
 #include <string>
 #include <vector>
+#include <random>
+#include <optional>
 #include <networking/socket.h>
+#include <networking/reactor.h>
+#include <networking/identity.h>
+#include <networking/failure_detector.h>
+#include <networking/link_statistics.h>
+#include <networking/capture.h>
+#include <networking/message/heartbeat.h>
+#include <networking/message/hello.h>
+#include <networking/message/types.h>
 #include <core/time.h>
 
 namespace kvm {
-    class Node {
+    /**
+     * The details that identify a node. Unlike the node itself, a summary can be kept after the node is
+     * gone and passed to other threads.
+     */
+    struct NodeSummary {
+        /// Node Address
+        SocketAddress               address;
+        /// ID the node last identified itself with, if it ever has
+        std::optional<NodeId>       peerId;
+        /// Whether the node connected to us
+        bool                        inbound;
+    };
+
+    class Node : public Reactor::Handler {
     public:
 
         class Listener {
@@ -25,14 +49,29 @@ namespace kvm {
             virtual void OnNodeDisconnected(const Node& node)
             {}
 
+            /**
+             * Called when the peer's hello message arrives on a new connection, identifying it.
+             */
+            virtual void OnNodeIdentified(Node& node)
+            {}
+
             /**
              * Called when a non-heartbeat message is received from the network.
              */
             virtual void OnMessageReceived(Node& sender, NetworkBuffer& buffer) = 0;
+
+            /**
+             * Called when a message waiting in the send queue is superseded by a later message and won't
+             * be sent. A superseded input change request has its changes carried by the request that
+             * replaced it.
+             */
+            virtual void OnMessageSuperseded(Node& node, NetworkBuffer& buffer)
+            {}
         };
 
         /**
-         * Default Constructor
+         * Construct a Node that connects to the given host. The hostname is resolved in the background
+         * and again whenever connecting to it fails, so the node follows address changes.
          */
         Node(const std::string& hostname, uint16_t port);
 
@@ -42,7 +81,8 @@ namespace kvm {
         Node(Socket socket);
 
         /**
-         * Get this node's network address
+         * Get this node's network address. For outbound nodes this is the address last connected to, or
+         * zero if the hostname hasn't yet been resolved.
          */
         SocketAddress GetAddress() const;
 
@@ -52,7 +92,100 @@ namespace kvm {
         bool IsConnected() const;
 
         /**
-         * Send a message to this node.
+         * Determine whether a connection attempt to this node is in progress.
+         */
+        bool IsConnecting() const;
+
+        /**
+         * Determine whether this node is connected and has identified itself on the current connection.
+         */
+        bool IsIdentified() const;
+
+        /**
+         * Determine whether this node connected to us, rather than us to it. Inbound nodes aren't
+         * reconnected once lost.
+         */
+        bool IsInbound() const;
+
+        /**
+         * Get the identity that the peer last presented, if it has ever identified itself. Kept across
+         * reconnects.
+         */
+        const std::optional<NodeIdentity>& GetPeerIdentity() const;
+
+        /**
+         * Set the identity that is presented to the peer in the hello handshake. The identity must
+         * remain valid for as long as this node does.
+         */
+        void SetLocalIdentity(const NodeIdentity* identity);
+
+        /**
+         * Send our hello message to the peer. Called automatically when an outbound connection is
+         * established.
+         */
+        bool SendHello();
+
+        /**
+         * Stop or resume connection attempts to this node. Used to park a configured node while its peer
+         * is reachable over a different connection.
+         */
+        void SetDormant(bool dormant);
+
+        /**
+         * Determine whether connection attempts to this node are suspended.
+         */
+        bool IsDormant() const;
+
+        /**
+         * Close this node's connection and inform listeners that it has been lost.
+         */
+        void Disconnect();
+
+        /**
+         * Set how often heartbeats are sent to this node and how suspicious of it we must become before
+         * its connection is closed.
+         */
+        void SetFailureDetection(const FailureDetector::Settings& settings);
+
+        /**
+         * Get the current suspicion level that this node has failed. See FailureDetector.
+         */
+        double GetSuspicion() const;
+
+        /**
+         * Get a copy of the details that identify this node.
+         */
+        NodeSummary GetSummary() const;
+
+        /**
+         * Get round-trip time, traffic and liveness telemetry for the link to this node.
+         */
+        LinkStatistics GetStatistics() const;
+
+        /**
+         * Set how many bytes of messages may wait to be sent to this node. Messages wait when the peer
+         * isn't reading as fast as we send; once the queue is full, queued heartbeats are dropped and a
+         * peer that still hasn't made room is disconnected.
+         */
+        void SetSendQueueCapacity(size_t capacity);
+
+        /**
+         * Get the number of messages waiting to be sent to this node.
+         */
+        size_t GetSendQueueDepth() const;
+
+        /**
+         * Record every message sent to or received from this node in the given capture, or stop
+         * recording if it's null. The capture must remain valid for as long as this node does.
+         */
+        void SetCapture(CaptureWriter* capture);
+
+        /**
+         * Send a message to this node. Never blocks: whatever the socket won't take straight away is
+         * queued and sent as the peer makes room. An unsent heartbeat in the queue is replaced by a newer
+         * one, and an unsent input change request is merged into a newer one, so that a slow peer
+         * receives current state rather than a backlog. Returns false if the node isn't connected or
+         * was disconnected for falling too far behind.
          */
         bool Send(NetworkBuffer& buffer);
 
@@ -67,22 +200,160 @@ namespace kvm {
         void RemoveListener(Listener* listener);
 
         /**
-         * Send heartbeat messages, attempt connects and reconnects, etc.
+         * Set the reactor with which this node registers its socket while connected.
+         */
+        void SetReactor(Reactor* reactor);
+
+        /**
+         * Send heartbeat messages, close the connection if the node is suspected to have failed, start
+         * connects and reconnects, etc. Never blocks: connection attempts
+         * complete in the background and are retried with a jittered exponential backoff.
          */
         void Pump();
 
+        /**
+         * Called by the reactor when this node's socket has data waiting.
+         */
+        virtual void OnReadable() override;
+
+        /**
+         * Called by the reactor when a connection attempt to this node has completed or failed, or when
+         * queued messages can be sent.
+         */
+        virtual void OnWritable() override;
+
+        /**
+         * Destructor
+         */
+        ~Node();
+
     private:
 
+        Node(const Node&) = delete;
+        Node& operator=(const Node&) = delete;
+
+        typedef std::chrono::time_point<std::chrono::steady_clock> TimePoint;
+
+        /**
+         * A message waiting to be sent, and how much of its frame has already been written.
+         */
+        struct OutboundMessage {
+            NetworkBuffer           buffer;
+            NetworkMessageType      type;
+            size_t                  sent;
+        };
+
+        template<typename, NetworkMessageType...> friend class MessageDispatcher;
+
+        /**
+         * Record the identity presented in the peer's hello message and inform listeners.
+         */
+        void OnMessage(const Hello& hello);
+
+        /**
+         * Record the heartbeat's arrival and measure the round-trip time from its echo.
+         */
+        void OnMessage(const Heartbeat& heartbeat);
+
+        /**
+         * Send a heartbeat that echoes the last heartbeat received from the peer.
+         */
+        void SendHeartbeat();
+
+        /**
+         * Add a message to the send queue, replacing or merging with a superseded message, and shed
+         * load if the queue has overflowed.
+         */
+        bool Enqueue(NetworkBuffer& buffer, size_t sent);
+
+        /**
+         * Merge an unsent input change request in the queue into the given, newer request. Returns the
+         * merged request, or nothing if there was no request to merge.
+         */
+        std::optional<NetworkBuffer> MergeQueuedRequest(NetworkBuffer& buffer);
+
+        /**
+         * Write queued messages until the queue is empty or the socket is full.
+         */
+        void Flush();
+
+        /**
+         * Start or stop watching the socket for writability, which is only wanted while messages are
+         * queued.
+         */
+        void WatchWritable(bool watch);
+
+        /**
+         * Start watching a newly connected socket for messages and inform listeners.
+         */
+        void OnConnected();
+
+        /**
+         * Abandon a connection attempt and schedule the next one after the current backoff delay, then
+         * double the delay.
+         */
+        void ScheduleReconnect();
+
+        /**
+         * Abandon a failed connection attempt. The hostname may now point elsewhere, so it's resolved
+         * again before the next attempt.
+         */
+        void OnConnectFailed();
+
+        /// Reactor that watches this node's socket
+        Reactor* m_reactor;
         /// Spaces out pump periods
         TimeSpacer m_spacer;
         /// Listeners
         std::vector<Listener*> m_listeners;
+        /// Hostname to connect to. Empty for inbound nodes.
+        std::string m_hostname;
+        /// Port to connect to
+        uint16_t m_port;
         /// Node Address
         SocketAddress m_address;
         /// Socket
         Socket m_socket;
-        /// Time at which the last heartbeat was received from this node, or since we connected to it
-        std::chrono::time_point<std::chrono::system_clock> m_lastSeen;
+        /// Judges from heartbeat arrivals whether this node is still alive
+        FailureDetector m_detector;
+        /// Link telemetry. Identity, state and liveness fields are filled in on request.
+        LinkStatistics m_statistics;
+        /// Timestamp of the last heartbeat received from the peer, echoed back in our next heartbeat
+        Heartbeat::Timestamp m_peerTimestamp;
+        /// Time at which that heartbeat arrived, on our heartbeat clock
+        Heartbeat::Timestamp m_peerTimestampArrival;
+        /// Echo timestamp of the last round trip measured, so that repeated echoes are only counted once
+        Heartbeat::Timestamp m_lastEcho;
+        /// Last round-trip time measured, for jitter, in microseconds
+        std::optional<uint64_t> m_lastRoundTripTime;
+        /// Upper bound of the delay before the next connection attempt
+        std::chrono::milliseconds m_backoff;
+        /// Earliest time at which the next connection attempt may start
+        TimePoint m_nextConnectAttempt;
+        /// Time at which the current connection attempt started
+        TimePoint m_connectStarted;
+        /// Jitters reconnect delays so that nodes don't retry in lockstep
+        std::minstd_rand m_random;
+        /// Whether the peer connected to us
+        bool m_inbound;
+        /// Whether connection attempts are suspended
+        bool m_dormant;
+        /// Identity presented to the peer
+        const NodeIdentity* m_localIdentity;
+        /// Identity last presented by the peer
+        std::optional<NodeIdentity> m_peerIdentity;
+        /// Whether the peer has identified itself on the current connection
+        bool m_identified;
+        /// Messages waiting for the peer to make room
+        std::deque<OutboundMessage> m_sendQueue;
+        /// Total frame size of the queued messages
+        size_t m_sendQueueBytes;
+        /// Most bytes that may be queued before load is shed
+        size_t m_sendQueueCapacity;
+        /// Whether the socket is being watched for writability
+        bool m_watchingWritable;
+        /// Records this node's traffic, if set
+        CaptureWriter* m_capture;
     };
 }
 
@@ -0,0 +1,65 @@
+#ifndef KVM_NETWORKING_POOL_H
+#define KVM_NETWORKING_POOL_H
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <vector>
+
+namespace kvm {
+    /**
+     * Per-thread cache of reusable storage segments for NetworkBuffer instances. Segments are handed out
+     * in power-of-two size classes, so once a thread has seen its peak load, serializing and receiving
+     * messages no longer touches the heap.
+     */
+    class BufferPool {
+    public:
+
+        /// Size of the smallest segment handed out by the pool
+        static const size_t MinSegmentSize;
+        /// Size of the largest segment the pool will cache. Larger requests bypass the pool.
+        static const size_t MaxSegmentSize;
+
+        /**
+         * Get the pool belonging to the calling thread.
+         */
+        static BufferPool& Local();
+
+        /**
+         * Get a segment that can hold at least the given number of bytes. The segment's actual size is
+         * written to capacity.
+         */
+        uint8_t* Acquire(size_t size, size_t& capacity);
+
+        /**
+         * Return a segment to the pool. Segments may be released on a different thread from the one
+         * that acquired them.
+         */
+        void Release(uint8_t* segment, size_t capacity);
+
+        /**
+         * Get the number of segments currently cached by this pool.
+         */
+        size_t GetCachedSegmentCount() const;
+
+        /**
+         * Destructor. Frees all cached segments.
+         */
+        ~BufferPool();
+
+    private:
+
+        /**
+         * Get the size class index for the given segment size.
+         */
+        static size_t GetSizeClass(size_t size);
+
+        /// Number of size classes between MinSegmentSize and MaxSegmentSize
+        static const size_t SizeClassCount = 9;
+
+        /// Free segments, indexed by size class
+        std::array<std::vector<uint8_t*>, SizeClassCount> m_free;
+    };
+}
+
+#endif // KVM_NETWORKING_POOL_H
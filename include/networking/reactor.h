@@ -0,0 +1,90 @@
+#ifndef KVM_NETWORKING_REACTOR_H
+#define KVM_NETWORKING_REACTOR_H
+
+#include <chrono>
+#include <cstdint>
+#include <platform/types.h>
+
+namespace kvm {
+    /**
+     * Waits for readiness events on a set of sockets and dispatches them to registered handlers. Uses
+     * epoll on Linux (or io_uring when built with the io_uring option), kqueue on macOS and WSAPoll on
+     * Windows, so an idle process blocks in a single system call regardless of how many sockets are
+     * registered.
+     */
+    class Reactor {
+    public:
+
+        /**
+         * Readiness events that a socket can be watched for. Combine with bitwise or.
+         */
+        enum Interest : uint8_t {
+            READABLE = 1 << 0,
+            WRITABLE = 1 << 1
+        };
+
+        class Handler {
+        public:
+
+            /**
+             * Called when the registered socket has data available to read, has a pending connection
+             * to accept or has been closed by the peer.
+             */
+            virtual void OnReadable() = 0;
+
+            /**
+             * Called when a socket watched for writability can be written to, which for a socket with a
+             * connection in progress means that the connection attempt has completed or failed.
+             */
+            virtual void OnWritable()
+            {}
+        };
+
+        /**
+         * Default Constructor
+         */
+        Reactor();
+
+        /**
+         * Create the underlying platform event queue.
+         */
+        bool Initialize();
+
+        /**
+         * Start watching the given socket handle for the given readiness events. The handler must remain
+         * valid until the socket is deregistered.
+         */
+        bool Register(PlatformSocket socket, Handler* handler, uint8_t interest = READABLE);
+
+        /**
+         * Change the readiness events that a registered socket is watched for.
+         */
+        bool Modify(PlatformSocket socket, Handler* handler, uint8_t interest);
+
+        /**
+         * Stop watching the given socket handle. Must be called before the socket is closed.
+         */
+        void Deregister(PlatformSocket socket);
+
+        /**
+         * Wait up to the given duration for readiness events and dispatch them to their handlers.
+         * Returns the number of events dispatched.
+         */
+        size_t Poll(std::chrono::milliseconds timeout);
+
+        /**
+         * Destructor
+         */
+        ~Reactor();
+
+    private:
+
+        Reactor(const Reactor&) = delete;
+        Reactor& operator=(const Reactor&) = delete;
+
+        /// Platform Event Queue
+        PlatformReactor m_reactor;
+    };
+}
+
+#endif // KVM_NETWORKING_REACTOR_H
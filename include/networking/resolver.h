@@ -0,0 +1,96 @@
+#ifndef KVM_NETWORKING_RESOLVER_H
+#define KVM_NETWORKING_RESOLVER_H
+
+#include <map>
+#include <deque>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <optional>
+#include <condition_variable>
+#include <networking/socket.h>
+
+namespace kvm {
+    /**
+     * Resolves hostnames on a worker thread and caches the results, so that callers on the network loop
+     * never wait on DNS. Lookups return whatever is cached and queue a resolution in the background when
+     * the cached address is missing or has expired. Numeric addresses are parsed on the spot.
+     */
+    class Resolver {
+    public:
+
+        typedef std::chrono::steady_clock Clock;
+
+        /**
+         * Get the resolver shared by every node in the process.
+         */
+        static Resolver& Shared();
+
+        /**
+         * Construct a resolver that caches addresses for the given time and failed lookups for the given
+         * (shorter) time before resolving the name again. getaddrinfo() doesn't report record TTLs, so
+         * these stand in for them.
+         */
+        Resolver(std::chrono::milliseconds ttl = std::chrono::seconds(60), std::chrono::milliseconds negativeTtl = std::chrono::seconds(5));
+
+        /**
+         * Get the address of the given host without blocking. Returns the cached address, even if it has
+         * expired and is being refreshed, or nothing if the host has never been resolved.
+         */
+        std::optional<SocketAddress> Lookup(const Socket::HostName& hostname, uint16_t port);
+
+        /**
+         * Mark the cached address for the given host as stale, typically because connecting to it failed,
+         * so that the next lookup resolves it again.
+         */
+        void Invalidate(const Socket::HostName& hostname);
+
+        /**
+         * Destructor. Waits for any lookup in progress to finish.
+         */
+        ~Resolver();
+
+    private:
+
+        Resolver(const Resolver&) = delete;
+        Resolver& operator=(const Resolver&) = delete;
+
+        /**
+         * A cached lookup result.
+         */
+        struct Entry {
+            std::optional<SocketAddress>    address;
+            Clock::time_point               expires;
+            bool                            resolving;
+        };
+
+        /**
+         * Queue a resolution of the given host unless one is already queued. Must hold the mutex.
+         */
+        void Queue(const Socket::HostName& hostname, Entry& entry);
+
+        /**
+         * Resolve queued hostnames until the resolver is destroyed.
+         */
+        void Run();
+
+        /// How long to cache resolved addresses
+        std::chrono::milliseconds m_ttl;
+        /// How long to cache failed lookups
+        std::chrono::milliseconds m_negativeTtl;
+        /// Cached addresses, keyed by hostname
+        std::map<Socket::HostName, Entry> m_cache;
+        /// Hostnames waiting to be resolved
+        std::deque<Socket::HostName> m_queue;
+        /// Guards the cache and queue
+        std::mutex m_mutex;
+        /// Wakes the worker when hostnames are queued or the resolver is destroyed
+        std::condition_variable m_wake;
+        /// Set when the worker should exit
+        bool m_stopping;
+        /// Worker thread, started on the first queued lookup
+        std::thread m_worker;
+    };
+}
+
+#endif // KVM_NETWORKING_RESOLVER_H
\ No newline at end of file
@@ -20,6 +20,7 @@ namespace kvm {
 
         enum class SocketState : uint8_t {
             DISCONNECTED,
+            CONNECTING,
             CONNECTED,
             LISTENING
         };
@@ -41,29 +42,59 @@ namespace kvm {
         Socket(PlatformSocket socket, SocketAddress peerAddress);
 
         /**
-         * Connect this socket to the given address.
+         * Start connecting this socket to the given address without blocking. On success the socket is
+         * left in the CONNECTING state; watch it for writability and call CompleteConnect() once it is
+         * writable. Where the platform supports it, TCP Fast Open is requested so that reconnects to a
+         * peer we've connected to before can carry their first message in the SYN.
          */
         ConnectResult Connect(const SocketAddress& address);
 
+        /**
+         * Finish a connection attempt started by Connect(). Intended to be called when a Reactor reports
+         * that the connecting socket is writable. The socket is disconnected if the attempt failed.
+         */
+        ConnectResult CompleteConnect();
+
         /**
          * Bind this socket to the specified port and begin listening for incoming connections.
          */
         ListenResult Listen(uint16_t port);
 
         /**
-         * Accept a new connection.
+         * Accept a new connection. Intended to be called when a Reactor reports that this listening
+         * socket is readable.
          */
         AcceptResult Accept() const;
 
         /**
-         * Send data to the connected peer.
+         * Write as much of a message's frame as the socket will take without blocking, starting the given
+         * number of bytes into the frame. The frame is the length prefix followed by the message, and is
+         * GetFrameSize() bytes long. Returns the number of bytes written, which is zero if the socket's
+         * send buffer is full, or nothing if the connection has failed.
+         */
+        std::optional<size_t> SendPartial(const NetworkBuffer& buffer, size_t offset);
+
+        /**
+         * Get the number of bytes that the given message occupies on the wire, including its length prefix.
+         */
+        static size_t GetFrameSize(const NetworkBuffer& buffer);
+
+        /**
+         * Receive whatever data the connected peer has sent directly into this socket's reassembly
+         * buffer. Intended to be called when a Reactor reports that this socket is readable, and never
+         * blocks if the readiness report turns out to be stale. Returns false if the peer closed the
+         * connection, sent a malformed frame or an error occurred, in which case the caller should
+         * disconnect the socket.
          */
-        bool Send(const NetworkBuffer& buffer);
+        bool Receive();
 
         /**
-         * Receive data from the connected peer.
+         * Get the next complete message from the reassembly buffer, or nullptr once no complete message
+         * remains. The returned buffer is a window over the reassembly buffer, so it is only valid until
+         * the next call to NextMessage() or Receive(). Call repeatedly after Receive() to drain every
+         * message that arrived.
          */
-        bool Receive(NetworkBuffer& buffer);
+        NetworkBuffer* NextMessage();
 
         /**
          * Disconnect this socket.
@@ -80,16 +111,28 @@ namespace kvm {
          */
         SocketAddress GetAddress() const;
 
+        /**
+         * Get the underlying platform socket handle.
+         */
+        PlatformSocket GetHandle() const;
+
         /**
          * Get the socket address for an IP and port combination.
          */
         static GetAddressResult GetAddressForIP(int ip, uint16_t port);
 
         /**
-         * Get the socket address for a hostname and port combination.
+         * Get the socket address for a hostname and port combination. Blocks while the name is resolved;
+         * use a Resolver to look names up without blocking.
          */
         static GetAddressResult GetAddressForHostname(const HostName& hostname, uint16_t port);
 
+        /**
+         * Get the socket address for a numeric IP address and port combination. Never consults DNS, so
+         * it returns immediately and fails for anything that isn't a dotted IPv4 address.
+         */
+        static GetAddressResult ParseAddress(const HostName& hostname, uint16_t port);
+
         /**
          * Comparison Operator
          */
@@ -102,12 +145,25 @@ namespace kvm {
 
     private:
 
+        /**
+         * Check that the frame at the head of the reassembly buffer declares a length that a buffer can
+         * hold, and grow the reassembly buffer so the whole frame fits. Frames whose header hasn't fully
+         * arrived are considered valid.
+         */
+        bool IsFrameValid();
+
         /// Socket Handle
         PlatformSocket m_socket;
         /// Peer address
         SocketAddress m_address;
         /// Current Socket State
         SocketState m_state;
+        /// Data received from the peer. Windowed over each message as it is handed out.
+        NetworkBuffer m_receiveBuffer;
+        /// Offset of the first frame in the reassembly buffer that hasn't been handed out
+        NetworkBuffer::Offset m_receiveFrame;
+        /// Amount of data held in the reassembly buffer
+        NetworkBuffer::Offset m_receiveLength;
     };
 }
 
@@ -0,0 +1,66 @@
+#ifndef KVM_NETWORKING_WAKER_H
+#define KVM_NETWORKING_WAKER_H
+
+#include <atomic>
+#include <platform/types.h>
+#include <networking/reactor.h>
+
+namespace kvm {
+    /**
+     * Lets other threads interrupt a thread that's waiting in Reactor::Poll(). Uses a non-blocking pipe
+     * on Unix and a loopback datagram socket on Windows, watched by the reactor like any other socket.
+     */
+    class Waker : public Reactor::Handler {
+    public:
+
+        /**
+         * Default Constructor
+         */
+        Waker();
+
+        /**
+         * Create the wake channel and register it with the given reactor.
+         */
+        bool Open(Reactor& reactor);
+
+        /**
+         * Make the reactor's current or next Poll() return. Safe to call from any thread, and wakes made
+         * before the reactor gets round to them are folded into one.
+         */
+        void Wake();
+
+        /**
+         * Deregister and close the wake channel.
+         */
+        void Close();
+
+        /**
+         * Called by the reactor when a wake is waiting. Discards it; the woken thread does whatever it
+         * was woken for once Poll() returns.
+         */
+        virtual void OnReadable() override;
+
+        /**
+         * Destructor
+         */
+        ~Waker();
+
+    private:
+
+        Waker(const Waker&) = delete;
+        Waker& operator=(const Waker&) = delete;
+
+        /// Reactor that watches the wake channel
+        Reactor* m_reactor;
+        /// End of the channel that the reactor watches
+        PlatformSocket m_receiver;
+        /// End of the channel that wakes are written to
+        PlatformSocket m_sender;
+        /// Whether a wake has been written that the reactor hasn't yet consumed
+        std::atomic<bool> m_pending;
+        /// Whether the channel is open
+        bool m_open;
+    };
+}
+
+#endif // KVM_NETWORKING_WAKER_H
\ No newline at end of file
@@ -0,0 +1,22 @@
+#ifndef KVM_PLATFORM_PROCESS_H
+#define KVM_PLATFORM_PROCESS_H
+
+#include <chrono>
+#include <cstddef>
+#include <optional>
+
+namespace kvm {
+    /**
+     * Get the CPU time, user and system combined, that the process with the given ID has used so far.
+     * Returns nothing if the process doesn't exist or can't be inspected.
+     */
+    std::optional<std::chrono::microseconds> GetProcessCPUTime(int pid);
+
+    /**
+     * Raise the limit on the number of files and sockets this process may hold open towards the given
+     * count, as far as the system allows. Returns the limit now in effect.
+     */
+    size_t RaiseOpenFileLimit(size_t count);
+}
+
+#endif // KVM_PLATFORM_PROCESS_H
\ No newline at end of file
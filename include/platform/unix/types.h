@@ -7,6 +7,13 @@
 namespace kvm {
     typedef int                 PlatformSocket;
     typedef struct sockaddr_in  SocketAddress;
+
+#if defined(KVM_USE_IO_URING)
+    struct PlatformRing;
+    typedef PlatformRing*       PlatformReactor;
+#else
+    typedef int                 PlatformReactor;
+#endif
 }
 
 #endif // KVM_PLATFORM_TYPES_UNIX_H
\ No newline at end of file
@@ -3,6 +3,7 @@
 
 #include <winsock2.h>
 #include <windef.h>
+#include <vector>
 #include <core/reference.h>
 
 namespace kvm {
@@ -33,6 +34,11 @@ namespace kvm {
   );
 
   typedef struct sockaddr_in SocketAddress;
+
+  typedef struct PlatformReactorStruct {
+    std::vector<WSAPOLLFD>  descriptors;
+    std::vector<void*>      handlers;
+  } PlatformReactor;
 }
 
 #endif // KVM_PLATFORM_TYPES_WINDOWS_H
\ No newline at end of file
@@ -0,0 +1,83 @@
+#include <core/histogram.h>
+#include <algorithm>
+#include <cmath>
+
+namespace kvm {
+  Histogram::Histogram() {
+    Clear();
+  }
+
+  void Histogram::Record(uint64_t value) {
+    m_buckets[BucketFor(value)]++;
+    m_min = m_count == 0 ? value : std::min(m_min, value);
+    m_max = m_count == 0 ? value : std::max(m_max, value);
+    m_sum += static_cast<double>(value);
+    m_count++;
+  }
+
+  void Histogram::Clear() {
+    m_buckets.fill(0);
+    m_count = 0;
+    m_sum   = 0;
+    m_min   = 0;
+    m_max   = 0;
+  }
+
+  uint64_t Histogram::GetCount() const {
+    return m_count;
+  }
+
+  uint64_t Histogram::GetMin() const {
+    return m_min;
+  }
+
+  uint64_t Histogram::GetMax() const {
+    return m_max;
+  }
+
+  double Histogram::GetMean() const {
+    return m_count == 0 ? 0 : m_sum / static_cast<double>(m_count);
+  }
+
+  uint64_t Histogram::GetPercentile(double percentile) const {
+    if(m_count == 0) {
+      return 0;
+    }
+
+    uint64_t rank  = static_cast<uint64_t>(std::ceil(std::min(std::max(percentile, 0.0), 100.0) / 100.0 * static_cast<double>(m_count)));
+    uint64_t seen  = 0;
+
+    for(size_t i = 0; i < BucketCount; i++) {
+      seen += m_buckets[i];
+      if(seen >= rank && seen > 0) {
+        return std::min(BucketUpperBound(i), m_max);
+      }
+    }
+    return m_max;
+  }
+
+  size_t Histogram::BucketFor(uint64_t value) {
+    if(value < SubBucketCount) {
+      return static_cast<size_t>(value);
+    }
+
+    unsigned magnitude = 0;
+    while((value >> magnitude) >= 2 * SubBucketCount) {
+      magnitude++;
+    }
+
+    // Values in [2^(m + bits), 2^(m + bits + 1)) share a power of two and are split on their top bits.
+    return SubBucketCount + magnitude * SubBucketCount + static_cast<size_t>((value >> magnitude) - SubBucketCount);
+  }
+
+  uint64_t Histogram::BucketUpperBound(size_t bucket) {
+    if(bucket < SubBucketCount) {
+      return bucket;
+    }
+
+    unsigned magnitude  = static_cast<unsigned>((bucket - SubBucketCount) / SubBucketCount);
+    uint64_t subBucket  = (bucket - SubBucketCount) % SubBucketCount;
+    uint64_t lower      = (SubBucketCount + subBucket) << magnitude;
+    return lower + ((uint64_t(1) << magnitude) - 1);
+  }
+}
\ No newline at end of file
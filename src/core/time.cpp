@@ -1,13 +1,25 @@
 #include <core/time.h>
+#include <atomic>
 
 namespace kvm {
+  static std::atomic<Clock::Source> ClockSource(nullptr);
+
+  Clock::time_point Clock::now() {
+    auto source = ClockSource.load(std::memory_order_relaxed);
+    return source == nullptr ? std::chrono::steady_clock::now() : source();
+  }
+
+  void Clock::SetSource(Clock::Source source) {
+    ClockSource.store(source, std::memory_order_relaxed);
+  }
+
   TimeSpacer::TimeSpacer() :
-  m_last(std::chrono::system_clock::now())
+  m_last(Clock::now())
   {}
 
   bool TimeSpacer::operator()(const std::chrono::milliseconds duration) {
-    if(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - m_last) >= duration) {
-      m_last = std::chrono::system_clock::now();
+    if(std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - m_last) >= duration) {
+      m_last = Clock::now();
       return true;
     }
     return false;
@@ -100,11 +100,11 @@ namespace kvm {
     }
 
     bool Display::Serialize(NetworkBuffer& buffer) const {
-        return buffer << m_serial;
+        return buffer << Varint(m_serial);
     }
 
     bool Display::Deserialize(NetworkBuffer& buffer) {
-        return buffer >> m_serial;
+        return buffer >> Varint(m_serial);
     }
 
     bool Display::operator==(const Display& other) const {
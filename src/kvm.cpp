@@ -1,15 +1,27 @@
 #include <kvm.h>
 
+#define USB_POLL_INTERVAL_MS 100
+#define DISPLAY_REFRESH_INTERVAL_MS 5000
+
 namespace kvm {
   KVM::KVM(uint16_t listenPort) :
-  m_cluster(listenPort)
+  m_cluster(listenPort),
+  m_network(m_cluster),
+  m_state(KVM::State::INACTIVE),
+  m_pendingRequest(0),
+  m_requestsInTransit(0)
   {
     m_monitor.AddListener(this);
-    m_cluster.AddListener(this);
   }
 
   bool KVM::Initialize() {
-    return m_monitor.Initialize() && m_cluster.Initialize();
+    if(!m_monitor.Initialize() || !m_cluster.Initialize()) {
+      return false;
+    }
+
+    // Peers only send us requests for the displays we announce, so they're announced from the start.
+    UpdateDisplays(ListDisplays());
+    return true;
   }
 
   std::vector<USBDevice> KVM::ListUSBDevices() {
@@ -43,10 +55,56 @@ namespace kvm {
     m_device = device;
   }
 
+  void KVM::SetNodeId(NodeId id) {
+    m_cluster.SetNodeId(id);
+  }
+
+  void KVM::SetFailureDetection(const FailureDetector::Settings& settings) {
+    m_cluster.SetFailureDetection(settings);
+  }
+
+  void KVM::SetCoalesceWindow(std::chrono::milliseconds window) {
+    m_cluster.SetCoalesceWindow(window);
+  }
+
+  void KVM::SetLeaseDuration(std::chrono::milliseconds duration) {
+    m_cluster.SetLeaseDuration(duration);
+  }
+
   void KVM::AddNode(const std::string& hostname, uint16_t port) {
     m_cluster.AddNode(hostname, port);
   }
 
+  bool KVM::EnableMulticast(uint16_t port, const std::vector<std::string>& groups) {
+    if(!m_cluster.EnableMulticast(port)) {
+      return false;
+    }
+
+    for(auto &group : groups) {
+      if(!m_cluster.JoinMulticastGroup(group)) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  bool KVM::EnableDiscovery(uint16_t port) {
+    std::vector<Display::SerialNumber> serials;
+    for(auto &display : ListDisplays()) {
+      serials.push_back(display.GetSerialNumber());
+    }
+    return m_cluster.EnableDiscovery(port, serials);
+  }
+
+  bool KVM::EnableCapture(const std::string& path) {
+    return m_cluster.EnableCapture(path);
+  }
+
+  std::vector<LinkStatistics> KVM::GetLinkStatistics() const {
+    return m_network.IsRunning() ? m_network.GetLinkStatistics() : m_cluster.GetLinkStatistics();
+  }
+
   void KVM::AddListener(KVM::Listener* listener) {
     m_listeners.erase(std::remove(m_listeners.begin(), m_listeners.end(), listener), m_listeners.end());
     m_listeners.push_back(listener);
@@ -74,7 +132,8 @@ namespace kvm {
       }
 
       if(changes.size() > 0) {
-        m_cluster.RequestInputChange(changes);
+        m_network.RequestInputChange(changes);
+        m_requestsInTransit++;
         ChangeState(KVM::State::REQUESTING_INPUT);
         for(auto listener : m_listeners) {
           listener->OnDisplayInputChangesRequested(changes);
@@ -91,35 +150,93 @@ namespace kvm {
     }
   }
 
-  void KVM::OnNodeConnected(const Node& node) {
-    for(auto listener : m_listeners) {
-      listener->OnNodeConnected(node);
-    }
-  }
+  void KVM::OnClusterEvent(const ClusterThread::Event& event) {
+    switch(event.type) {
+      case ClusterThread::Event::Type::NODE_CONNECTED:
+        for(auto listener : m_listeners) {
+          listener->OnNodeConnected(event.summary);
+        }
+        break;
 
-  void KVM::OnNodeDisconnected(const Node& node) {
-    for(auto listener : m_listeners) {
-      listener->OnNodeDisconnected(node);
+      case ClusterThread::Event::Type::NODE_DISCONNECTED:
+        for(auto listener : m_listeners) {
+          listener->OnNodeDisconnected(event.summary);
+        }
+        break;
+
+      case ClusterThread::Event::Type::INPUT_CHANGE_REQUESTED:
+        OnInputChangeRequested(event);
+        break;
+
+      case ClusterThread::Event::Type::INPUT_CHANGE_ACCEPTED:
+        m_pendingRequest = event.id;
+        m_requestsInTransit--;
+        break;
+
+      case ClusterThread::Event::Type::INPUT_CHANGE_RESPONSE:
+        break;
+
+      case ClusterThread::Event::Type::INPUT_CHANGE_COMPLETED:
+        OnInputChangeCompleted(event.id, event.succeeded, event.elapsed);
+        break;
     }
   }
 
-  void KVM::OnInputChangeRequested(const Node& sender, const Display::InputMap& changes) {
+  void KVM::OnInputChangeRequested(const ClusterThread::Event& event) {
     for(auto listener : m_listeners) {
-      listener->OnDisplayInputChangeRequestReceived(sender, changes);
+      listener->OnDisplayInputChangeRequestReceived(event.summary, event.changes);
     }
+
+    // Setting inputs can take hundreds of milliseconds per display, which is why it happens here rather
+    // than on the cluster thread.
+    auto started  = std::chrono::steady_clock::now();
     auto displays = ListDisplays();
+    std::map<Display, bool> results;
 
-    for(auto change : changes) {
+    for(auto change : event.changes) {
       for(auto display : displays) {
         if(display == change.first) {
-          display.SetInput(change.second);
+          results[display] = display.SetInput(change.second);
         }
       }
     }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started);
+    m_network.RespondToInputChangeRequest(event.node, event.id, results, elapsed);
+    UpdateDisplays(displays);
   }
 
-  void KVM::OnInputChangeResponse(const Node& sender, const std::map<Display, bool>& results) {
-    if(m_state == KVM::State::REQUESTING_INPUT && ListDisplaysWithNonPreferredInput().size() == 0) {
+  void KVM::UpdateDisplays(const std::vector<Display>& displays) {
+    std::vector<Display::SerialNumber> serials;
+    for(auto &display : displays) {
+      serials.push_back(display.GetSerialNumber());
+    }
+    std::sort(serials.begin(), serials.end());
+
+    if(m_displays && serials == m_displays.value()) {
+      return;
+    }
+    m_displays = serials;
+
+    // The cluster belongs to its thread once that's running.
+    if(m_network.IsRunning()) {
+      m_network.SetDisplays(serials);
+    } else {
+      m_cluster.SetDisplays(serials);
+    }
+  }
+
+  void KVM::OnInputChangeCompleted(ChangeInputRequest::RequestId id, bool succeeded, std::chrono::microseconds latency) {
+    // Earlier requests may complete after a newer one was sent; only the newest decides our state.
+    if(m_requestsInTransit > 0 || id != m_pendingRequest) {
+      return;
+    }
+
+    for(auto listener : m_listeners) {
+      listener->OnDisplayInputChangesCompleted(succeeded, latency);
+    }
+
+    if(m_state == KVM::State::REQUESTING_INPUT) {
       ChangeState(KVM::State::ACTIVE);
     }
   }
@@ -133,8 +250,26 @@ namespace kvm {
     }
   }
 
-  void KVM::Pump() {
-    m_cluster.Pump();
+  void KVM::Pump(std::chrono::milliseconds timeout) {
+    m_network.Start();
+
+    // USB events are polled for, so don't wait on the cluster for longer than the polling interval.
+    m_network.WaitForEvents(std::min(timeout, std::chrono::milliseconds(USB_POLL_INTERVAL_MS)));
+
+    ClusterThread::Event event;
+    while(m_network.NextEvent(event)) {
+      OnClusterEvent(event);
+    }
+
     m_monitor.CheckForDeviceEvents();
+
+    // There's no notification when monitors come and go, so look for them every so often.
+    if(m_displayRefresh(std::chrono::milliseconds(DISPLAY_REFRESH_INTERVAL_MS))) {
+      UpdateDisplays(ListDisplays());
+    }
+  }
+
+  KVM::~KVM() {
+    m_network.Stop();
   }
 }
\ No newline at end of file
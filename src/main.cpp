@@ -14,6 +14,8 @@ enum class RunMode {
 };
 
 const uint16_t DefaultPort = 10191;
+const uint16_t DefaultMulticastPort = 10192;
+const uint16_t DefaultDiscoveryPort = 10193;
 
 typedef struct {
   std::string               hostname;
@@ -27,8 +29,27 @@ typedef struct {
   kvm::USBDevice::ProductID product;
   kvm::Display::InputMap    inputs;
   std::vector<NodeOption>   nodes;
+  uint16_t                  multicastPort;
+  std::vector<std::string>  multicastGroups;
+  std::string               nodeIdFile;
+  kvm::FailureDetector::Settings failureDetection;
+  int                       linkStatsInterval;
+  int                       coalesceWindow;
+  int                       leaseDuration;
+  bool                      discover;
+  uint16_t                  discoveryPort;
+  std::string               captureFile;
 } Options;
 
+std::string DefaultNodeIdFile() {
+#if defined(KVM_OS_WINDOWS)
+  const char* home = getenv("USERPROFILE");
+#else
+  const char* home = getenv("HOME");
+#endif
+  return home != nullptr ? std::string(home) + "/.kvm-node-id" : std::string(".kvm-node-id");
+}
+
 bool ParseOptions(int argc, char** argv, Options& options) {
   options.inputs.clear();
   
@@ -37,6 +58,15 @@ bool ParseOptions(int argc, char** argv, Options& options) {
     options.inputs[display] = display.GetInput();
   }
   options.port = DefaultPort;
+  options.multicastPort = DefaultMulticastPort;
+  options.multicastGroups.clear();
+  options.nodeIdFile = DefaultNodeIdFile();
+  options.linkStatsInterval = 0;
+  options.coalesceWindow = 5;
+  options.leaseDuration = 1000;
+  options.discover = false;
+  options.discoveryPort = DefaultDiscoveryPort;
+  options.captureFile.clear();
   options.mode = RunMode::WATCH;
 
   for(int i = 1; i != argc; i++) {
@@ -76,6 +106,28 @@ bool ParseOptions(int argc, char** argv, Options& options) {
       auto serial       = atoi(argv[++i]);
       auto input        = kvm::Display::StringToInput(argv[++i]);
       options.inputs[kvm::Display(serial)] = input;
+    } else if(strcmp(argv[i], "--multicast-group") == 0 && (i + 1) < argc) {
+      options.multicastGroups.push_back(argv[++i]);
+    } else if(strcmp(argv[i], "--multicast-port") == 0 && (i + 1) < argc) {
+      options.multicastPort = atoi(argv[++i]);
+    } else if(strcmp(argv[i], "--heartbeat-interval") == 0 && (i + 1) < argc) {
+      options.failureDetection.heartbeatInterval = std::chrono::milliseconds(atoi(argv[++i]));
+    } else if(strcmp(argv[i], "--failure-threshold") == 0 && (i + 1) < argc) {
+      options.failureDetection.threshold = atof(argv[++i]);
+    } else if(strcmp(argv[i], "--discover") == 0) {
+      options.discover = true;
+    } else if(strcmp(argv[i], "--discovery-port") == 0 && (i + 1) < argc) {
+      options.discoveryPort = atoi(argv[++i]);
+    } else if(strcmp(argv[i], "--capture") == 0 && (i + 1) < argc) {
+      options.captureFile = argv[++i];
+    } else if(strcmp(argv[i], "--coalesce-window") == 0 && (i + 1) < argc) {
+      options.coalesceWindow = atoi(argv[++i]);
+    } else if(strcmp(argv[i], "--lease-duration") == 0 && (i + 1) < argc) {
+      options.leaseDuration = atoi(argv[++i]);
+    } else if(strcmp(argv[i], "--link-stats") == 0 && (i + 1) < argc) {
+      options.linkStatsInterval = atoi(argv[++i]);
+    } else if(strcmp(argv[i], "--node-id-file") == 0 && (i + 1) < argc) {
+      options.nodeIdFile = argv[++i];
     } else if(strcmp(argv[i], "--node") == 0 && (i + 1) < argc) {
       std::string node(argv[++i]);
 
@@ -92,15 +144,29 @@ bool ParseOptions(int argc, char** argv, Options& options) {
   return true;
 }
 
+void PrintLinkStatistics(const std::vector<kvm::LinkStatistics>& links, std::ostream& out) {
+  for(auto& link : links) {
+    out << "Link " << kvm::AddressToString(link.address) << (link.connected ? " up" : " down")
+        << " rtt p50/p99/max " << link.roundTripTime.GetPercentile(50) << "/" << link.roundTripTime.GetPercentile(99) << "/" << link.roundTripTime.GetMax() << "us"
+        << " jitter p99 " << link.jitter.GetPercentile(99) << "us"
+        << " sent " << link.messagesSent << " (" << link.bytesSent << "B)"
+        << " received " << link.messagesReceived << " (" << link.bytesReceived << "B)"
+        << " queued " << link.sendQueueDepth << " (" << link.sendQueueBytes << "B)"
+        << " shed " << link.messagesShed
+        << " last seen " << link.lastSeenAge.count() << "ms ago"
+        << " phi " << std::setprecision(2) << link.suspicion << std::endl;
+  }
+}
+
 class ConsoleListener : public kvm::KVM::Listener {
 public:
 
-  virtual void OnNodeConnected(const kvm::Node& node) override {
-    std::cout << "Node Connected: " << kvm::AddressToString(node.GetAddress()) << std::endl;
+  virtual void OnNodeConnected(const kvm::NodeSummary& node) override {
+    std::cout << "Node Connected: " << kvm::AddressToString(node.address) << std::endl;
   }
 
-  virtual void OnNodeDisconnected(const kvm::Node& node) override {
-    std::cout << "Node Disconnected: " << kvm::AddressToString(node.GetAddress()) << std::endl;
+  virtual void OnNodeDisconnected(const kvm::NodeSummary& node) override {
+    std::cout << "Node Disconnected: " << kvm::AddressToString(node.address) << std::endl;
   }
 
   virtual void OnStateChange(kvm::KVM::State previousState, kvm::KVM::State newState) override {
@@ -123,13 +189,17 @@ public:
     std::cout << "Trigger Device Connected: " << device.GetDescription() << std::endl;
   }
 
-  virtual void OnDisplayInputChangeRequestReceived(const kvm::Node& sender, const kvm::Display::InputMap& changes) override {
+  virtual void OnDisplayInputChangeRequestReceived(const kvm::NodeSummary& sender, const kvm::Display::InputMap& changes) override {
     std::cout << "Received Input Change Request with " << changes.size() << " Input Changes..." << std::endl;
   }
 
   virtual void OnDisplayInputChangesRequested(const kvm::Display::InputMap& changes) override {
     std::cout << "Requested " << changes.size() << " Input Changes..." << std::endl;
   }
+
+  virtual void OnDisplayInputChangesCompleted(bool succeeded, std::chrono::microseconds latency) override {
+    std::cout << "Input Changes " << (succeeded ? "Completed" : "Failed") << " after " << (latency.count() / 1000.0) << "ms" << std::endl;
+  }
 };
 
 int main(int argc, char** argv) {
@@ -151,6 +221,10 @@ int main(int argc, char** argv) {
       kvm.AddListener(&listener);
       kvm::USBDevice trigger(options.vendor, options.product);
 
+      kvm.SetNodeId(kvm::NodeIdentity::LoadOrCreate(options.nodeIdFile));
+      kvm.SetFailureDetection(options.failureDetection);
+      kvm.SetCoalesceWindow(std::chrono::milliseconds(options.coalesceWindow));
+      kvm.SetLeaseDuration(std::chrono::milliseconds(options.leaseDuration));
       kvm.SetTriggerDevice(trigger);
       kvm.SetDesiredInputs(options.inputs);
 
@@ -161,14 +235,42 @@ int main(int argc, char** argv) {
         std::cout << "Prefer Input " << kvm::Display::InputToString(input.second) << " For Display " << input.first.GetSerialNumber() << std::endl;
       }
 
+      if(!options.multicastGroups.empty()) {
+        if(kvm.EnableMulticast(options.multicastPort, options.multicastGroups)) {
+          std::cout << "Multicasting Input Change Requests on Port " << options.multicastPort << std::endl;
+        } else {
+          std::cerr << "Failed to enable multicast, falling back to TCP" << std::endl;
+        }
+      }
+
+      if(options.discover) {
+        if(kvm.EnableDiscovery(options.discoveryPort)) {
+          std::cout << "Discovering Nodes on Port " << options.discoveryPort << std::endl;
+        } else {
+          std::cerr << "Failed to enable node discovery" << std::endl;
+        }
+      }
+
+      if(!options.captureFile.empty()) {
+        if(kvm.EnableCapture(options.captureFile)) {
+          std::cout << "Capturing Node Traffic to " << options.captureFile << std::endl;
+        } else {
+          std::cerr << "Failed to open capture file " << options.captureFile << std::endl;
+        }
+      }
+
       for(auto node : options.nodes) {
         std::cout << "Adding Node " << node.hostname << ":" << node.port << std::endl;
         kvm.AddNode(node.hostname, node.port);
       }
 
+      kvm::TimeSpacer statsSpacer;
       while(true) {
-        std::this_thread::sleep_for(std::chrono::seconds(1));
-        kvm.Pump();
+        kvm.Pump(std::chrono::seconds(1));
+
+        if(options.linkStatsInterval > 0 && statsSpacer(std::chrono::seconds(options.linkStatsInterval))) {
+          PrintLinkStatistics(kvm.GetLinkStatistics(), std::cout);
+        }
       }
     } else {
       for(std::pair<kvm::Display, kvm::Display::Input> input : options.inputs) {
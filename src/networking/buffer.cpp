@@ -1,53 +1,157 @@
 #include <networking/buffer.h>
 #include <networking/serializable.h>
+#include <networking/pool.h>
 #include <core/core.h>
 #include <cstring>
+#include <utility>
 
 #define MAX_STRING_LENGTH 1024
 
 namespace kvm {
+    const NetworkBuffer::Offset NetworkBuffer::MaxCapacity = 1024 * 1024;
+
     NetworkBuffer::NetworkBuffer() :
+    m_buffer(nullptr),
+    m_capacity(0),
+    m_base(0),
     m_offset(0),
     m_length(0),
     m_state(NetworkBuffer::State::OK)
     {}
 
     NetworkBuffer::NetworkBuffer(const NetworkBuffer& other) :
+    m_buffer(nullptr),
+    m_capacity(0),
+    m_base(0),
+    m_offset(other.m_offset - other.m_base),
+    m_length(other.m_length - other.m_base),
+    m_state(other.m_state) {
+        // Only the window is copied, and becomes the whole of the copy.
+        if(m_length > 0) {
+            m_buffer = BufferPool::Local().Acquire(m_length, m_capacity);
+            memcpy(m_buffer, other.m_buffer + other.m_base, m_length);
+        }
+    }
+
+    NetworkBuffer::NetworkBuffer(NetworkBuffer&& other) :
     m_buffer(other.m_buffer),
-    m_state(other.m_state),
+    m_capacity(other.m_capacity),
+    m_base(other.m_base),
     m_offset(other.m_offset),
-    m_length(other.m_length)
-    {}
+    m_length(other.m_length),
+    m_state(other.m_state) {
+        other.m_buffer      = nullptr;
+        other.m_capacity    = 0;
+        other.m_base        = 0;
+        other.m_offset      = 0;
+        other.m_length      = 0;
+    }
+
+    NetworkBuffer& NetworkBuffer::operator=(const NetworkBuffer& other) {
+        if(this != &other) {
+            NetworkBuffer copy(other);
+            *this = std::move(copy);
+        }
+        return *this;
+    }
+
+    NetworkBuffer& NetworkBuffer::operator=(NetworkBuffer&& other) {
+        if(this != &other) {
+            BufferPool::Local().Release(m_buffer, m_capacity);
+
+            m_buffer    = other.m_buffer;
+            m_capacity  = other.m_capacity;
+            m_state     = other.m_state;
+            m_base      = other.m_base;
+            m_offset    = other.m_offset;
+            m_length    = other.m_length;
+
+            other.m_buffer      = nullptr;
+            other.m_capacity    = 0;
+            other.m_base        = 0;
+            other.m_offset      = 0;
+            other.m_length      = 0;
+        }
+        return *this;
+    }
+
+    NetworkBuffer::~NetworkBuffer() {
+        BufferPool::Local().Release(m_buffer, m_capacity);
+    }
 
     NetworkBuffer::State NetworkBuffer::GetState() const {
         return m_state;
     }
 
     NetworkBuffer::Offset NetworkBuffer::GetCapacity() const {
-        return m_buffer.max_size();
+        return m_capacity - m_base;
+    }
+
+    NetworkBuffer& NetworkBuffer::Reserve(NetworkBuffer::Offset capacity) {
+        if(!Grow(m_base + capacity)) {
+            m_state = NetworkBuffer::State::ERROR_OVERFLOW;
+        }
+        return *this;
     }
 
     NetworkBuffer::Offset NetworkBuffer::GetOffset() const {
-        return m_offset;
+        return m_offset - m_base;
     }
 
     uint8_t* NetworkBuffer::GetBuffer() {
-        return m_buffer.data();
+        return m_buffer + m_base;
     }
 
     const uint8_t* NetworkBuffer::GetBuffer() const {
-        return m_buffer.data();
+        return m_buffer + m_base;
     }
 
     NetworkBuffer::Offset NetworkBuffer::GetSize() const {
-        return m_length;
+        return m_length - m_base;
+    }
+
+    NetworkBuffer::Offset NetworkBuffer::GetRemaining() const {
+        return m_length - m_offset;
     }
 
-    NetworkBuffer& NetworkBuffer::Append(uint8_t* data, size_t size) {
-        if(m_offset + size <= m_buffer.max_size()) {
-            memcpy(m_buffer.data() + m_offset, data, size);
+    NetworkBuffer& NetworkBuffer::Append(const uint8_t* data, size_t size) {
+        if(Grow(m_length + size)) {
+            memcpy(m_buffer + m_length, data, size);
+            m_length += size;
+        } else {
+            m_state = NetworkBuffer::State::ERROR_OVERFLOW;
+        }
+
+        return *this;
+    }
+
+    NetworkBuffer& NetworkBuffer::Skip(NetworkBuffer::Offset size) {
+        if(m_offset + size <= m_length) {
             m_offset += size;
-            m_length = m_offset;
+        } else {
+            m_state = NetworkBuffer::State::ERROR_OVERFLOW;
+        }
+
+        return *this;
+    }
+
+    NetworkBuffer& NetworkBuffer::Compact() {
+        if(m_offset > 0) {
+            memmove(m_buffer, m_buffer + m_offset, m_length - m_offset);
+            m_length -= m_offset;
+            m_offset  = 0;
+        }
+        m_base = 0;
+
+        return *this;
+    }
+
+    NetworkBuffer& NetworkBuffer::Window(NetworkBuffer::Offset start, NetworkBuffer::Offset length) {
+        if(start + length <= m_capacity) {
+            m_state     = NetworkBuffer::State::OK;
+            m_base      = start;
+            m_offset    = start;
+            m_length    = start + length;
         } else {
             m_state = NetworkBuffer::State::ERROR_OVERFLOW;
         }
@@ -57,13 +161,14 @@ namespace kvm {
 
     NetworkBuffer& NetworkBuffer::Reset() {
         m_state     = NetworkBuffer::State::OK;
-        m_offset    = 0;
+        m_offset    = m_base;
         return *this;
     }
-    NetworkBuffer& NetworkBuffer::Reset(uint8_t* data, size_t size) {
-        if(size <= m_buffer.max_size()) {
-            memcpy(m_buffer.data(), data, size);
+    NetworkBuffer& NetworkBuffer::Reset(const uint8_t* data, size_t size) {
+        if(Grow(size)) {
+            memcpy(m_buffer, data, size);
             m_state     = NetworkBuffer::State::OK;
+            m_base      = 0;
             m_offset    = 0;
             m_length    = size;
         } else {
@@ -72,13 +177,6 @@ namespace kvm {
         
         return *this;
     }
-    NetworkBuffer& NetworkBuffer::Reset(NetworkBuffer::Buffer buffer) {
-        m_state     = NetworkBuffer::State::OK;
-        m_offset    = 0;
-        m_buffer    = buffer;
-        
-        return *this;
-    }
 
     NetworkBuffer& operator>>(NetworkBuffer& buffer, uint8_t& value) {
         return buffer.Deserialize(&value, sizeof(value));
@@ -106,6 +204,12 @@ namespace kvm {
         value = NetworkToHost(value);
         return buffer;
     }
+    NetworkBuffer& operator>>(NetworkBuffer& buffer, uint64_t& value) {
+        uint32_t high, low;
+        buffer >> high >> low;
+        value = (static_cast<uint64_t>(high) << 32) | low;
+        return buffer;
+    }
     NetworkBuffer& operator>>(NetworkBuffer& buffer, bool& value) {
         uint8_t b;
         buffer >> b;
@@ -113,12 +217,18 @@ namespace kvm {
         return buffer;
     }
     NetworkBuffer& operator>>(NetworkBuffer& buffer, std::string& value) {
+        std::string_view view;
+        if(buffer >> view) {
+            value.assign(view.data(), view.size());
+        }
+        return buffer;
+    }
+    NetworkBuffer& operator>>(NetworkBuffer& buffer, std::string_view& value) {
         uint32_t length;
-        buffer >> length;
-        if(buffer.GetState() == NetworkBuffer::State::OK && length <= MAX_STRING_LENGTH) {
-            char* str = new char[length];
-            buffer.Deserialize(str, length);
-            value.assign(str, length);
+        buffer >> Varint(length);
+        if(buffer.GetState() == NetworkBuffer::State::OK && length <= MAX_STRING_LENGTH && buffer.m_offset + length <= buffer.m_length) {
+            value = std::string_view(reinterpret_cast<const char*>(buffer.m_buffer + buffer.m_offset), length);
+            buffer.m_offset += length;
         } else {
             buffer.m_state = NetworkBuffer::State::ERROR_OVERFLOW;
         }
@@ -152,14 +262,19 @@ namespace kvm {
         auto swapped = HostToNetwork(value);
         return buffer.Serialize(&swapped, sizeof(swapped));
     }
+    NetworkBuffer& operator<<(NetworkBuffer& buffer, uint64_t value) {
+        return buffer << static_cast<uint32_t>(value >> 32) << static_cast<uint32_t>(value);
+    }
     NetworkBuffer& operator<<(NetworkBuffer& buffer, bool value) {
-        auto swapped = HostToNetwork(static_cast<uint8_t>(value));
-        return buffer.Serialize(&swapped, sizeof(swapped));
+        return buffer << static_cast<uint8_t>(value);
     }
     NetworkBuffer& operator<<(NetworkBuffer& buffer, const std::string& value) {
+        return buffer << std::string_view(value);
+    }
+    NetworkBuffer& operator<<(NetworkBuffer& buffer, std::string_view value) {
         if(value.length() <= MAX_STRING_LENGTH) {
-            buffer << static_cast<uint32_t>(value.length());
-            return buffer.Serialize(reinterpret_cast<const void*>(value.c_str()), value.length());
+            buffer << Varint(value.length());
+            return buffer.Serialize(reinterpret_cast<const void*>(value.data()), value.length());
         } else {
             buffer.m_state = NetworkBuffer::State::ERROR_OVERFLOW;
         }     
@@ -170,10 +285,55 @@ namespace kvm {
         return buffer;    
     }
 
+    NetworkBuffer& NetworkBuffer::WriteVarint(uint64_t value) {
+        uint8_t encoded[10];
+        size_t  length = 0;
+
+        do {
+            encoded[length] = static_cast<uint8_t>(value & 0x7F);
+            value >>= 7;
+            if(value != 0) {
+                encoded[length] |= 0x80;
+            }
+            length++;
+        } while(value != 0);
+
+        return Serialize(encoded, length);
+    }
+
+    NetworkBuffer& NetworkBuffer::ReadVarint(uint64_t& value, uint64_t maximum) {
+        value = 0;
+
+        for(unsigned shift = 0; m_state == NetworkBuffer::State::OK; shift += 7) {
+            uint8_t byte;
+            if(shift > 63 || !Deserialize(&byte, sizeof(byte))) {
+                m_state = NetworkBuffer::State::ERROR_OVERFLOW;
+                break;
+            }
+
+            // The tenth byte may only contribute the top bit of a 64-bit value.
+            uint64_t bits = static_cast<uint64_t>(byte & 0x7F);
+            if(shift == 63 && bits > 1) {
+                m_state = NetworkBuffer::State::ERROR_OVERFLOW;
+                break;
+            }
+
+            value |= bits << shift;
+            if((byte & 0x80) == 0) {
+                if(value > maximum) {
+                    m_state = NetworkBuffer::State::ERROR_OVERFLOW;
+                }
+                break;
+            }
+        }
+
+        return *this;
+    }
+
     NetworkBuffer& NetworkBuffer::Deserialize(void* out, NetworkBuffer::Offset size) {
         if(m_state == NetworkBuffer::State::OK) {
             if(m_offset + size <= m_length) {
-                memcpy(out, m_buffer.data() + m_offset, size);
+                memcpy(out, m_buffer + m_offset, size);
                 m_offset += size;
             } else {
                 m_state = NetworkBuffer::State::ERROR_OVERFLOW;
@@ -184,8 +344,8 @@ namespace kvm {
 
     NetworkBuffer& NetworkBuffer::Serialize(const void* in, NetworkBuffer::Offset size) {
         if(m_state == NetworkBuffer::State::OK) {
-            if(m_offset + size < m_buffer.max_size()) {
-                memcpy(m_buffer.data() + m_offset, in, size);
+            if(Grow(m_offset + size)) {
+                memcpy(m_buffer + m_offset, in, size);
                 m_offset += size;
                 m_length = m_offset;
             } else {
@@ -195,6 +355,27 @@ namespace kvm {
         return *this;
     }
 
+    bool NetworkBuffer::Grow(NetworkBuffer::Offset size) {
+        if(size <= m_capacity) {
+            return true;
+        }
+        if(size > MaxCapacity) {
+            return false;
+        }
+
+        NetworkBuffer::Offset capacity;
+        uint8_t* buffer = BufferPool::Local().Acquire(size, capacity);
+
+        if(m_buffer != nullptr) {
+            memcpy(buffer, m_buffer, m_length);
+            BufferPool::Local().Release(m_buffer, m_capacity);
+        }
+
+        m_buffer    = buffer;
+        m_capacity  = capacity;
+        return true;
+    }
+
     NetworkBuffer::operator bool() const {
         return m_state == NetworkBuffer::State::OK;
     }
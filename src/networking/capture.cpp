@@ -0,0 +1,168 @@
+#include <networking/capture.h>
+#include <platform/functions.h>
+#include <core/time.h>
+#include <cstring>
+
+#define CAPTURE_MAGIC           "KVMC"
+#define CAPTURE_MAGIC_SIZE      4
+#define CAPTURE_VERSION         1
+#define CAPTURE_HEADER_SIZE     (CAPTURE_MAGIC_SIZE + sizeof(uint8_t) + sizeof(uint64_t))
+/// Two ten-byte varints, the direction, the IPv4 address and the port
+#define MAX_RECORD_HEADER_SIZE  (10 + sizeof(uint8_t) + sizeof(uint32_t) + sizeof(uint16_t) + 10)
+
+namespace kvm {
+  CaptureWriter::CaptureWriter()
+  {}
+
+  bool CaptureWriter::Open(const std::string& path) {
+    Close();
+
+    m_file.open(path, std::ios::binary | std::ios::trunc);
+    if(!m_file) {
+      return false;
+    }
+
+    auto now = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch());
+    m_last   = Clock::now();
+
+    m_header.Reset();
+    m_header << static_cast<uint8_t>(CAPTURE_VERSION) << static_cast<uint64_t>(now.count());
+    m_file.write(CAPTURE_MAGIC, CAPTURE_MAGIC_SIZE);
+    m_file.write(reinterpret_cast<const char*>(m_header.GetBuffer()), m_header.GetOffset());
+
+    if(!m_file) {
+      Close();
+      return false;
+    }
+    return true;
+  }
+
+  bool CaptureWriter::IsOpen() const {
+    return m_file.is_open();
+  }
+
+  void CaptureWriter::Write(CapturedMessage::Direction direction, const SocketAddress& peer, const NetworkBuffer& message) {
+    if(!m_file.is_open()) {
+      return;
+    }
+
+    // Timestamps are deltas so that records made in quick succession need only a byte or two for them.
+    auto now    = Clock::now();
+    auto delta  = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(now - m_last).count());
+    m_last      = now;
+
+    m_header.Reset();
+    m_header << Varint(delta)
+             << static_cast<uint8_t>(direction)
+             << NetworkToHost(static_cast<uint32_t>(peer.sin_addr.s_addr))
+             << NetworkToHost(static_cast<uint16_t>(peer.sin_port))
+             << Varint(static_cast<uint64_t>(message.GetSize()));
+
+    m_file.write(reinterpret_cast<const char*>(m_header.GetBuffer()), m_header.GetOffset());
+    m_file.write(reinterpret_cast<const char*>(message.GetBuffer()), message.GetSize());
+  }
+
+  void CaptureWriter::Flush() {
+    if(m_file.is_open()) {
+      m_file.flush();
+    }
+  }
+
+  void CaptureWriter::Close() {
+    if(m_file.is_open()) {
+      m_file.close();
+    }
+  }
+
+  CaptureWriter::~CaptureWriter() {
+    Close();
+  }
+
+  CaptureReader::CaptureReader() :
+  m_startTime(0),
+  m_timestamp(0)
+  {}
+
+  bool CaptureReader::Open(const std::string& path) {
+    if(m_file.is_open()) {
+      m_file.close();
+    }
+
+    m_file.open(path, std::ios::binary);
+    m_timestamp = std::chrono::microseconds(0);
+
+    uint8_t header[CAPTURE_HEADER_SIZE];
+    if(!m_file.read(reinterpret_cast<char*>(header), sizeof(header)) || memcmp(header, CAPTURE_MAGIC, CAPTURE_MAGIC_SIZE) != 0) {
+      m_file.close();
+      return false;
+    }
+
+    NetworkBuffer fields;
+    uint8_t version;
+    fields.Reset(header + CAPTURE_MAGIC_SIZE, sizeof(header) - CAPTURE_MAGIC_SIZE);
+    if(!(fields >> version >> m_startTime) || version != CAPTURE_VERSION) {
+      m_file.close();
+      return false;
+    }
+    return true;
+  }
+
+  std::chrono::system_clock::time_point CaptureReader::GetStartTime() const {
+    return std::chrono::system_clock::time_point(std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::microseconds(m_startTime)));
+  }
+
+  bool CaptureReader::Next(CapturedMessage& record) {
+    if(!m_file.is_open()) {
+      return false;
+    }
+
+    // Record headers vary in length, so read as much as the longest could take and then step back to
+    // the end of the one actually there.
+    uint8_t header[MAX_RECORD_HEADER_SIZE];
+    auto start = m_file.tellg();
+    m_file.read(reinterpret_cast<char*>(header), sizeof(header));
+    auto available = static_cast<size_t>(m_file.gcount());
+    m_file.clear();
+    if(available == 0) {
+      return false;
+    }
+
+    NetworkBuffer fields;
+    uint64_t delta      = 0;
+    uint64_t length     = 0;
+    uint8_t  direction  = 0;
+    uint32_t ip         = 0;
+    uint16_t port       = 0;
+    // A damaged record leaves the file where it starts, so that IsAtEnd() reports it.
+    fields.Reset(header, available);
+    fields >> Varint(delta) >> direction >> ip >> port;
+    fields.ReadVarint(length, NetworkBuffer::MaxCapacity);
+    if(!fields || direction > static_cast<uint8_t>(CapturedMessage::Direction::SENT)) {
+      m_file.seekg(start);
+      return false;
+    }
+
+    m_payload.resize(length);
+    m_file.seekg(start + static_cast<std::streamoff>(fields.GetOffset()));
+    if(!m_file.read(reinterpret_cast<char*>(m_payload.data()), length)) {
+      m_file.clear();
+      m_file.seekg(start);
+      return false;
+    }
+
+    m_timestamp += std::chrono::microseconds(delta);
+
+    record.timestamp            = m_timestamp;
+    record.direction            = static_cast<CapturedMessage::Direction>(direction);
+    record.peer                 = SocketAddress{};
+    record.peer.sin_family      = AF_INET;
+    record.peer.sin_addr.s_addr = HostToNetwork(ip);
+    record.peer.sin_port        = HostToNetwork(port);
+    record.message.Reset(m_payload.data(), m_payload.size());
+    return true;
+  }
+
+  bool CaptureReader::IsAtEnd() {
+    return m_file.is_open() && m_file.peek() == std::ifstream::traits_type::eof();
+  }
+}
\ No newline at end of file
@@ -1,44 +1,402 @@
 #include <networking/cluster.h>
-#include <networking/message.h>
-#include <networking/message/types.h>
-#include <networking/message/change_input_request.h>
-#include <networking/message/change_input_response.h>
+#include <networking/message/registry.h>
+#include <algorithm>
 
 namespace kvm {
+  const size_t Cluster::ReceivedRequestHistory = 256;
+
   Cluster::Cluster(uint16_t listenPort) :
-  m_listenPort(listenPort)
-  {}
+  m_listenPort(listenPort),
+  m_multicastPort(0),
+  m_multicastAckTimeout(25),
+  m_nextRequestId(1),
+  m_requestTimeout(5000),
+  m_coalesceWindow(5),
+  m_beaconInterval(2000) {
+    m_multicast.SetListener(this);
+    m_discovery.SetListener(this);
+  }
 
   bool Cluster::Initialize() {
-    return !m_socket.Listen(m_listenPort).has_value();
+    if(!m_reactor.Initialize() || !m_waker.Open(m_reactor) || m_socket.Listen(m_listenPort).has_value()) {
+      return false;
+    }
+    return m_reactor.Register(m_socket.GetHandle(), this);
+  }
+
+  void Cluster::SetNodeId(NodeId id) {
+    m_identity.SetId(id);
+    m_multicast.SetNodeId(id);
+  }
+
+  const NodeIdentity& Cluster::GetIdentity() const {
+    return m_identity;
+  }
+
+  void Cluster::SetFailureDetection(const FailureDetector::Settings& settings) {
+    m_failureDetection = settings;
+    for(auto &node : m_nodes) {
+      node.SetFailureDetection(settings);
+    }
+  }
+
+  void Cluster::SetSendQueueCapacity(size_t capacity) {
+    m_sendQueueCapacity = capacity;
+    for(auto &node : m_nodes) {
+      node.SetSendQueueCapacity(capacity);
+    }
+  }
+
+  bool Cluster::EnableCapture(const std::string& path) {
+    if(!m_capture.Open(path)) {
+      return false;
+    }
+
+    for(auto &node : m_nodes) {
+      node.SetCapture(&m_capture);
+    }
+    return true;
   }
 
   void Cluster::AddNode(const std::string& hostname, uint16_t port) {
-    Node node(hostname, port);
-    node.AddListener(this);
-    m_nodes.push_back(node);
+    AttachNode(std::make_unique<Node>(hostname, port));
   }
 
-  void Cluster::RequestInputChange(const std::map<Display, Display::Input>& changes) {
-    ChangeInputRequest request(changes);
-    NetworkBuffer buffer;
-    if(request.Serialize(buffer)) {
+  Cluster::NodeHandle Cluster::AttachNode(std::unique_ptr<Node> node) {
+    node->AddListener(this);
+    node->SetLocalIdentity(&m_identity);
+    node->SetFailureDetection(m_failureDetection);
+    if(m_sendQueueCapacity) {
+      node->SetSendQueueCapacity(m_sendQueueCapacity.value());
+    }
+    if(m_capture.IsOpen()) {
+      node->SetCapture(&m_capture);
+    }
+    node->SetReactor(&m_reactor);
+
+    // Inbound nodes arrive connected, so they're never announced through OnNodeConnected().
+    bool connected  = node->IsConnected();
+    auto address    = node->GetAddress();
+    auto handle     = m_nodes.Insert(std::move(node));
+    if(connected) {
+      m_hosts.emplace(address.sin_addr.s_addr, handle);
+    }
+    return handle;
+  }
+
+  bool Cluster::EnableMulticast(uint16_t port) {
+    if(!m_multicast.Open(port, m_reactor)) {
+      return false;
+    }
+    m_multicast.SetNodeId(m_identity.GetId());
+    m_multicastPort = port;
+    return true;
+  }
+
+  bool Cluster::JoinMulticastGroup(const std::string& group) {
+    auto address = Socket::GetAddressForHostname(group, m_multicastPort);
+    if(!address.DidSucceed() || !m_multicast.JoinGroup(address.GetValue())) {
+      return false;
+    }
+
+    // Let connected peers know that they can expect requests from us over multicast.
+    if(!m_identity.HasFeature(NodeFeature::MULTICAST)) {
+      m_identity.SetFeature(NodeFeature::MULTICAST, true);
       for(auto &node : m_nodes) {
-        node.Send(buffer);
+        if(node.IsConnected()) {
+          node.SendHello();
+        }
       }
     }
+    return true;
   }
 
-  void Cluster::RespondToInputChangeRequest(const Node& sender, const std::map<Display, bool>& changes) {
-    ChangeInputResponse response(changes);
-    NetworkBuffer buffer;
-    if(response.Serialize(buffer)) {
+  bool Cluster::EnableDiscovery(uint16_t port, const std::vector<Display::SerialNumber>& displays, std::chrono::milliseconds interval) {
+    if(!m_discovery.Open(port, m_reactor)) {
+      return false;
+    }
+
+    m_advertisedDisplays  = displays;
+    m_beaconInterval      = interval;
+    m_nextBeacon          = Clock::now();
+    AnnounceIfDue();
+    return true;
+  }
+
+  void Cluster::AnnounceIfDue() {
+    auto now = Clock::now();
+    if(!m_discovery.IsOpen() || now < m_nextBeacon) {
+      return;
+    }
+
+    m_discovery.Announce(Beacon(m_identity.GetId(), m_listenPort, m_advertisedDisplays));
+    m_nextBeacon = now + m_beaconInterval;
+  }
+
+  void Cluster::SetMulticastAckTimeout(std::chrono::milliseconds timeout) {
+    m_multicastAckTimeout = timeout;
+  }
+
+  void Cluster::SetRequestTimeout(std::chrono::milliseconds timeout) {
+    m_requestTimeout = timeout;
+  }
+
+  void Cluster::SetCoalesceWindow(std::chrono::milliseconds window) {
+    m_coalesceWindow = window;
+  }
+
+  void Cluster::SetDisplays(const std::vector<Display::SerialNumber>& displays) {
+    std::vector<Display::SerialNumber> sorted(displays);
+    std::sort(sorted.begin(), sorted.end());
+    sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+
+    m_advertisedDisplays = sorted;
+
+    // The first time, peers learn from a fresh hello that we announce our displays and then hear all of
+    // them. After that they only hear what changed.
+    if(!m_identity.HasFeature(NodeFeature::DISPLAY_DIRECTORY)) {
+      m_identity.SetFeature(NodeFeature::DISPLAY_DIRECTORY, true);
+      m_displays = sorted;
+
       for(auto &node : m_nodes) {
+        if(node.IsConnected()) {
+          node.SendHello();
+        }
+        if(node.IsIdentified()) {
+          AnnounceDisplays(node);
+        }
+      }
+      return;
+    }
+
+    std::vector<Display::SerialNumber> added, removed;
+    std::set_difference(sorted.begin(), sorted.end(), m_displays.begin(), m_displays.end(), std::back_inserter(added));
+    std::set_difference(m_displays.begin(), m_displays.end(), sorted.begin(), sorted.end(), std::back_inserter(removed));
+    m_displays = sorted;
+
+    if(added.empty() && removed.empty()) {
+      return;
+    }
+
+    DisplayAnnouncement announcement(false, added, removed);
+    NetworkBuffer buffer;
+    if(!announcement.Serialize(buffer)) {
+      return;
+    }
+
+    for(auto &node : m_nodes) {
+      if(node.IsIdentified()) {
         node.Send(buffer);
       }
     }
   }
 
+  void Cluster::SetLeaseDuration(std::chrono::milliseconds duration) {
+    m_leases.SetTerm(duration);
+  }
+
+  void Cluster::AnnounceDisplays(Node& node) {
+    DisplayAnnouncement announcement(true, m_displays);
+    NetworkBuffer buffer;
+    if(announcement.Serialize(buffer)) {
+      node.Send(buffer);
+    }
+  }
+
+  std::vector<Cluster::NodeHandle> Cluster::GetDisplayOwners(Display::SerialNumber serial) const {
+    auto owners = m_displayOwners.find(serial);
+    return owners == m_displayOwners.end() ? std::vector<NodeHandle>() : owners->second;
+  }
+
+  ChangeInputRequest::RequestId Cluster::RequestInputChange(const std::map<Display, Display::Input>& changes) {
+    if(m_coalescing) {
+      for(auto &change : changes) {
+        m_coalescing->changes[change.first] = change.second;
+      }
+      return m_coalescing->id;
+    }
+
+    auto id = m_nextRequestId++;
+    if(m_coalesceWindow.count() <= 0) {
+      SendInputChangeRequest(id, changes);
+    } else {
+      m_coalescing = CoalescedRequest{id, changes, Clock::now() + m_coalesceWindow};
+    }
+    return id;
+  }
+
+  void Cluster::FlushCoalescedRequest() {
+    if(m_coalescing && m_coalescing->deadline <= Clock::now()) {
+      auto request = std::move(m_coalescing.value());
+      m_coalescing.reset();
+      SendInputChangeRequest(request.id, request.changes);
+    }
+  }
+
+  ChangeInputRequest::FenceMap Cluster::GetFences(const Display::InputMap& changes, std::optional<NodeId> owner) const {
+    auto now = Clock::now();
+
+    ChangeInputRequest::FenceMap fences;
+    for(auto &change : changes) {
+      auto serial = change.first.GetSerialNumber();
+      std::optional<FencingToken> token;
+      bool agreed = true;
+
+      for(auto it = m_heldLeases.lower_bound(std::make_pair(serial, NodeId(0))); it != m_heldLeases.end() && it->first.first == serial; ++it) {
+        if(it->second.expiry > now && (!owner || it->first.second == owner.value())) {
+          agreed  = agreed && (!token || token.value() == it->second.token);
+          token   = it->second.token;
+        }
+      }
+
+      // A message heard by the owners of several displays with the same serial number can only quote
+      // one token, so it quotes none unless they agree. Owners still recognise us as the holder.
+      if(token && agreed) {
+        fences[serial] = token.value();
+      }
+    }
+    return fences;
+  }
+
+  void Cluster::SendInputChangeRequest(ChangeInputRequest::RequestId id, const Display::InputMap& changes) {
+    auto now = Clock::now();
+
+    ChangeInputRequest request(id, changes);
+    request.SetFences(GetFences(changes, std::nullopt));
+    NetworkBuffer buffer;
+    if(!request.Serialize(buffer)) {
+      m_pendingRequests[id] = PendingRequest{now, now, {}, false};
+      return;
+    }
+
+    // Nodes that have announced their displays are only sent the changes for those, and aren't sent
+    // the request at all if they have none of the displays. Other nodes are sent every change, and
+    // only peers that have said they listen on the multicast channel are sent it over multicast.
+    std::vector<NodeHandle> awaiting, direct;
+    std::map<NodeHandle, Display::InputMap> targeted;
+    for(auto it = m_nodes.begin(); it != m_nodes.end(); ++it) {
+      auto owned = m_nodeDisplays.find(it.GetHandle());
+      if(it->IsConnected() && owned != m_nodeDisplays.end()) {
+        Display::InputMap subset;
+        for(auto &change : changes) {
+          if(owned->second.count(change.first.GetSerialNumber()) > 0) {
+            subset.insert(change);
+          }
+        }
+        if(!subset.empty()) {
+          targeted.emplace(it.GetHandle(), std::move(subset));
+        }
+      } else if(it->IsIdentified() && it->GetPeerIdentity()->HasFeature(NodeFeature::MULTICAST)) {
+        awaiting.push_back(it.GetHandle());
+      } else if(it->IsConnected()) {
+        direct.push_back(it.GetHandle());
+      }
+    }
+
+    auto sequence = awaiting.empty() ? std::nullopt : m_multicast.Send(buffer);
+    if(sequence) {
+      // Targeted nodes that listen on the multicast channel hear the whole request anyway, and ignore
+      // the changes for displays that aren't theirs, so they aren't sent it again.
+      for(auto it = targeted.begin(); it != targeted.end();) {
+        auto node = m_nodes.Get(it->first);
+        if(node->IsIdentified() && node->GetPeerIdentity()->HasFeature(NodeFeature::MULTICAST)) {
+          awaiting.push_back(it->first);
+          it = targeted.erase(it);
+        } else {
+          ++it;
+        }
+      }
+      m_pendingMulticasts[sequence.value()] = PendingMulticast{buffer, Clock::now() + m_multicastAckTimeout, awaiting};
+    } else {
+      direct.insert(direct.end(), awaiting.begin(), awaiting.end());
+      awaiting.clear();
+    }
+
+    // Record the request before sending, so that a send failure can remove the node from it.
+    std::vector<NodeHandle> responders(awaiting.begin(), awaiting.end());
+    responders.insert(responders.end(), direct.begin(), direct.end());
+    for(auto &target : targeted) {
+      responders.push_back(target.first);
+    }
+    m_pendingRequests[id] = PendingRequest{now, now + m_requestTimeout, responders, true};
+
+    for(auto handle : direct) {
+      if(auto node = m_nodes.Get(handle)) {
+        node->Send(buffer);
+      }
+    }
+
+    for(auto &target : targeted) {
+      auto node = m_nodes.Get(target.first);
+      if(node == nullptr) {
+        continue;
+      }
+
+      ChangeInputRequest subset(id, target.second);
+      subset.SetFences(GetFences(target.second, node->GetPeerIdentity() ? std::optional<NodeId>(node->GetPeerIdentity()->GetId()) : std::nullopt));
+
+      NetworkBuffer subsetBuffer;
+      if(subset.Serialize(subsetBuffer)) {
+        node->Send(subsetBuffer);
+      }
+    }
+  }
+
+  void Cluster::RespondToInputChangeRequest(const Node& sender, ChangeInputRequest::RequestId id, const std::map<Display, bool>& changes, std::chrono::microseconds elapsed) {
+    auto handle = m_nodes.Find(sender);
+    if(handle) {
+      RespondToInputChangeRequest(handle.value(), id, changes, elapsed);
+    }
+  }
+
+  void Cluster::RespondToInputChangeRequest(NodeHandle sender, ChangeInputRequest::RequestId id, const std::map<Display, bool>& changes, std::chrono::microseconds elapsed) {
+    // The node may have gone while the changes were being applied.
+    auto node = m_nodes.Get(sender);
+    if(node == nullptr) {
+      return;
+    }
+
+    // Changes to displays whose leases the node couldn't have were never passed on, and so failed.
+    auto results = changes;
+    ChangeInputResponse::LeaseMap leases;
+    auto decisions = m_leaseDecisions.find(sender);
+    if(decisions != m_leaseDecisions.end()) {
+      auto decision = decisions->second.find(id);
+      if(decision != decisions->second.end()) {
+        leases = std::move(decision->second);
+        decisions->second.erase(decision);
+      }
+      if(decisions->second.empty()) {
+        m_leaseDecisions.erase(decisions);
+      }
+    }
+
+    for(auto &lease : leases) {
+      if(lease.second.decision != LeaseDecision::GRANTED) {
+        results[Display(lease.first)] = false;
+      }
+    }
+
+    ChangeInputResponse response(id, results, elapsed);
+    response.SetLeases(leases);
+    NetworkBuffer buffer;
+    if(response.Serialize(buffer)) {
+      node->Send(buffer);
+    }
+  }
+
+  std::optional<Cluster::NodeHandle> Cluster::GetNodeHandle(const Node& node) const {
+    return m_nodes.Find(node);
+  }
+
+  std::vector<LinkStatistics> Cluster::GetLinkStatistics() const {
+    std::vector<LinkStatistics> statistics;
+    for(auto &node : m_nodes) {
+      statistics.push_back(node.GetStatistics());
+    }
+    return statistics;
+  }
+
   void Cluster::AddListener(Cluster::Listener* listener) {
     m_listeners.erase(std::remove(m_listeners.begin(), m_listeners.end(), listener), m_listeners.end());
     m_listeners.push_back(listener);
@@ -48,44 +406,521 @@ namespace kvm {
     m_listeners.erase(std::remove(m_listeners.begin(), m_listeners.end(), listener), m_listeners.end());
   }
 
-  void Cluster::Pump() {
-    auto socket = m_socket.Accept();
-
-    if(socket) {
-      Node node(socket.value());
-      node.AddListener(this);
-      m_nodes.push_back(Node(socket.value()));
+  void Cluster::Pump(std::chrono::milliseconds timeout) {
+    // Wake up often enough to send heartbeats and notice failed nodes on time.
+    timeout = std::min(timeout, m_failureDetection.heartbeatInterval / 2);
 
-      for(auto listener : m_listeners) {
-        listener->OnNodeConnected(node);
+    // Wake up in time to retry multicasts that go unacknowledged.
+    if(!m_pendingMulticasts.empty()) {
+      auto deadline = m_pendingMulticasts.begin()->second.deadline;
+      for(auto &pending : m_pendingMulticasts) {
+        deadline = std::min(deadline, pending.second.deadline);
       }
+      auto untilDeadline = std::chrono::ceil<std::chrono::milliseconds>(deadline - Clock::now());
+      timeout = std::max(std::chrono::milliseconds(0), std::min(timeout, untilDeadline));
     }
 
+    // Wake up in time to send coalesced requests.
+    if(m_coalescing) {
+      auto untilDeadline = std::chrono::ceil<std::chrono::milliseconds>(m_coalescing->deadline - Clock::now());
+      timeout = std::max(std::chrono::milliseconds(0), std::min(timeout, untilDeadline));
+    }
+
+    // Wake up in time to send the next beacon.
+    if(m_discovery.IsOpen()) {
+      auto untilDeadline = std::chrono::ceil<std::chrono::milliseconds>(m_nextBeacon - Clock::now());
+      timeout = std::max(std::chrono::milliseconds(0), std::min(timeout, untilDeadline));
+    }
+
+    // Wake up in time to report requests that go unanswered.
+    for(auto &pending : m_pendingRequests) {
+      auto untilDeadline = std::chrono::ceil<std::chrono::milliseconds>(pending.second.deadline - Clock::now());
+      timeout = std::max(std::chrono::milliseconds(0), std::min(timeout, untilDeadline));
+    }
+
+    m_reactor.Poll(timeout);
+    FlushCoalescedRequest();
+    RetryUnacknowledgedMulticasts();
+    AnnounceIfDue();
+
     for(auto &node : m_nodes) {
       node.Pump();
     }
+
+    RemoveClosedNodes();
+    CompleteRequests();
+
+    // One write per pump keeps capturing cheap, and a killed process loses no more than this pump's records.
+    m_capture.Flush();
+  }
+
+  void Cluster::Wake() {
+    m_waker.Wake();
+  }
+
+  void Cluster::OnReadable() {
+    // Take every waiting connection, as a readiness report may cover more than one. Listeners hear about
+    // each node once it has identified itself and survived duplicate detection.
+    while(auto socket = m_socket.Accept()) {
+      m_nodes.Get(AttachNode(std::make_unique<Node>(socket.value())))->SendHello();
+    }
   }
 
   void Cluster::OnNodeConnected(const Node& node) {
-    for(auto listener : m_listeners) {
-      listener->OnNodeConnected(node);
+    auto handle = m_nodes.Find(node);
+    if(handle) {
+      m_hosts.emplace(node.GetAddress().sin_addr.s_addr, handle.value());
+    }
+  }
+
+  void Cluster::OnNodeIdentified(Node& node) {
+    auto peer   = node.GetPeerIdentity()->GetId();
+    auto handle = m_nodes.Find(node);
+    if(!handle) {
+      return;
+    }
+
+    // We've connected to ourselves, most likely through a node list that includes this machine. The
+    // node is removed on the next pump.
+    if(peer == m_identity.GetId()) {
+      node.Disconnect();
+      node.SetDormant(true);
+      return;
+    }
+
+    auto existing = m_peers.find(peer);
+    Node* other   = existing == m_peers.end() ? nullptr : m_nodes.Get(existing->second);
+    bool reindex  = existing == m_peers.end() || existing->second != handle.value();
+    if(other != nullptr && other != &node && other->IsIdentified()) {
+      // Both ends keep the connection initiated by whichever node has the lower ID, so they agree on
+      // which duplicate to close without further messages. Otherwise the newer connection wins.
+      bool keepOutbound = m_identity.GetId() < peer;
+      Node* survivor    = &node;
+      if(node.IsInbound() != other->IsInbound() && node.IsInbound() == keepOutbound) {
+        survivor = other;
+      }
+      Node* loser = survivor == &node ? other : &node;
+
+      loser->Disconnect();
+      loser->SetDormant(!loser->IsInbound());
+
+      if(survivor != &node) {
+        return;
+      }
+    }
+
+    m_peers[peer] = handle.value();
+
+    // A new connection may come from a peer that restarted, and is numbering its requests from the
+    // beginning again. Hellos repeated on the same connection don't restart the numbering.
+    if(reindex) {
+      m_leases.ResetRequestOrder(peer);
+    }
+
+    if(m_identity.HasFeature(NodeFeature::DISPLAY_DIRECTORY)) {
+      AnnounceDisplays(node);
+    }
+
+    if(m_announced.insert(handle.value()).second) {
+      for(auto listener : m_listeners) {
+        listener->OnNodeConnected(node);
+      }
     }
   }
 
   void Cluster::OnNodeDisconnected(const Node& node) {
-    for(auto listener : m_listeners) {
-      listener->OnNodeDisconnected(node);
+    auto handle = m_nodes.Find(node);
+    if(!handle) {
+      return;
+    }
+
+    ForgetNode(handle.value());
+    Unindex(handle.value(), node);
+
+    if(m_announced.erase(handle.value()) > 0) {
+      for(auto listener : m_listeners) {
+        listener->OnNodeDisconnected(node);
+      }
+    }
+
+    auto& identity = node.GetPeerIdentity();
+    if(!identity || identity->GetId() == m_identity.GetId()) {
+      return;
+    }
+
+    // If that was our last connection to the peer, resume connecting to it on links parked in its favour.
+    if(m_peers.count(identity->GetId()) > 0) {
+      return;
+    }
+
+    for(auto &other : m_nodes) {
+      if(other.IsDormant() && other.GetPeerIdentity() && other.GetPeerIdentity()->GetId() == identity->GetId()) {
+        other.SetDormant(false);
+      }
+    }
+  }
+
+  void Cluster::Unindex(NodeHandle handle, const Node& node) {
+    UnindexDisplays(handle);
+    m_leaseDecisions.erase(handle);
+    m_receivedRequests.erase(handle);
+
+    auto& identity = node.GetPeerIdentity();
+    if(identity) {
+      auto peer = m_peers.find(identity->GetId());
+      if(peer != m_peers.end() && peer->second == handle) {
+        m_peers.erase(peer);
+      }
+    }
+
+    auto ip   = node.GetAddress().sin_addr.s_addr;
+    auto host = m_hosts.find(ip);
+    if(host == m_hosts.end() || host->second != handle) {
+      return;
+    }
+    m_hosts.erase(host);
+
+    // Another connection from the same machine can take over attributing its multicasts.
+    for(auto it = m_nodes.begin(); it != m_nodes.end(); ++it) {
+      if(it.GetHandle() != handle && it->IsConnected() && it->GetAddress().sin_addr.s_addr == ip) {
+        m_hosts.emplace(ip, it.GetHandle());
+        return;
+      }
     }
   }
 
+  void Cluster::UnindexDisplays(NodeHandle handle) {
+    auto displays = m_nodeDisplays.find(handle);
+    if(displays == m_nodeDisplays.end()) {
+      return;
+    }
+
+    for(auto serial : displays->second) {
+      RemoveDisplayOwner(serial, handle);
+    }
+    m_nodeDisplays.erase(displays);
+  }
+
+  void Cluster::RemoveDisplayOwner(Display::SerialNumber serial, NodeHandle handle) {
+    auto owners = m_displayOwners.find(serial);
+    if(owners == m_displayOwners.end()) {
+      return;
+    }
+
+    owners->second.erase(std::remove(owners->second.begin(), owners->second.end(), handle), owners->second.end());
+    if(owners->second.empty()) {
+      m_displayOwners.erase(owners);
+    }
+  }
+
+  /// Messages that nodes pass on to the cluster
+  typedef MessageDispatcher<Cluster, NetworkMessageType::CHANGE_INPUT_REQUEST, NetworkMessageType::CHANGE_INPUT_RESPONSE, NetworkMessageType::DISPLAY_ANNOUNCEMENT> ClusterDispatcher;
+
   void Cluster::OnMessageReceived(Node& sender, NetworkBuffer& buffer) {
-    if(NetworkMessage::IsContainedIn(static_cast<NetworkMessage::Type>(NetworkMessageType::CHANGE_INPUT_REQUEST), buffer)) {
-      ChangeInputRequest request;
-      if(request.Deserialize(buffer)) {
-        for(auto listener : m_listeners) {
-          listener->OnInputChangeRequested(sender, request.GetInputMap());
+    ClusterDispatcher::Dispatch(buffer, *this, sender);
+  }
+
+  void Cluster::OnMessageSuperseded(Node& node, NetworkBuffer& buffer) {
+    ChangeInputRequest request;
+    if(!request.Deserialize(buffer)) {
+      return;
+    }
+
+    // The request that replaced it carries its changes, so this isn't a failure. The request completes
+    // on the next pump if the node was the last one it was waiting on.
+    auto handle   = m_nodes.Find(node);
+    auto pending  = m_pendingRequests.find(request.GetId());
+    if(handle && pending != m_pendingRequests.end()) {
+      auto& awaiting = pending->second.awaiting;
+      awaiting.erase(std::remove(awaiting.begin(), awaiting.end(), handle.value()), awaiting.end());
+    }
+  }
+
+  void Cluster::OnMessage(const ChangeInputRequest& request, Node& sender) {
+    // A copy of a request we've already taken, such as one retried over TCP because the acknowledgement
+    // of its multicast came late, is answered along with the original.
+    auto handle = m_nodes.Find(sender);
+    if(handle) {
+      auto& received = m_receivedRequests[handle.value()];
+      if(!received.insert(request.GetId()).second) {
+        return;
+      }
+      // Request IDs only grow, so the oldest are the ones no sender will retry.
+      if(received.size() > ReceivedRequestHistory) {
+        received.erase(received.begin());
+      }
+    }
+
+    if(!m_identity.HasFeature(NodeFeature::DISPLAY_DIRECTORY)) {
+      for(auto listener : m_listeners) {
+        listener->OnInputChangeRequested(sender, request.GetId(), request.GetInputMap());
+      }
+      return;
+    }
+
+    // Senders that don't know our displays, or multicast to everyone, may ask for displays we don't have.
+    Display::InputMap changes;
+    for(auto &change : request.GetInputMap()) {
+      if(std::binary_search(m_displays.begin(), m_displays.end(), change.first.GetSerialNumber())) {
+        changes.insert(change);
+      }
+    }
+
+    auto& peer = sender.GetPeerIdentity();
+    if(m_leases.GetTerm().count() > 0 && handle && peer && !changes.empty()) {
+      // Changes are only passed on for the displays whose leases the node is granted.
+      auto now      = Clock::now();
+      auto fences   = request.GetFences();
+      auto& leases  = m_leaseDecisions[handle.value()][request.GetId()];
+      for(auto it = changes.begin(); it != changes.end();) {
+        auto serial = it->first.GetSerialNumber();
+        auto fence  = fences.find(serial);
+        auto lease  = m_leases.Acquire(serial, peer->GetId(), request.GetId(), fence == fences.end() ? 0 : fence->second, now);
+        leases[serial] = lease;
+        it = lease.decision == LeaseDecision::GRANTED ? std::next(it) : changes.erase(it);
+      }
+    }
+
+    if(changes.empty()) {
+      RespondToInputChangeRequest(sender, request.GetId(), {}, std::chrono::microseconds(0));
+      return;
+    }
+
+    for(auto listener : m_listeners) {
+      listener->OnInputChangeRequested(sender, request.GetId(), changes);
+    }
+  }
+
+  void Cluster::OnMessage(const ChangeInputResponse& response, Node& sender) {
+    auto handle   = m_nodes.Find(sender);
+    auto pending  = m_pendingRequests.find(response.GetRequestId());
+    if(!handle || pending == m_pendingRequests.end()) {
+      return;
+    }
+
+    // A node may answer twice if it heard a request over multicast and again over TCP.
+    auto& awaiting  = pending->second.awaiting;
+    auto it         = std::find(awaiting.begin(), awaiting.end(), handle.value());
+    if(it == awaiting.end()) {
+      return;
+    }
+    awaiting.erase(it);
+
+    // Quote the tokens of the leases we were granted in later requests, and stop quoting those we lost.
+    // Leases are timed from when we sent the request, so we never believe we hold one the owner has let go.
+    auto& peer = sender.GetPeerIdentity();
+    if(peer) {
+      for(auto &lease : response.GetLeases()) {
+        auto key = std::make_pair(lease.first, peer->GetId());
+        if(lease.second.decision == LeaseDecision::GRANTED && lease.second.holder == m_identity.GetId()) {
+          m_heldLeases[key] = HeldLease{lease.second.token, pending->second.sent + lease.second.term};
+        } else {
+          m_heldLeases.erase(key);
         }
       }
     }
+
+    for(auto &result : response.GetResultMap()) {
+      pending->second.succeeded = pending->second.succeeded && result.second;
+    }
+
+    for(auto listener : m_listeners) {
+      listener->OnInputChangeResponse(sender, response.GetRequestId(), response.GetResultMap(), response.GetElapsed());
+    }
+
+    // Report completion as soon as the last node answers rather than waiting for the next pump.
+    if(awaiting.empty()) {
+      CompleteRequests();
+    }
+  }
+
+  void Cluster::OnMessage(const DisplayAnnouncement& announcement, Node& sender) {
+    auto handle = m_nodes.Find(sender);
+    if(!handle) {
+      return;
+    }
+
+    // Changes only make sense on top of a complete announcement on the same connection.
+    auto displays = m_nodeDisplays.find(handle.value());
+    if(announcement.IsComplete()) {
+      UnindexDisplays(handle.value());
+      displays = m_nodeDisplays.emplace(handle.value(), std::set<Display::SerialNumber>()).first;
+    } else if(displays == m_nodeDisplays.end()) {
+      return;
+    }
+
+    for(auto serial : announcement.GetRemoved()) {
+      if(displays->second.erase(serial) > 0) {
+        RemoveDisplayOwner(serial, handle.value());
+      }
+    }
+
+    for(auto serial : announcement.GetAdded()) {
+      if(displays->second.insert(serial).second) {
+        m_displayOwners[serial].push_back(handle.value());
+      }
+    }
+  }
+
+  bool Cluster::OnMulticastReceived(const SocketAddress& sender, NetworkBuffer& buffer) {
+    // Only accept multicasts from nodes we hold a connection to; anything else would be retried over
+    // TCP anyway if it mattered.
+    auto node = FindConnectedNode(sender);
+    if(node == nullptr) {
+      return false;
+    }
+
+    OnMessageReceived(*node, buffer);
+    return true;
+  }
+
+  void Cluster::OnMulticastAcknowledged(const SocketAddress& sender, NodeId id, MulticastChannel::Sequence sequence) {
+    auto pending = m_pendingMulticasts.find(sequence);
+    if(pending == m_pendingMulticasts.end()) {
+      return;
+    }
+
+    // Match on identity rather than address, since several nodes may run on the same host.
+    auto& awaiting = pending->second.awaiting;
+    awaiting.erase(std::remove_if(awaiting.begin(), awaiting.end(), [this, id](NodeHandle handle) {
+      auto node = m_nodes.Get(handle);
+      return node == nullptr || (node->GetPeerIdentity() && node->GetPeerIdentity()->GetId() == id);
+    }), awaiting.end());
+
+    if(awaiting.empty()) {
+      m_pendingMulticasts.erase(pending);
+    }
+  }
+
+  void Cluster::OnBeaconReceived(const SocketAddress& sender, const Beacon& beacon) {
+    auto id = beacon.GetNodeId();
+    if(id == m_identity.GetId()) {
+      return;
+    }
+
+    SocketAddress address = sender;
+    address.sin_port      = HostToNetwork(beacon.GetPort());
+
+    for(auto listener : m_listeners) {
+      listener->OnNodeDiscovered(id, address, beacon.GetDisplays());
+    }
+
+    // The peer connects to us instead, and duplicate detection would close our connection if we did.
+    if(m_identity.GetId() > id) {
+      return;
+    }
+
+    if(m_peers.count(id) > 0) {
+      return;
+    }
+
+    // Also skip peers that we're still connecting or reconnecting to.
+    for(auto &node : m_nodes) {
+      auto& peer = node.GetPeerIdentity();
+      if(peer && peer->GetId() == id) {
+        return;
+      }
+
+      auto known = node.GetAddress();
+      if(!node.IsInbound() && known.sin_addr.s_addr == address.sin_addr.s_addr && known.sin_port == address.sin_port) {
+        return;
+      }
+    }
+
+    m_discovered.insert(AttachNode(std::make_unique<Node>(AddressToString(address), beacon.GetPort())));
+  }
+
+  void Cluster::RemoveClosedNodes() {
+    for(auto it = m_nodes.begin(); it != m_nodes.end(); ++it) {
+      auto& node    = *it;
+      auto  handle  = it.GetHandle();
+      if(node.IsConnected() || node.IsConnecting()) {
+        continue;
+      }
+
+      // Discovered nodes are found again by their next beacon if they come back.
+      auto& peer = node.GetPeerIdentity();
+      bool self  = peer && peer->GetId() == m_identity.GetId();
+      if(!node.IsInbound() && !self && m_discovered.count(handle) == 0) {
+        continue;
+      }
+
+      ForgetNode(handle);
+      Unindex(handle, node);
+      m_announced.erase(handle);
+      m_discovered.erase(handle);
+      m_nodes.Erase(handle);
+    }
+  }
+
+  Node* Cluster::FindConnectedNode(const SocketAddress& address) {
+    auto host = m_hosts.find(address.sin_addr.s_addr);
+    if(host == m_hosts.end()) {
+      return nullptr;
+    }
+
+    auto node = m_nodes.Get(host->second);
+    return node != nullptr && node->IsConnected() ? node : nullptr;
+  }
+
+  void Cluster::RetryUnacknowledgedMulticasts() {
+    auto now = Clock::now();
+
+    // Take the overdue multicasts out before sending, since a failed send disconnects the node and
+    // ForgetNode() then edits the pending multicasts.
+    std::vector<PendingMulticast> overdue;
+    for(auto it = m_pendingMulticasts.begin(); it != m_pendingMulticasts.end();) {
+      if(it->second.deadline <= now) {
+        overdue.push_back(std::move(it->second));
+        it = m_pendingMulticasts.erase(it);
+      } else {
+        ++it;
+      }
+    }
+
+    for(auto &pending : overdue) {
+      for(auto handle : pending.awaiting) {
+        if(auto node = m_nodes.Get(handle)) {
+          node->Send(pending.message);
+        }
+      }
+    }
+  }
+
+  void Cluster::ForgetNode(NodeHandle node) {
+    for(auto &pending : m_pendingMulticasts) {
+      auto& awaiting = pending.second.awaiting;
+      awaiting.erase(std::remove(awaiting.begin(), awaiting.end(), node), awaiting.end());
+    }
+
+    for(auto &pending : m_pendingRequests) {
+      auto& awaiting = pending.second.awaiting;
+      auto it = std::remove(awaiting.begin(), awaiting.end(), node);
+      if(it != awaiting.end()) {
+        awaiting.erase(it, awaiting.end());
+        pending.second.succeeded = false;
+      }
+    }
+  }
+
+  void Cluster::CompleteRequests() {
+    auto now = Clock::now();
+
+    for(auto it = m_pendingRequests.begin(); it != m_pendingRequests.end();) {
+      auto& pending = it->second;
+      if(!pending.awaiting.empty() && pending.deadline > now) {
+        ++it;
+        continue;
+      }
+
+      auto id         = it->first;
+      bool succeeded  = pending.awaiting.empty() && pending.succeeded;
+      auto latency    = std::chrono::duration_cast<std::chrono::microseconds>(now - pending.sent);
+      it = m_pendingRequests.erase(it);
+
+      for(auto listener : m_listeners) {
+        listener->OnInputChangeCompleted(id, succeeded, latency);
+      }
+    }
   }
 }
\ No newline at end of file
@@ -0,0 +1,191 @@
+#include <networking/cluster_thread.h>
+
+#define MAX_PUMP_WAIT_MS 1000
+
+namespace kvm {
+  ClusterThread::ClusterThread(Cluster& cluster) :
+  m_cluster(cluster),
+  m_running(false)
+  {}
+
+  void ClusterThread::Start() {
+    if(m_running.exchange(true)) {
+      return;
+    }
+
+    m_cluster.AddListener(this);
+    m_thread = std::thread(&ClusterThread::Run, this);
+  }
+
+  void ClusterThread::Stop() {
+    if(!m_running.exchange(false)) {
+      return;
+    }
+
+    m_cluster.Wake();
+    m_thread.join();
+    m_cluster.RemoveListener(this);
+  }
+
+  bool ClusterThread::IsRunning() const {
+    return m_running.load();
+  }
+
+  void ClusterThread::RequestInputChange(const Display::InputMap& changes) {
+    Command command{};
+    command.type    = Command::Type::REQUEST_INPUT_CHANGE;
+    command.changes = changes;
+    Post(std::move(command));
+  }
+
+  void ClusterThread::RespondToInputChangeRequest(Cluster::NodeHandle sender, ChangeInputRequest::RequestId id, const std::map<Display, bool>& results, std::chrono::microseconds elapsed) {
+    Command command{};
+    command.type    = Command::Type::RESPOND_TO_INPUT_CHANGE;
+    command.node    = sender;
+    command.id      = id;
+    command.results = results;
+    command.elapsed = elapsed;
+    Post(std::move(command));
+  }
+
+  void ClusterThread::SetDisplays(const std::vector<Display::SerialNumber>& displays) {
+    Command command{};
+    command.type      = Command::Type::SET_DISPLAYS;
+    command.displays  = displays;
+    Post(std::move(command));
+  }
+
+  void ClusterThread::Post(Command&& command) {
+    // Commands wait in the backlog while the ring is full rather than being dropped, and the backlog
+    // keeps them in order.
+    m_commandBacklog.push_back(std::move(command));
+    FlushCommands();
+  }
+
+  void ClusterThread::FlushCommands() {
+    while(!m_commandBacklog.empty() && m_commands.TryPush(std::move(m_commandBacklog.front()))) {
+      m_commandBacklog.pop_front();
+    }
+    m_cluster.Wake();
+  }
+
+  bool ClusterThread::NextEvent(Event& event) {
+    return m_events.TryPop(event);
+  }
+
+  bool ClusterThread::WaitForEvents(std::chrono::milliseconds timeout) {
+    // Retry commands that were left over the last time the ring was full.
+    if(!m_commandBacklog.empty()) {
+      FlushCommands();
+    }
+
+    std::unique_lock<std::mutex> lock(m_eventMutex);
+    return m_eventArrived.wait_for(lock, timeout, [this]() { return !m_events.IsEmpty(); });
+  }
+
+  std::vector<LinkStatistics> ClusterThread::GetLinkStatistics() const {
+    std::lock_guard<std::mutex> lock(m_statisticsMutex);
+    return m_statistics;
+  }
+
+  void ClusterThread::Run() {
+    while(m_running.load()) {
+      Command command;
+      while(m_commands.TryPop(command)) {
+        switch(command.type) {
+          case Command::Type::REQUEST_INPUT_CHANGE: {
+            Event event{};
+            event.type  = Event::Type::INPUT_CHANGE_ACCEPTED;
+            event.id    = m_cluster.RequestInputChange(command.changes);
+            Publish(std::move(event));
+            break;
+          }
+
+          case Command::Type::RESPOND_TO_INPUT_CHANGE:
+            m_cluster.RespondToInputChangeRequest(command.node, command.id, command.results, command.elapsed);
+            break;
+
+          case Command::Type::SET_DISPLAYS:
+            m_cluster.SetDisplays(command.displays);
+            break;
+        }
+      }
+
+      m_cluster.Pump(std::chrono::milliseconds(MAX_PUMP_WAIT_MS));
+
+      // Events that didn't fit last time go first, so that the owning thread sees them in order.
+      bool published = false;
+      while(!m_eventBacklog.empty() && m_events.TryPush(std::move(m_eventBacklog.front()))) {
+        m_eventBacklog.pop_front();
+        published = true;
+      }
+      if(published) {
+        std::lock_guard<std::mutex> lock(m_eventMutex);
+        m_eventArrived.notify_one();
+      }
+
+      std::lock_guard<std::mutex> lock(m_statisticsMutex);
+      m_statistics = m_cluster.GetLinkStatistics();
+    }
+  }
+
+  void ClusterThread::Publish(Event&& event) {
+    if(!m_eventBacklog.empty() || !m_events.TryPush(std::move(event))) {
+      m_eventBacklog.push_back(std::move(event));
+      return;
+    }
+
+    // Taking the lock orders the push before a waiting thread's check of the ring, so it can't sleep
+    // through the notification.
+    std::lock_guard<std::mutex> lock(m_eventMutex);
+    m_eventArrived.notify_one();
+  }
+
+  ClusterThread::Event ClusterThread::MakeEvent(Event::Type type, const Node& node) const {
+    Event event{};
+    event.type    = type;
+    event.summary = node.GetSummary();
+
+    auto handle = m_cluster.GetNodeHandle(node);
+    if(handle) {
+      event.node = handle.value();
+    }
+    return event;
+  }
+
+  void ClusterThread::OnNodeConnected(const Node& node) {
+    Publish(MakeEvent(Event::Type::NODE_CONNECTED, node));
+  }
+
+  void ClusterThread::OnNodeDisconnected(const Node& node) {
+    Publish(MakeEvent(Event::Type::NODE_DISCONNECTED, node));
+  }
+
+  void ClusterThread::OnInputChangeRequested(const Node& sender, ChangeInputRequest::RequestId id, const Display::InputMap& changes) {
+    auto event    = MakeEvent(Event::Type::INPUT_CHANGE_REQUESTED, sender);
+    event.id      = id;
+    event.changes = changes;
+    Publish(std::move(event));
+  }
+
+  void ClusterThread::OnInputChangeResponse(const Node& sender, ChangeInputRequest::RequestId id, const std::map<Display, bool>& results, std::chrono::microseconds elapsed) {
+    auto event    = MakeEvent(Event::Type::INPUT_CHANGE_RESPONSE, sender);
+    event.id      = id;
+    event.results = results;
+    event.elapsed = elapsed;
+    Publish(std::move(event));
+  }
+
+  void ClusterThread::OnInputChangeCompleted(ChangeInputRequest::RequestId id, bool succeeded, std::chrono::microseconds latency) {
+    Event event{};
+    event.type      = Event::Type::INPUT_CHANGE_COMPLETED;
+    event.id        = id;
+    event.succeeded = succeeded;
+    event.elapsed   = latency;
+    Publish(std::move(event));
+  }
+
+  ClusterThread::~ClusterThread() {
+    Stop();
+  }
+}
\ No newline at end of file
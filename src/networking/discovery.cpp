@@ -0,0 +1,82 @@
+#include <networking/discovery.h>
+#include <networking/message/registry.h>
+
+namespace kvm {
+  Discovery::Discovery() :
+  m_reactor(nullptr),
+  m_port(0),
+  m_listener(nullptr)
+  {}
+
+  bool Discovery::Open(uint16_t port, Reactor& reactor) {
+    Close();
+
+    if(!m_socket.Open(port) || !m_socket.EnableBroadcast()) {
+      m_socket.Close();
+      return false;
+    }
+
+    if(!reactor.Register(m_socket.GetHandle(), this)) {
+      m_socket.Close();
+      return false;
+    }
+
+    m_reactor = &reactor;
+    m_port    = port;
+    return true;
+  }
+
+  bool Discovery::IsOpen() const {
+    return m_socket.IsOpen();
+  }
+
+  bool Discovery::Announce(const Beacon& beacon) {
+    NetworkBuffer buffer;
+    if(!beacon.Serialize(buffer)) {
+      return false;
+    }
+
+    SocketAddress broadcast = {};
+    broadcast.sin_family      = AF_INET;
+    broadcast.sin_addr.s_addr = HostToNetwork(static_cast<uint32_t>(INADDR_BROADCAST));
+    broadcast.sin_port        = HostToNetwork(m_port);
+
+    return m_socket.SendTo(broadcast, buffer);
+  }
+
+  void Discovery::SetListener(Discovery::Listener* listener) {
+    m_listener = listener;
+  }
+
+  void Discovery::Close() {
+    if(m_reactor != nullptr && m_socket.IsOpen()) {
+      m_reactor->Deregister(m_socket.GetHandle());
+    }
+    m_reactor = nullptr;
+    m_socket.Close();
+  }
+
+  /// Messages that arrive on the discovery port
+  typedef MessageDispatcher<Discovery, NetworkMessageType::BEACON> DiscoveryDispatcher;
+
+  void Discovery::OnReadable() {
+    SocketAddress sender;
+
+    while(m_socket.ReceiveFrom(m_receiveBuffer, sender)) {
+      if(m_listener != nullptr) {
+        DiscoveryDispatcher::Dispatch(m_receiveBuffer, *this, sender);
+      }
+    }
+  }
+
+  void Discovery::OnMessage(const Beacon& beacon, const SocketAddress& sender) {
+    // Nodes on other versions couldn't talk to us anyway.
+    if(beacon.GetProtocolVersion() == NetworkMessage::ProtocolVersion) {
+      m_listener->OnBeaconReceived(sender, beacon);
+    }
+  }
+
+  Discovery::~Discovery() {
+    Close();
+  }
+}
\ No newline at end of file
@@ -0,0 +1,84 @@
+#include <networking/failure_detector.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace kvm {
+  FailureDetector::Settings::Settings() :
+  heartbeatInterval(250),
+  threshold(8.0),
+  windowSize(200),
+  minStandardDeviation(100),
+  acceptablePause(0)
+  {}
+
+  FailureDetector::FailureDetector(const FailureDetector::Settings& settings) :
+  m_settings(settings),
+  m_sum(0),
+  m_sumOfSquares(0),
+  m_lastHeartbeat(Clock::now()) {
+    Reset(m_lastHeartbeat);
+  }
+
+  void FailureDetector::SetSettings(const FailureDetector::Settings& settings) {
+    m_settings = settings;
+  }
+
+  const FailureDetector::Settings& FailureDetector::GetSettings() const {
+    return m_settings;
+  }
+
+  void FailureDetector::Reset(FailureDetector::TimePoint now) {
+    m_intervals.clear();
+    m_sum           = 0;
+    m_sumOfSquares  = 0;
+    m_lastHeartbeat = now;
+
+    // Seed with two samples a quarter of the interval either side of it, so that a new connection starts
+    // out with a plausible mean and spread instead of suspecting the peer on its first late heartbeat.
+    double interval = static_cast<double>(m_settings.heartbeatInterval.count());
+    AddInterval(interval - interval / 4);
+    AddInterval(interval + interval / 4);
+  }
+
+  void FailureDetector::OnHeartbeat(FailureDetector::TimePoint now) {
+    AddInterval(std::chrono::duration<double, std::milli>(now - m_lastHeartbeat).count());
+    m_lastHeartbeat = now;
+  }
+
+  FailureDetector::TimePoint FailureDetector::GetLastHeartbeat() const {
+    return m_lastHeartbeat;
+  }
+
+  double FailureDetector::GetSuspicion(FailureDetector::TimePoint now) const {
+    double elapsed  = std::chrono::duration<double, std::milli>(now - m_lastHeartbeat).count();
+    double count    = static_cast<double>(m_intervals.size());
+    double mean     = m_sum / count + static_cast<double>(m_settings.acceptablePause.count());
+    double variance = std::max(0.0, m_sumOfSquares / count - (m_sum / count) * (m_sum / count));
+    double stdDev   = std::max(std::sqrt(variance), static_cast<double>(m_settings.minStandardDeviation.count()));
+
+    // Probability that a heartbeat arrives later than this under a normal distribution of intervals.
+    double later = 0.5 * std::erfc((elapsed - mean) / (stdDev * std::sqrt(2.0)));
+
+    if(later <= 0) {
+      return std::numeric_limits<double>::max();
+    }
+    return -std::log10(later);
+  }
+
+  bool FailureDetector::IsAvailable(FailureDetector::TimePoint now) const {
+    return GetSuspicion(now) < m_settings.threshold;
+  }
+
+  void FailureDetector::AddInterval(double interval) {
+    m_intervals.push_back(interval);
+    m_sum           += interval;
+    m_sumOfSquares  += interval * interval;
+
+    while(m_intervals.size() > std::max<size_t>(m_settings.windowSize, 2)) {
+      m_sum           -= m_intervals.front();
+      m_sumOfSquares  -= m_intervals.front() * m_intervals.front();
+      m_intervals.pop_front();
+    }
+  }
+}
\ No newline at end of file
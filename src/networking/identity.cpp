@@ -0,0 +1,65 @@
+#include <networking/identity.h>
+#include <fstream>
+#include <random>
+
+namespace kvm {
+  NodeIdentity::NodeIdentity() :
+  m_id(Generate()),
+  m_features(0)
+  {}
+
+  NodeIdentity::NodeIdentity(NodeId id, uint32_t features) :
+  m_id(id),
+  m_features(features)
+  {}
+
+  NodeId NodeIdentity::GetId() const {
+    return m_id;
+  }
+
+  void NodeIdentity::SetId(NodeId id) {
+    m_id = id;
+  }
+
+  uint32_t NodeIdentity::GetFeatures() const {
+    return m_features;
+  }
+
+  bool NodeIdentity::HasFeature(NodeFeature feature) const {
+    return (m_features & static_cast<uint32_t>(feature)) != 0;
+  }
+
+  void NodeIdentity::SetFeature(NodeFeature feature, bool supported) {
+    if(supported) {
+      m_features |= static_cast<uint32_t>(feature);
+    } else {
+      m_features &= ~static_cast<uint32_t>(feature);
+    }
+  }
+
+  NodeId NodeIdentity::Generate() {
+    std::random_device random;
+    NodeId id = 0;
+
+    // Zero is never handed out so that it can't be mistaken for an unset ID.
+    while(id == 0) {
+      id = (static_cast<NodeId>(random()) << 32) | random();
+    }
+    return id;
+  }
+
+  NodeId NodeIdentity::LoadOrCreate(const std::string& path) {
+    std::ifstream in(path);
+    NodeId id = 0;
+
+    if(in >> std::hex >> id && id != 0) {
+      return id;
+    }
+
+    id = Generate();
+
+    std::ofstream out(path, std::ios::trunc);
+    out << std::hex << id << std::endl;
+    return id;
+  }
+}
\ No newline at end of file
@@ -0,0 +1,50 @@
+#include <networking/lease.h>
+#include <algorithm>
+
+namespace kvm {
+  LeaseTable::LeaseTable(std::chrono::milliseconds term) :
+  m_term(term)
+  {}
+
+  void LeaseTable::SetTerm(std::chrono::milliseconds term) {
+    m_term = term;
+  }
+
+  std::chrono::milliseconds LeaseTable::GetTerm() const {
+    return m_term;
+  }
+
+  LeaseResult LeaseTable::Acquire(Display::SerialNumber display, NodeId requester, ChangeInputRequest::RequestId request, FencingToken fence, TimePoint now) {
+    auto& lease = m_leases.emplace(display, Lease{0, 0, now, 0}).first->second;
+
+    if(lease.holder != 0 && lease.holder != requester && now < lease.expiry) {
+      return LeaseResult{LeaseDecision::HELD, lease.token, lease.holder, m_term};
+    }
+
+    // A request that arrives after a later one from the same node, such as a copy retried over TCP after
+    // the multicast got through, would switch the display back.
+    if(lease.holder == requester && request <= lease.request) {
+      return LeaseResult{LeaseDecision::STALE, lease.token, lease.holder, m_term};
+    }
+
+    // The node was granted the lease before someone else since, and its request was delayed. Tokens
+    // above ours are from before we restarted, and are taken over.
+    if(fence != 0 && fence < lease.token && lease.holder != requester) {
+      return LeaseResult{LeaseDecision::STALE, lease.token, lease.holder, m_term};
+    }
+
+    lease.holder  = requester;
+    lease.token   = std::max(lease.token, fence) + 1;
+    lease.expiry  = now + m_term;
+    lease.request = request;
+    return LeaseResult{LeaseDecision::GRANTED, lease.token, lease.holder, m_term};
+  }
+
+  void LeaseTable::ResetRequestOrder(NodeId requester) {
+    for(auto &lease : m_leases) {
+      if(lease.second.holder == requester) {
+        lease.second.request = 0;
+      }
+    }
+  }
+}
\ No newline at end of file
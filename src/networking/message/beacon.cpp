@@ -0,0 +1,65 @@
+#include <networking/message/beacon.h>
+#include <networking/message/types.h>
+
+namespace kvm {
+    Beacon::Beacon() :
+    NetworkMessage(static_cast<NetworkMessage::Type>(NetworkMessageType::BEACON)),
+    m_protocolVersion(0),
+    m_id(0),
+    m_port(0)
+    {}
+
+    Beacon::Beacon(NodeId id, uint16_t port, const std::vector<Display::SerialNumber>& displays) :
+    NetworkMessage(static_cast<NetworkMessage::Type>(NetworkMessageType::BEACON)),
+    m_protocolVersion(NetworkMessage::ProtocolVersion),
+    m_id(id),
+    m_port(port),
+    m_displays(displays)
+    {}
+
+    uint32_t Beacon::GetProtocolVersion() const {
+        return m_protocolVersion;
+    }
+
+    NodeId Beacon::GetNodeId() const {
+        return m_id;
+    }
+
+    uint16_t Beacon::GetPort() const {
+        return m_port;
+    }
+
+    const std::vector<Display::SerialNumber>& Beacon::GetDisplays() const {
+        return m_displays;
+    }
+
+    bool Beacon::Deserialize(NetworkBuffer& buffer) {
+        if(NetworkMessage::Deserialize(buffer)) {
+            m_displays.clear();
+
+            uint32_t size;
+            buffer >> Varint(m_protocolVersion) >> m_id >> m_port >> Varint(size);
+
+            for(uint32_t i = 0; i < size && buffer; i++) {
+                Display::SerialNumber serial;
+                if(buffer >> Varint(serial)) {
+                    m_displays.push_back(serial);
+                }
+            }
+        }
+
+        return buffer;
+    }
+
+    bool Beacon::Serialize(NetworkBuffer& buffer) const {
+        if(NetworkMessage::Serialize(buffer)) {
+            buffer << Varint(m_protocolVersion) << m_id << m_port << Varint(m_displays.size());
+
+            for(auto serial : m_displays) {
+                buffer << Varint(serial);
+            }
+        }
+
+        return buffer;
+    }
+}
\ No newline at end of file
@@ -3,28 +3,45 @@
 #include <kvm.h>
 
 namespace kvm {
-    ChangeInputRequest::ChangeInputRequest(const Display::InputMap& map) :
+    ChangeInputRequest::ChangeInputRequest(ChangeInputRequest::RequestId id, const Display::InputMap& map) :
     NetworkMessage(static_cast<NetworkMessage::Type>(NetworkMessageType::CHANGE_INPUT_REQUEST)),
+    m_id(id),
     m_map(map)
     {}
 
     ChangeInputRequest::ChangeInputRequest() :
-    NetworkMessage(static_cast<NetworkMessage::Type>(NetworkMessageType::CHANGE_INPUT_REQUEST))
+    NetworkMessage(static_cast<NetworkMessage::Type>(NetworkMessageType::CHANGE_INPUT_REQUEST)),
+    m_id(0)
     {}
 
+    ChangeInputRequest::RequestId ChangeInputRequest::GetId() const {
+        return m_id;
+    }
+
     const Display::InputMap& ChangeInputRequest::GetInputMap() const {
         return m_map;
     }
 
+    void ChangeInputRequest::SetFences(const ChangeInputRequest::FenceMap& fences) {
+        m_fences = fences;
+    }
+
+    const ChangeInputRequest::FenceMap& ChangeInputRequest::GetFences() const {
+        return m_fences;
+    }
+
     bool ChangeInputRequest::Deserialize(NetworkBuffer& buffer) {
         if(NetworkMessage::Deserialize(buffer)) {
             m_map.clear();
+            m_fences.clear();
 
-            uint32_t    size;
-            Display     display;
-            uint8_t     input;
+            uint32_t                size;
+            Display                 display;
+            uint8_t                 input;
+            Display::SerialNumber   serial = 0;
+            FencingToken            token = 0;
 
-            buffer >> size;
+            buffer >> Varint(m_id) >> Varint(size);
 
             for(int i = 0; i < size && buffer; i++) {
                 buffer >> display >> input;
@@ -32,6 +49,17 @@ namespace kvm {
                     m_map[display] = static_cast<Display::Input>(input);
                 }
             }
+
+            // Fences trail the changes, and are left off by requesters that hold no leases.
+            if(buffer && buffer.GetRemaining() > 0) {
+                buffer >> Varint(size);
+                for(uint32_t i = 0; i < size && buffer; i++) {
+                    buffer >> Varint(serial) >> Varint(token);
+                    if(buffer) {
+                        m_fences[serial] = token;
+                    }
+                }
+            }
         }
 
         return buffer;
@@ -39,11 +67,18 @@ namespace kvm {
 
     bool ChangeInputRequest::Serialize(NetworkBuffer& buffer) const {
         if(NetworkMessage::Serialize(buffer)) {
-            buffer << static_cast<uint32_t>(m_map.size());
+            buffer << Varint(m_id) << Varint(m_map.size());
 
             for(auto it = m_map.begin(); it != m_map.end(); ++it) {
                 buffer << it->first << static_cast<uint8_t>(it->second);
             }
+
+            if(!m_fences.empty()) {
+                buffer << Varint(m_fences.size());
+                for(auto it = m_fences.begin(); it != m_fences.end(); ++it) {
+                    buffer << Varint(it->first) << Varint(it->second);
+                }
+            }
         }
 
         return buffer;
@@ -3,32 +3,71 @@
 #include <kvm.h>
 
 namespace kvm {
-    ChangeInputResponse::ChangeInputResponse(const ChangeInputResponse::ResultMap& result) :
+    ChangeInputResponse::ChangeInputResponse(ChangeInputRequest::RequestId id, const ChangeInputResponse::ResultMap& result, std::chrono::microseconds elapsed) :
     NetworkMessage(static_cast<NetworkMessage::Type>(NetworkMessageType::CHANGE_INPUT_RESPONSE)),
-    m_result(result)
+    m_requestId(id),
+    m_result(result),
+    m_elapsed(elapsed)
     {}
 
     ChangeInputResponse::ChangeInputResponse() :
-    NetworkMessage(static_cast<NetworkMessage::Type>(NetworkMessageType::CHANGE_INPUT_RESPONSE))
+    NetworkMessage(static_cast<NetworkMessage::Type>(NetworkMessageType::CHANGE_INPUT_RESPONSE)),
+    m_requestId(0),
+    m_elapsed(0)
     {}
 
+    ChangeInputRequest::RequestId ChangeInputResponse::GetRequestId() const {
+        return m_requestId;
+    }
+
     const ChangeInputResponse::ResultMap& ChangeInputResponse::GetResultMap() const {
         return m_result;
     }
 
+    std::chrono::microseconds ChangeInputResponse::GetElapsed() const {
+        return m_elapsed;
+    }
+
+    void ChangeInputResponse::SetLeases(const ChangeInputResponse::LeaseMap& leases) {
+        m_leases = leases;
+    }
+
+    const ChangeInputResponse::LeaseMap& ChangeInputResponse::GetLeases() const {
+        return m_leases;
+    }
+
     bool ChangeInputResponse::Deserialize(NetworkBuffer& buffer) {
         if(NetworkMessage::Deserialize(buffer)) {
             m_result.clear();
+            m_leases.clear();
 
-            uint8_t size;
-            Display display;
-            bool    result;
+            uint32_t                size;
+            uint32_t                elapsed;
+            Display                 display;
+            bool                    result;
+            Display::SerialNumber   serial;
+            uint8_t                 decision;
+            uint32_t                term;
+            LeaseResult             lease;
 
-            buffer >> size;
+            buffer >> Varint(m_requestId) >> Varint(elapsed) >> Varint(size);
+            m_elapsed = std::chrono::microseconds(elapsed);
 
-            for(int i = 0; i < size && buffer; i++) {
+            for(uint32_t i = 0; i < size && buffer; i++) {
                 buffer >> display >> result;
-                m_result[display] = result;
+                if(buffer) {
+                    m_result[display] = result;
+                }
+            }
+
+            buffer >> Varint(size);
+            for(uint32_t i = 0; i < size && buffer; i++) {
+                buffer >> Varint(serial) >> decision >> Varint(lease.token) >> lease.holder >> Varint(term);
+                if(buffer && decision <= static_cast<uint8_t>(LeaseDecision::STALE)) {
+                    lease.decision      = static_cast<LeaseDecision>(decision);
+                    lease.term          = std::chrono::milliseconds(term);
+                    m_leases[serial]    = lease;
+                }
             }
         }
 
@@ -37,11 +76,17 @@ namespace kvm {
 
     bool ChangeInputResponse::Serialize(NetworkBuffer& buffer) const {
         if(NetworkMessage::Serialize(buffer)) {
-            buffer << static_cast<uint32_t>(m_result.size());
+            buffer << Varint(m_requestId) << Varint(static_cast<uint32_t>(m_elapsed.count())) << Varint(m_result.size());
 
             for(auto it = m_result.begin(); it != m_result.end(); ++it) {
                 buffer << it->first << it->second;
             }
+
+            buffer << Varint(m_leases.size());
+            for(auto it = m_leases.begin(); it != m_leases.end(); ++it) {
+                auto& lease = it->second;
+                buffer << Varint(it->first) << static_cast<uint8_t>(lease.decision) << Varint(lease.token) << lease.holder << Varint(static_cast<uint32_t>(lease.term.count()));
+            }
         }
 
         return buffer;
@@ -0,0 +1,70 @@
+#include <networking/message/display_announcement.h>
+#include <networking/message/types.h>
+
+namespace kvm {
+    DisplayAnnouncement::DisplayAnnouncement() :
+    NetworkMessage(static_cast<NetworkMessage::Type>(NetworkMessageType::DISPLAY_ANNOUNCEMENT)),
+    m_complete(false)
+    {}
+
+    DisplayAnnouncement::DisplayAnnouncement(bool complete, const std::vector<Display::SerialNumber>& added, const std::vector<Display::SerialNumber>& removed) :
+    NetworkMessage(static_cast<NetworkMessage::Type>(NetworkMessageType::DISPLAY_ANNOUNCEMENT)),
+    m_complete(complete),
+    m_added(added),
+    m_removed(removed)
+    {}
+
+    bool DisplayAnnouncement::IsComplete() const {
+        return m_complete;
+    }
+
+    const std::vector<Display::SerialNumber>& DisplayAnnouncement::GetAdded() const {
+        return m_added;
+    }
+
+    const std::vector<Display::SerialNumber>& DisplayAnnouncement::GetRemoved() const {
+        return m_removed;
+    }
+
+    bool DisplayAnnouncement::Deserialize(NetworkBuffer& buffer) {
+        if(NetworkMessage::Deserialize(buffer)) {
+            m_added.clear();
+            m_removed.clear();
+
+            uint32_t size;
+            buffer >> m_complete >> Varint(size);
+            for(uint32_t i = 0; i < size && buffer; i++) {
+                Display::SerialNumber serial;
+                if(buffer >> Varint(serial)) {
+                    m_added.push_back(serial);
+                }
+            }
+
+            buffer >> Varint(size);
+            for(uint32_t i = 0; i < size && buffer; i++) {
+                Display::SerialNumber serial;
+                if(buffer >> Varint(serial)) {
+                    m_removed.push_back(serial);
+                }
+            }
+        }
+
+        return buffer;
+    }
+
+    bool DisplayAnnouncement::Serialize(NetworkBuffer& buffer) const {
+        if(NetworkMessage::Serialize(buffer)) {
+            buffer << m_complete << Varint(m_added.size());
+            for(auto serial : m_added) {
+                buffer << Varint(serial);
+            }
+
+            buffer << Varint(m_removed.size());
+            for(auto serial : m_removed) {
+                buffer << Varint(serial);
+            }
+        }
+
+        return buffer;
+    }
+}
\ No newline at end of file
@@ -1,8 +1,51 @@
 #include <networking/message/heartbeat.h>
 #include <networking/message/types.h>
+#include <core/time.h>
 
 namespace kvm {
   Heartbeat::Heartbeat() :
-  NetworkMessage(static_cast<NetworkMessage::Type>(NetworkMessageType::HEARTBEAT))
+  NetworkMessage(static_cast<NetworkMessage::Type>(NetworkMessageType::HEARTBEAT)),
+  m_timestamp(0),
+  m_echoTimestamp(0),
+  m_echoDelay(0)
   {}
+
+  Heartbeat::Heartbeat(Heartbeat::Timestamp timestamp, Heartbeat::Timestamp echoTimestamp, uint32_t echoDelay) :
+  NetworkMessage(static_cast<NetworkMessage::Type>(NetworkMessageType::HEARTBEAT)),
+  m_timestamp(timestamp),
+  m_echoTimestamp(echoTimestamp),
+  m_echoDelay(echoDelay)
+  {}
+
+  Heartbeat::Timestamp Heartbeat::GetTimestamp() const {
+    return m_timestamp;
+  }
+
+  Heartbeat::Timestamp Heartbeat::GetEchoTimestamp() const {
+    return m_echoTimestamp;
+  }
+
+  uint32_t Heartbeat::GetEchoDelay() const {
+    return m_echoDelay;
+  }
+
+  Heartbeat::Timestamp Heartbeat::Now() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now().time_since_epoch()).count();
+  }
+
+  bool Heartbeat::Deserialize(NetworkBuffer& buffer) {
+    if(NetworkMessage::Deserialize(buffer)) {
+      buffer >> m_timestamp >> m_echoTimestamp >> Varint(m_echoDelay);
+    }
+
+    return buffer;
+  }
+
+  bool Heartbeat::Serialize(NetworkBuffer& buffer) const {
+    if(NetworkMessage::Serialize(buffer)) {
+      buffer << m_timestamp << m_echoTimestamp << Varint(m_echoDelay);
+    }
+
+    return buffer;
+  }
 }
\ No newline at end of file
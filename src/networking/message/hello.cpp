@@ -0,0 +1,45 @@
+#include <networking/message/hello.h>
+#include <networking/message/types.h>
+
+namespace kvm {
+    Hello::Hello() :
+    NetworkMessage(static_cast<NetworkMessage::Type>(NetworkMessageType::HELLO)),
+    m_identity(0),
+    m_protocolVersion(0)
+    {}
+
+    Hello::Hello(const NodeIdentity& identity) :
+    NetworkMessage(static_cast<NetworkMessage::Type>(NetworkMessageType::HELLO)),
+    m_identity(identity),
+    m_protocolVersion(NetworkMessage::ProtocolVersion)
+    {}
+
+    const NodeIdentity& Hello::GetIdentity() const {
+        return m_identity;
+    }
+
+    uint32_t Hello::GetProtocolVersion() const {
+        return m_protocolVersion;
+    }
+
+    bool Hello::Deserialize(NetworkBuffer& buffer) {
+        if(NetworkMessage::Deserialize(buffer)) {
+            NodeId      id;
+            uint32_t    features;
+
+            if(buffer >> Varint(m_protocolVersion) >> id >> Varint(features)) {
+                m_identity = NodeIdentity(id, features);
+            }
+        }
+
+        return buffer;
+    }
+
+    bool Hello::Serialize(NetworkBuffer& buffer) const {
+        if(NetworkMessage::Serialize(buffer)) {
+            buffer << Varint(m_protocolVersion) << m_identity.GetId() << Varint(m_identity.GetFeatures());
+        }
+
+        return buffer;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,40 @@
+#include <networking/message/multicast_ack.h>
+#include <networking/message/types.h>
+
+namespace kvm {
+    MulticastAck::MulticastAck() :
+    NetworkMessage(static_cast<NetworkMessage::Type>(NetworkMessageType::MULTICAST_ACK)),
+    m_sequence(0),
+    m_node(0)
+    {}
+
+    MulticastAck::MulticastAck(MulticastAck::Sequence sequence, NodeId node) :
+    NetworkMessage(static_cast<NetworkMessage::Type>(NetworkMessageType::MULTICAST_ACK)),
+    m_sequence(sequence),
+    m_node(node)
+    {}
+
+    MulticastAck::Sequence MulticastAck::GetSequence() const {
+        return m_sequence;
+    }
+
+    NodeId MulticastAck::GetNodeId() const {
+        return m_node;
+    }
+
+    bool MulticastAck::Deserialize(NetworkBuffer& buffer) {
+        if(NetworkMessage::Deserialize(buffer)) {
+            buffer >> Varint(m_sequence) >> m_node;
+        }
+
+        return buffer;
+    }
+
+    bool MulticastAck::Serialize(NetworkBuffer& buffer) const {
+        if(NetworkMessage::Serialize(buffer)) {
+            buffer << Varint(m_sequence) << m_node;
+        }
+
+        return buffer;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,34 @@
+#include <networking/message/multicast_envelope.h>
+#include <networking/message/types.h>
+
+namespace kvm {
+    MulticastEnvelope::MulticastEnvelope() :
+    NetworkMessage(static_cast<NetworkMessage::Type>(NetworkMessageType::MULTICAST_ENVELOPE)),
+    m_sequence(0)
+    {}
+
+    MulticastEnvelope::MulticastEnvelope(MulticastEnvelope::Sequence sequence) :
+    NetworkMessage(static_cast<NetworkMessage::Type>(NetworkMessageType::MULTICAST_ENVELOPE)),
+    m_sequence(sequence)
+    {}
+
+    MulticastEnvelope::Sequence MulticastEnvelope::GetSequence() const {
+        return m_sequence;
+    }
+
+    bool MulticastEnvelope::Deserialize(NetworkBuffer& buffer) {
+        if(NetworkMessage::Deserialize(buffer)) {
+            buffer >> Varint(m_sequence);
+        }
+
+        return buffer;
+    }
+
+    bool MulticastEnvelope::Serialize(NetworkBuffer& buffer) const {
+        if(NetworkMessage::Serialize(buffer)) {
+            buffer << Varint(m_sequence);
+        }
+
+        return buffer;
+    }
+}
\ No newline at end of file
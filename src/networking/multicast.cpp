@@ -0,0 +1,117 @@
+#include <networking/multicast.h>
+#include <networking/message/registry.h>
+
+namespace kvm {
+  MulticastChannel::MulticastChannel() :
+  m_reactor(nullptr),
+  m_nextSequence(1),
+  m_listener(nullptr),
+  m_nodeId(0)
+  {}
+
+  bool MulticastChannel::Open(uint16_t port, Reactor& reactor) {
+    Close();
+
+    if(!m_socket.Open(port)) {
+      return false;
+    }
+
+    if(!reactor.Register(m_socket.GetHandle(), this)) {
+      m_socket.Close();
+      return false;
+    }
+
+    m_reactor = &reactor;
+    return true;
+  }
+
+  bool MulticastChannel::JoinGroup(const SocketAddress& group) {
+    if(m_socket.JoinGroup(group)) {
+      m_groups.push_back(group);
+      return true;
+    }
+    return false;
+  }
+
+  bool MulticastChannel::IsActive() const {
+    return m_socket.IsOpen() && !m_groups.empty();
+  }
+
+  bool MulticastChannel::CanCarry(const NetworkBuffer& message) {
+    NetworkBuffer envelope;
+    MulticastEnvelope().Serialize(envelope);
+    return envelope.GetSize() + message.GetSize() <= DatagramSocket::MaxPayloadSize;
+  }
+
+  std::optional<MulticastChannel::Sequence> MulticastChannel::Send(const NetworkBuffer& message) {
+    if(!IsActive() || !CanCarry(message)) {
+      return std::nullopt;
+    }
+
+    Sequence          sequence = m_nextSequence++;
+    NetworkBuffer     datagram;
+    MulticastEnvelope envelope(sequence);
+
+    if(!envelope.Serialize(datagram) || !datagram.Append(message.GetBuffer(), message.GetSize())) {
+      return std::nullopt;
+    }
+
+    if(m_socket.SendTo(m_groups, datagram) == 0) {
+      return std::nullopt;
+    }
+
+    return sequence;
+  }
+
+  void MulticastChannel::SetListener(MulticastChannel::Listener* listener) {
+    m_listener = listener;
+  }
+
+  void MulticastChannel::SetNodeId(NodeId id) {
+    m_nodeId = id;
+  }
+
+  void MulticastChannel::Close() {
+    if(m_reactor != nullptr && m_socket.IsOpen()) {
+      m_reactor->Deregister(m_socket.GetHandle());
+    }
+    m_reactor = nullptr;
+    m_socket.Close();
+    m_groups.clear();
+  }
+
+  /// Messages that arrive on the multicast channel
+  typedef MessageDispatcher<MulticastChannel, NetworkMessageType::MULTICAST_ACK, NetworkMessageType::MULTICAST_ENVELOPE> MulticastDispatcher;
+
+  void MulticastChannel::OnReadable() {
+    SocketAddress sender;
+
+    while(m_socket.ReceiveFrom(m_receiveBuffer, sender)) {
+      if(m_listener != nullptr) {
+        MulticastDispatcher::Dispatch(m_receiveBuffer, *this, sender);
+      }
+    }
+  }
+
+  void MulticastChannel::OnMessage(const MulticastAck& ack, const SocketAddress& sender) {
+    m_listener->OnMulticastAcknowledged(sender, ack.GetNodeId(), ack.GetSequence());
+  }
+
+  void MulticastChannel::OnMessage(const MulticastEnvelope& envelope, const SocketAddress& sender) {
+    // Narrow the window to the enclosed message so it reads exactly like one received over TCP.
+    auto offset = m_receiveBuffer.GetOffset();
+    m_receiveBuffer.Window(offset, m_receiveBuffer.GetSize() - offset);
+
+    if(m_listener->OnMulticastReceived(sender, m_receiveBuffer)) {
+      NetworkBuffer   buffer;
+      MulticastAck    ack(envelope.GetSequence(), m_nodeId);
+      if(ack.Serialize(buffer)) {
+        m_socket.SendTo(sender, buffer);
+      }
+    }
+  }
+
+  MulticastChannel::~MulticastChannel() {
+    Close();
+  }
+}
\ No newline at end of file
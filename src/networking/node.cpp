@@ -1,18 +1,61 @@
 #include <networking/node.h>
-#include <networking/message/heartbeat.h>
-#include <networking/message/types.h>
+#include <networking/message/registry.h>
+#include <networking/resolver.h>
+#include <algorithm>
+
+#define MIN_RECONNECT_DELAY_MS  250
+#define MAX_RECONNECT_DELAY_MS  30000
+#define CONNECT_TIMEOUT_MS      5000
+#define SEND_QUEUE_CAPACITY     (64 * 1024)
 
 namespace kvm {
-  Node::Node(const std::string& hostname, uint16_t port) {
-    auto address = Socket::GetAddressForHostname(hostname, port);
-    if(address.DidSucceed()) {
-      m_address = address.GetValue();
+  Node::Node(const std::string& hostname, uint16_t port) :
+  m_reactor(nullptr),
+  m_hostname(hostname),
+  m_port(port),
+  m_address(),
+  m_statistics(),
+  m_peerTimestamp(0),
+  m_peerTimestampArrival(0),
+  m_lastEcho(0),
+  m_backoff(MIN_RECONNECT_DELAY_MS),
+  m_nextConnectAttempt(Clock::now()),
+  m_random(std::random_device()()),
+  m_inbound(false),
+  m_dormant(false),
+  m_localIdentity(nullptr),
+  m_identified(false),
+  m_sendQueueBytes(0),
+  m_sendQueueCapacity(SEND_QUEUE_CAPACITY),
+  m_watchingWritable(false),
+  m_capture(nullptr) {
+    // Starts resolving the hostname so that the address is likely ready by the first connect attempt.
+    auto address = Resolver::Shared().Lookup(hostname, port);
+    if(address) {
+      m_address = address.value();
     }
   }
 
   Node::Node(Socket socket) :
+  m_reactor(nullptr),
+  m_port(0),
+  m_address(socket.GetAddress()),
   m_socket(socket),
-  m_address(socket.GetAddress())
+  m_statistics(),
+  m_peerTimestamp(0),
+  m_peerTimestampArrival(0),
+  m_lastEcho(0),
+  m_backoff(MIN_RECONNECT_DELAY_MS),
+  m_nextConnectAttempt(Clock::now()),
+  m_random(std::random_device()()),
+  m_inbound(true),
+  m_dormant(false),
+  m_localIdentity(nullptr),
+  m_identified(false),
+  m_sendQueueBytes(0),
+  m_sendQueueCapacity(SEND_QUEUE_CAPACITY),
+  m_watchingWritable(false),
+  m_capture(nullptr)
   {}
 
   SocketAddress Node::GetAddress() const {
@@ -23,8 +66,231 @@ namespace kvm {
     return m_socket.GetState() == Socket::SocketState::CONNECTED;
   }
 
+  bool Node::IsConnecting() const {
+    return m_socket.GetState() == Socket::SocketState::CONNECTING;
+  }
+
+  bool Node::IsIdentified() const {
+    return IsConnected() && m_identified;
+  }
+
+  bool Node::IsInbound() const {
+    return m_inbound;
+  }
+
+  const std::optional<NodeIdentity>& Node::GetPeerIdentity() const {
+    return m_peerIdentity;
+  }
+
+  void Node::SetLocalIdentity(const NodeIdentity* identity) {
+    m_localIdentity = identity;
+  }
+
+  bool Node::SendHello() {
+    if(m_localIdentity == nullptr) {
+      return false;
+    }
+
+    NetworkBuffer buffer;
+    Hello hello(*m_localIdentity);
+    return hello.Serialize(buffer) && Send(buffer);
+  }
+
+  void Node::SetDormant(bool dormant) {
+    m_dormant = dormant;
+    if(!dormant) {
+      m_nextConnectAttempt = Clock::now();
+    }
+  }
+
+  bool Node::IsDormant() const {
+    return m_dormant;
+  }
+
+  void Node::SetFailureDetection(const FailureDetector::Settings& settings) {
+    m_detector.SetSettings(settings);
+    m_detector.Reset(FailureDetector::Clock::now());
+  }
+
+  double Node::GetSuspicion() const {
+    return m_detector.GetSuspicion(FailureDetector::Clock::now());
+  }
+
+  void Node::SetSendQueueCapacity(size_t capacity) {
+    m_sendQueueCapacity = capacity;
+  }
+
+  size_t Node::GetSendQueueDepth() const {
+    return m_sendQueue.size();
+  }
+
+  void Node::SetCapture(CaptureWriter* capture) {
+    m_capture = capture;
+  }
+
   bool Node::Send(NetworkBuffer& buffer) {
-    return m_socket.Send(buffer);
+    if(!IsConnected() || buffer.GetSize() == 0 || !buffer) {
+      return false;
+    }
+
+    // With nothing queued ahead of it the message can go straight out of the caller's buffer, and is
+    // only copied if the socket won't take all of it.
+    size_t sent = 0;
+    if(m_sendQueue.empty()) {
+      auto written = m_socket.SendPartial(buffer, 0);
+      if(!written) {
+        Disconnect();
+        return false;
+      }
+
+      sent = written.value();
+      m_statistics.bytesSent += sent;
+      if(sent == Socket::GetFrameSize(buffer)) {
+        m_statistics.messagesSent++;
+        if(m_capture != nullptr) {
+          m_capture->Write(CapturedMessage::Direction::SENT, m_address, buffer);
+        }
+        return true;
+      }
+    }
+
+    return Enqueue(buffer, sent);
+  }
+
+  bool Node::Enqueue(NetworkBuffer& buffer, size_t sent) {
+    auto type = static_cast<NetworkMessageType>(buffer.GetBuffer()[0]);
+
+    // Only messages that haven't started going out can be replaced; a partly written frame must finish.
+    auto superseded = [type](const OutboundMessage& message) {
+      return message.sent == 0 && message.type == type;
+    };
+
+    if(sent == 0 && type == NetworkMessageType::HEARTBEAT) {
+      auto queued = std::find_if(m_sendQueue.begin(), m_sendQueue.end(), superseded);
+      if(queued != m_sendQueue.end()) {
+        m_sendQueueBytes -= Socket::GetFrameSize(queued->buffer);
+        m_sendQueueBytes += Socket::GetFrameSize(buffer);
+        queued->buffer    = buffer;
+        m_statistics.messagesShed++;
+        return true;
+      }
+    }
+
+    std::optional<NetworkBuffer> merged;
+    if(sent == 0 && type == NetworkMessageType::CHANGE_INPUT_REQUEST) {
+      merged = MergeQueuedRequest(buffer);
+    }
+
+    auto& message = merged ? merged.value() : buffer;
+    m_sendQueue.push_back(OutboundMessage{message, type, sent});
+    m_sendQueueBytes += Socket::GetFrameSize(message);
+
+    // Heartbeats are the first to go, since the peer can't be hearing from us in time anyway.
+    if(m_sendQueueBytes > m_sendQueueCapacity) {
+      for(auto it = m_sendQueue.begin(); it != m_sendQueue.end();) {
+        if(it->sent == 0 && it->type == NetworkMessageType::HEARTBEAT) {
+          m_sendQueueBytes -= Socket::GetFrameSize(it->buffer);
+          m_statistics.messagesShed++;
+          it = m_sendQueue.erase(it);
+        } else {
+          ++it;
+        }
+      }
+    }
+
+    // The peer has stopped reading. Cutting it loose keeps its backlog from growing without bound, and
+    // requests it was sent are failed rather than left waiting.
+    if(m_sendQueueBytes > m_sendQueueCapacity) {
+      Disconnect();
+      return false;
+    }
+
+    WatchWritable(true);
+    return true;
+  }
+
+  std::optional<NetworkBuffer> Node::MergeQueuedRequest(NetworkBuffer& buffer) {
+    auto queued = std::find_if(m_sendQueue.begin(), m_sendQueue.end(), [](const OutboundMessage& message) {
+      return message.sent == 0 && message.type == NetworkMessageType::CHANGE_INPUT_REQUEST;
+    });
+    if(queued == m_sendQueue.end()) {
+      return std::nullopt;
+    }
+
+    NetworkBuffer older = queued->buffer;
+    NetworkBuffer newer = buffer;
+    ChangeInputRequest olderRequest, newerRequest;
+    if(!olderRequest.Deserialize(older.Reset()) || !newerRequest.Deserialize(newer.Reset())) {
+      return std::nullopt;
+    }
+
+    // Later changes to a display replace earlier ones, as they would have once both requests arrived.
+    auto changes = olderRequest.GetInputMap();
+    for(auto &change : newerRequest.GetInputMap()) {
+      changes[change.first] = change.second;
+    }
+
+    // The newer request quotes the newest lease tokens for the displays that both ask for.
+    auto fences = olderRequest.GetFences();
+    for(auto &fence : newerRequest.GetFences()) {
+      fences[fence.first] = fence.second;
+    }
+
+    ChangeInputRequest request(newerRequest.GetId(), changes);
+    request.SetFences(fences);
+
+    NetworkBuffer merged;
+    if(!request.Serialize(merged)) {
+      return std::nullopt;
+    }
+
+    m_sendQueueBytes -= Socket::GetFrameSize(older);
+    m_sendQueue.erase(queued);
+    m_statistics.messagesShed++;
+
+    for(auto listener : m_listeners) {
+      listener->OnMessageSuperseded(*this, older.Reset());
+    }
+    return merged;
+  }
+
+  void Node::Flush() {
+    while(!m_sendQueue.empty()) {
+      auto& message = m_sendQueue.front();
+      auto  frame   = Socket::GetFrameSize(message.buffer);
+      auto  written = m_socket.SendPartial(message.buffer, message.sent);
+      if(!written) {
+        Disconnect();
+        return;
+      }
+
+      message.sent += written.value();
+      m_statistics.bytesSent += written.value();
+      if(message.sent < frame) {
+        break;
+      }
+
+      // Queued messages are captured as they finish going out, so that superseded ones never are.
+      m_statistics.messagesSent++;
+      if(m_capture != nullptr) {
+        m_capture->Write(CapturedMessage::Direction::SENT, m_address, message.buffer);
+      }
+      m_sendQueueBytes -= frame;
+      m_sendQueue.pop_front();
+    }
+
+    WatchWritable(!m_sendQueue.empty());
+  }
+
+  void Node::WatchWritable(bool watch) {
+    if(watch == m_watchingWritable) {
+      return;
+    }
+
+    m_watchingWritable = watch;
+    if(m_reactor != nullptr && IsConnected()) {
+      m_reactor->Modify(m_socket.GetHandle(), this, watch ? Reactor::READABLE | Reactor::WRITABLE : Reactor::READABLE);
+    }
   }
 
   void Node::AddListener(Node::Listener* listener) {
@@ -36,44 +302,259 @@ namespace kvm {
     m_listeners.erase(std::remove(m_listeners.begin(), m_listeners.end(), listener), m_listeners.end());
   }
 
+  void Node::SetReactor(Reactor* reactor) {
+    if(m_reactor != nullptr && IsConnected()) {
+      m_reactor->Deregister(m_socket.GetHandle());
+    }
+
+    m_reactor = reactor;
+
+    if(m_reactor != nullptr && IsConnected()) {
+      m_reactor->Register(m_socket.GetHandle(), this, m_watchingWritable ? Reactor::READABLE | Reactor::WRITABLE : Reactor::READABLE);
+    }
+  }
+
   void Node::Pump() {
-    if(m_socket.GetState() != Socket::SocketState::CONNECTED) {
-      auto result = m_socket.Connect(m_address);
-      if(result.has_value() == false) {
-        for(auto listener : m_listeners) {
-          listener->OnNodeConnected(*this);
-        }
-        m_lastSeen = std::chrono::system_clock::now();
+    auto now = Clock::now();
+
+    if(m_socket.GetState() == Socket::SocketState::DISCONNECTED) {
+      if(m_inbound || m_dormant || now < m_nextConnectAttempt) {
+        return;
+      }
+
+      // Try again on the next pump if the hostname hasn't been resolved yet.
+      auto address = Resolver::Shared().Lookup(m_hostname, m_port);
+      if(!address) {
+        return;
+      }
+      m_address = address.value();
+
+      if(m_socket.Connect(m_address).has_value()) {
+        OnConnectFailed();
+        return;
       }
 
+      m_connectStarted = now;
+      if(m_reactor != nullptr) {
+        m_reactor->Register(m_socket.GetHandle(), this, Reactor::WRITABLE);
+      }
       return;
     }
 
-    NetworkBuffer buffer;
-    
-    if(m_spacer(std::chrono::seconds(5))) {
-      Heartbeat heartbeat;
-      heartbeat.Serialize(buffer);
-      m_socket.Send(buffer);
+    if(m_socket.GetState() == Socket::SocketState::CONNECTING) {
+      if(now - m_connectStarted >= std::chrono::milliseconds(CONNECT_TIMEOUT_MS)) {
+        OnConnectFailed();
+      }
+      return;
+    }
+
+    // Normally the reactor reports when queued messages can be sent, but it may not have been set.
+    if(m_reactor == nullptr && !m_sendQueue.empty()) {
+      Flush();
+    }
+
+    if(m_spacer(m_detector.GetSettings().heartbeatInterval)) {
+      SendHeartbeat();
+    }
+
+    if(IsConnected() && !m_detector.IsAvailable(now)) {
+      Disconnect();
+    }
+  }
+
+  /// Messages that nodes handle themselves rather than passing to listeners
+  typedef MessageDispatcher<Node, NetworkMessageType::HELLO, NetworkMessageType::HEARTBEAT> NodeDispatcher;
+
+  void Node::OnReadable() {
+    if(!IsConnected()) {
+      return;
+    }
+
+    if(m_socket.Receive() == false) {
+      Disconnect();
+      return;
     }
 
-    buffer.Reset();
+    while(auto buffer = m_socket.NextMessage()) {
+      m_statistics.messagesReceived++;
+      m_statistics.bytesReceived += sizeof(uint32_t) + buffer->GetSize();
+      if(m_capture != nullptr) {
+        m_capture->Write(CapturedMessage::Direction::RECEIVED, m_address, *buffer);
+      }
 
-    if(m_socket.Receive(buffer)) {
-      if(NetworkMessage::IsContainedIn(static_cast<NetworkMessage::Type>(NetworkMessageType::HEARTBEAT), buffer) == false) {
+      if(!NodeDispatcher::Dispatch(*buffer, *this)) {
         for(auto listener : m_listeners) {
-          listener->OnMessageReceived(*this, buffer);
+          listener->OnMessageReceived(*this, *buffer);
         }
-      } else {
-        m_lastSeen = std::chrono::system_clock::now();
       }
+
+      // Listeners may have closed this connection, which invalidates the reassembly buffer.
+      if(!IsConnected()) {
+        return;
+      }
+    }
+  }
+
+  void Node::OnWritable() {
+    if(IsConnected()) {
+      Flush();
+      return;
+    }
+
+    if(m_socket.GetState() != Socket::SocketState::CONNECTING) {
+      return;
+    }
+
+    // A failed attempt closes the socket, so hold on to the handle in order to deregister it.
+    auto handle = m_socket.GetHandle();
+
+    if(m_socket.CompleteConnect().has_value()) {
+      if(m_reactor != nullptr) {
+        m_reactor->Deregister(handle);
+      }
+      OnConnectFailed();
+      return;
+    }
+
+    OnConnected();
+  }
+
+  void Node::OnConnected() {
+    if(m_reactor != nullptr) {
+      m_reactor->Modify(m_socket.GetHandle(), this, Reactor::READABLE);
+    }
+
+    m_watchingWritable = false;
+    m_backoff   = std::chrono::milliseconds(MIN_RECONNECT_DELAY_MS);
+    m_detector.Reset(FailureDetector::Clock::now());
+    m_peerTimestamp = 0;
+    m_lastRoundTripTime.reset();
+
+    for(auto listener : m_listeners) {
+      listener->OnNodeConnected(*this);
+    }
+
+    // Introduce ourselves straight away. Under TCP Fast Open this is the message that travels in the SYN.
+    SendHello();
+  }
+
+  void Node::OnMessage(const Hello& hello) {
+    // Nothing else the peer sends could be decoded correctly.
+    if(hello.GetProtocolVersion() != NetworkMessage::ProtocolVersion) {
+      Disconnect();
+      return;
+    }
+
+    m_peerIdentity  = hello.GetIdentity();
+    m_identified    = true;
+
+    for(auto listener : m_listeners) {
+      listener->OnNodeIdentified(*this);
+    }
+  }
+
+  void Node::OnMessage(const Heartbeat& heartbeat) {
+    auto now = Heartbeat::Now();
+    m_detector.OnHeartbeat(FailureDetector::Clock::now());
+    m_peerTimestamp         = heartbeat.GetTimestamp();
+    m_peerTimestampArrival  = now;
+
+    // The peer held our heartbeat for the echo delay before replying, which isn't network time.
+    auto echo = heartbeat.GetEchoTimestamp();
+    if(echo == 0 || echo == m_lastEcho || now < echo + heartbeat.GetEchoDelay()) {
+      return;
+    }
+
+    uint64_t roundTripTime = now - echo - heartbeat.GetEchoDelay();
+    m_statistics.roundTripTime.Record(roundTripTime);
+    if(m_lastRoundTripTime) {
+      auto previous = m_lastRoundTripTime.value();
+      m_statistics.jitter.Record(roundTripTime > previous ? roundTripTime - previous : previous - roundTripTime);
+    }
+
+    m_lastRoundTripTime = roundTripTime;
+    m_lastEcho          = echo;
+  }
+
+  void Node::SendHeartbeat() {
+    auto now    = Heartbeat::Now();
+    auto delay  = m_peerTimestamp == 0 ? 0 : now - m_peerTimestampArrival;
+
+    NetworkBuffer buffer;
+    Heartbeat heartbeat(now, m_peerTimestamp, static_cast<uint32_t>(std::min<uint64_t>(delay, UINT32_MAX)));
+    if(heartbeat.Serialize(buffer)) {
+      Send(buffer);
+    }
+  }
+
+  NodeSummary Node::GetSummary() const {
+    NodeSummary summary;
+    summary.address = m_address;
+    summary.inbound = m_inbound;
+
+    if(m_peerIdentity) {
+      summary.peerId = m_peerIdentity->GetId();
+    }
+    return summary;
+  }
+
+  LinkStatistics Node::GetStatistics() const {
+    LinkStatistics statistics = m_statistics;
+    statistics.address        = m_address;
+    statistics.connected      = IsConnected();
+    statistics.suspicion      = IsConnected() ? GetSuspicion() : 0;
+    statistics.sendQueueDepth = m_sendQueue.size();
+    statistics.sendQueueBytes = m_sendQueueBytes;
+    statistics.lastSeenAge    = std::chrono::duration_cast<std::chrono::milliseconds>(FailureDetector::Clock::now() - m_detector.GetLastHeartbeat());
+
+    if(m_peerIdentity) {
+      statistics.peerId = m_peerIdentity->GetId();
     }
+    return statistics;
+  }
+
+  void Node::OnConnectFailed() {
+    Resolver::Shared().Invalidate(m_hostname);
+    ScheduleReconnect();
+  }
 
-    if( m_socket.GetState() != Socket::SocketState::CONNECTED || 
-        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - m_lastSeen) >= std::chrono::seconds(15)) {
-      for(auto listener : m_listeners) {
-        listener->OnNodeDisconnected(*this);
+  void Node::ScheduleReconnect() {
+    if(m_socket.GetState() != Socket::SocketState::DISCONNECTED) {
+      if(m_reactor != nullptr) {
+        m_reactor->Deregister(m_socket.GetHandle());
       }
+      m_socket.Disconnect();
+    }
+
+    // Queued messages belong to the lost connection; the peer learns current state when it reconnects.
+    m_sendQueue.clear();
+    m_sendQueueBytes    = 0;
+    m_watchingWritable  = false;
+
+    // Wait somewhere between half and all of the current delay, so that nodes which lost a peer at the
+    // same moment don't all retry it at the same moment.
+    std::uniform_int_distribution<long long> jitter(m_backoff.count() / 2, m_backoff.count());
+    m_nextConnectAttempt  = Clock::now() + std::chrono::milliseconds(jitter(m_random));
+    m_backoff             = std::min(m_backoff * 2, std::chrono::milliseconds(MAX_RECONNECT_DELAY_MS));
+  }
+
+  void Node::Disconnect() {
+    if(m_socket.GetState() != Socket::SocketState::CONNECTED) {
+      return;
+    }
+
+    ScheduleReconnect();
+    m_identified = false;
+
+    for(auto listener : m_listeners) {
+      listener->OnNodeDisconnected(*this);
+    }
+  }
+
+  Node::~Node() {
+    if(m_reactor != nullptr && m_socket.GetState() != Socket::SocketState::DISCONNECTED) {
+      m_reactor->Deregister(m_socket.GetHandle());
     }
+    m_socket.Disconnect();
   }
-}
\ No newline at end of file
+}
@@ -0,0 +1,78 @@
+#include <networking/pool.h>
+
+#define MAX_CACHED_SEGMENTS_PER_CLASS 64
+
+namespace kvm {
+    const size_t BufferPool::MinSegmentSize = 256;
+    const size_t BufferPool::MaxSegmentSize = BufferPool::MinSegmentSize << (BufferPool::SizeClassCount - 1);
+
+    BufferPool& BufferPool::Local() {
+        static thread_local BufferPool pool;
+        return pool;
+    }
+
+    uint8_t* BufferPool::Acquire(size_t size, size_t& capacity) {
+        if(size > MaxSegmentSize) {
+            capacity = size;
+            return new uint8_t[size];
+        }
+
+        auto sizeClass  = GetSizeClass(size);
+        capacity        = MinSegmentSize << sizeClass;
+
+        auto& segments = m_free[sizeClass];
+        if(segments.empty()) {
+            return new uint8_t[capacity];
+        }
+
+        auto segment = segments.back();
+        segments.pop_back();
+        return segment;
+    }
+
+    void BufferPool::Release(uint8_t* segment, size_t capacity) {
+        if(segment == nullptr) {
+            return;
+        }
+
+        if(capacity > MaxSegmentSize || capacity != (MinSegmentSize << GetSizeClass(capacity))) {
+            delete[] segment;
+            return;
+        }
+
+        auto& segments = m_free[GetSizeClass(capacity)];
+        if(segments.size() >= MAX_CACHED_SEGMENTS_PER_CLASS) {
+            delete[] segment;
+            return;
+        }
+
+        if(segments.capacity() == 0) {
+            segments.reserve(MAX_CACHED_SEGMENTS_PER_CLASS);
+        }
+        segments.push_back(segment);
+    }
+
+    size_t BufferPool::GetCachedSegmentCount() const {
+        size_t count = 0;
+        for(auto& segments : m_free) {
+            count += segments.size();
+        }
+        return count;
+    }
+
+    size_t BufferPool::GetSizeClass(size_t size) {
+        size_t sizeClass = 0;
+        while((MinSegmentSize << sizeClass) < size) {
+            sizeClass++;
+        }
+        return sizeClass;
+    }
+
+    BufferPool::~BufferPool() {
+        for(auto& segments : m_free) {
+            for(auto segment : segments) {
+                delete[] segment;
+            }
+        }
+    }
+}
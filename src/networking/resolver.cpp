@@ -0,0 +1,108 @@
+#include <networking/resolver.h>
+
+namespace kvm {
+  Resolver& Resolver::Shared() {
+    static Resolver resolver;
+    return resolver;
+  }
+
+  Resolver::Resolver(std::chrono::milliseconds ttl, std::chrono::milliseconds negativeTtl) :
+  m_ttl(ttl),
+  m_negativeTtl(negativeTtl),
+  m_stopping(false)
+  {}
+
+  std::optional<SocketAddress> Resolver::Lookup(const Socket::HostName& hostname, uint16_t port) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_cache.find(hostname);
+    if(it == m_cache.end()) {
+      // IP addresses need no lookup and never expire.
+      auto parsed = Socket::ParseAddress(hostname, 0);
+      Entry entry{std::nullopt, Clock::time_point::max(), false};
+      if(parsed.DidSucceed()) {
+        entry.address = parsed.GetValue();
+      }
+      it = m_cache.emplace(hostname, entry).first;
+
+      if(!entry.address) {
+        Queue(hostname, it->second);
+      }
+    } else if(Clock::now() >= it->second.expires) {
+      Queue(hostname, it->second);
+    }
+
+    if(!it->second.address) {
+      return std::nullopt;
+    }
+
+    SocketAddress address = it->second.address.value();
+    address.sin_port = HostToNetwork(port);
+    return address;
+  }
+
+  void Resolver::Invalidate(const Socket::HostName& hostname) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_cache.find(hostname);
+    if(it != m_cache.end() && it->second.expires != Clock::time_point::max()) {
+      it->second.expires = Clock::now();
+    }
+  }
+
+  void Resolver::Queue(const Socket::HostName& hostname, Resolver::Entry& entry) {
+    if(entry.resolving) {
+      return;
+    }
+
+    entry.resolving = true;
+    m_queue.push_back(hostname);
+
+    if(!m_worker.joinable()) {
+      m_worker = std::thread(&Resolver::Run, this);
+    }
+    m_wake.notify_one();
+  }
+
+  void Resolver::Run() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while(true) {
+      m_wake.wait(lock, [this]() { return m_stopping || !m_queue.empty(); });
+      if(m_stopping) {
+        return;
+      }
+
+      auto hostname = m_queue.front();
+      m_queue.pop_front();
+
+      // Don't hold up lookups on the network loop while this one blocks.
+      lock.unlock();
+      auto result = Socket::GetAddressForHostname(hostname, 0);
+      lock.lock();
+
+      auto& entry     = m_cache[hostname];
+      entry.resolving = false;
+
+      // Keep the last known address through a failed lookup; it may still work.
+      if(result.DidSucceed()) {
+        entry.address = result.GetValue();
+        entry.expires = Clock::now() + m_ttl;
+      } else {
+        entry.expires = Clock::now() + m_negativeTtl;
+      }
+    }
+  }
+
+  Resolver::~Resolver() {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stopping = true;
+    }
+    m_wake.notify_all();
+
+    if(m_worker.joinable()) {
+      m_worker.join();
+    }
+  }
+}
\ No newline at end of file
@@ -1,6 +1,47 @@
 #include <networking/socket.h>
 
+#define FRAME_HEADER_SIZE sizeof(uint32_t)
+
 namespace kvm {
+  NetworkBuffer* Socket::NextMessage() {
+    uint32_t length;
+
+    m_receiveBuffer.Window(m_receiveFrame, m_receiveLength - m_receiveFrame);
+
+    if( m_receiveBuffer.GetRemaining() >= FRAME_HEADER_SIZE && 
+        m_receiveBuffer.Peek(length) &&
+        m_receiveBuffer.GetRemaining() >= FRAME_HEADER_SIZE + length) {
+      m_receiveBuffer.Window(m_receiveFrame + FRAME_HEADER_SIZE, length);
+      m_receiveFrame += FRAME_HEADER_SIZE + length;
+      return &m_receiveBuffer;
+    }
+
+    m_receiveBuffer.Compact();
+    m_receiveLength -= m_receiveFrame;
+    m_receiveFrame   = 0;
+    return nullptr;
+  }
+
+  bool Socket::IsFrameValid() {
+    uint32_t length;
+
+    m_receiveBuffer.Window(0, m_receiveLength).Skip(m_receiveFrame);
+
+    if(m_receiveBuffer.GetRemaining() < FRAME_HEADER_SIZE || !m_receiveBuffer.Peek(length)) {
+      return true;
+    }
+
+    if(length > NetworkBuffer::MaxCapacity - FRAME_HEADER_SIZE - m_receiveFrame) {
+      return false;
+    }
+
+    return m_receiveBuffer.Reserve(m_receiveFrame + FRAME_HEADER_SIZE + length);
+  }
+
+  size_t Socket::GetFrameSize(const NetworkBuffer& buffer) {
+    return FRAME_HEADER_SIZE + buffer.GetSize();
+  }
+
   Socket::SocketState Socket::GetState() const {
     return m_state;
   }
@@ -8,4 +49,8 @@ namespace kvm {
   SocketAddress Socket::GetAddress() const {
     return m_address;
   }
+
+  PlatformSocket Socket::GetHandle() const {
+    return m_socket;
+  }
 }
\ No newline at end of file
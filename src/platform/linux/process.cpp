@@ -0,0 +1,39 @@
+#include <platform/process.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+
+namespace kvm {
+    std::optional<std::chrono::microseconds> GetProcessCPUTime(int pid) {
+        std::ifstream file("/proc/" + std::to_string(pid) + "/stat");
+        std::string stat;
+        if(!file || !std::getline(file, stat)) {
+            return std::nullopt;
+        }
+
+        // The command name is in parentheses and may itself contain spaces, so fields are counted from
+        // the closing parenthesis. User and system time are the 14th and 15th fields.
+        auto end = stat.rfind(')');
+        if(end == std::string::npos) {
+            return std::nullopt;
+        }
+
+        std::istringstream fields(stat.substr(end + 1));
+        std::string skipped;
+        for(int field = 3; field < 14; field++) {
+            fields >> skipped;
+        }
+
+        unsigned long long user = 0, system = 0;
+        if(!(fields >> user >> system)) {
+            return std::nullopt;
+        }
+
+        auto ticksPerSecond = sysconf(_SC_CLK_TCK);
+        if(ticksPerSecond <= 0) {
+            return std::nullopt;
+        }
+        return std::chrono::microseconds((user + system) * 1000000 / ticksPerSecond);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,78 @@
+#if !defined(KVM_USE_IO_URING)
+
+#include <networking/reactor.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#define MAX_EVENTS_PER_POLL 64
+
+namespace kvm {
+    Reactor::Reactor() :
+    m_reactor(-1)
+    {}
+
+    bool Reactor::Initialize() {
+        if(m_reactor == -1) {
+            m_reactor = epoll_create1(EPOLL_CLOEXEC);
+        }
+        return m_reactor != -1;
+    }
+
+    static struct epoll_event MakeEvent(Reactor::Handler* handler, uint8_t interest) {
+        struct epoll_event event;
+        event.events    = 0;
+        event.data.ptr  = handler;
+
+        if(interest & Reactor::READABLE) {
+            event.events |= EPOLLIN | EPOLLRDHUP;
+        }
+        if(interest & Reactor::WRITABLE) {
+            event.events |= EPOLLOUT;
+        }
+        return event;
+    }
+
+    bool Reactor::Register(PlatformSocket socket, Reactor::Handler* handler, uint8_t interest) {
+        struct epoll_event event = MakeEvent(handler, interest);
+        return epoll_ctl(m_reactor, EPOLL_CTL_ADD, socket, &event) == 0;
+    }
+
+    bool Reactor::Modify(PlatformSocket socket, Reactor::Handler* handler, uint8_t interest) {
+        struct epoll_event event = MakeEvent(handler, interest);
+        return epoll_ctl(m_reactor, EPOLL_CTL_MOD, socket, &event) == 0;
+    }
+
+    void Reactor::Deregister(PlatformSocket socket) {
+        struct epoll_event event;
+        epoll_ctl(m_reactor, EPOLL_CTL_DEL, socket, &event);
+    }
+
+    size_t Reactor::Poll(std::chrono::milliseconds timeout) {
+        struct epoll_event events[MAX_EVENTS_PER_POLL];
+
+        int count = epoll_wait(m_reactor, events, MAX_EVENTS_PER_POLL, static_cast<int>(timeout.count()));
+
+        for(int i = 0; i < count; i++) {
+            auto handler = reinterpret_cast<Reactor::Handler*>(events[i].data.ptr);
+
+            // Errors and hang-ups are reported to both callbacks so that whichever the handler is waiting
+            // on notices them.
+            if(events[i].events & (EPOLLOUT | EPOLLERR | EPOLLHUP)) {
+                handler->OnWritable();
+            }
+            if(events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLERR | EPOLLHUP)) {
+                handler->OnReadable();
+            }
+        }
+
+        return count > 0 ? count : 0;
+    }
+
+    Reactor::~Reactor() {
+        if(m_reactor != -1) {
+            close(m_reactor);
+        }
+    }
+}
+
+#endif // !KVM_USE_IO_URING
\ No newline at end of file
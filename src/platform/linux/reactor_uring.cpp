@@ -0,0 +1,305 @@
+#if defined(KVM_USE_IO_URING)
+
+#include <networking/reactor.h>
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <poll.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <unordered_map>
+
+#define RING_ENTRIES 256
+
+namespace kvm {
+    /**
+     * A socket registered with the ring and the handler that its completions are dispatched to.
+     */
+    struct PlatformRingEntry {
+        PlatformSocket                              socket;
+        Reactor::Handler*                           handler;
+        uint8_t                                     interest;
+    };
+
+    /**
+     * Submission and completion queues shared with the kernel, plus the bookkeeping needed to map
+     * completions back to handlers. Each registered socket gets a one-shot poll request, identified by a
+     * token so that completions which arrive after the socket is deregistered can be discarded. The poll
+     * is armed again once its handler has run, so a socket with data or connections left over is
+     * reported again, as it would be by epoll.
+     */
+    struct PlatformRing {
+        int                                         fd;
+        void*                                       sqRing;
+        size_t                                      sqRingSize;
+        void*                                       cqRing;
+        size_t                                      cqRingSize;
+        struct io_uring_sqe*                        sqes;
+        size_t                                      sqesSize;
+        unsigned*                                   sqHead;
+        unsigned*                                   sqTail;
+        unsigned*                                   sqMask;
+        unsigned*                                   sqArray;
+        unsigned*                                   cqHead;
+        unsigned*                                   cqTail;
+        unsigned*                                   cqMask;
+        struct io_uring_cqe*                        cqes;
+        unsigned                                    entries;
+        unsigned                                    pending;
+        uint64_t                                    nextToken;
+        std::unordered_map<uint64_t, PlatformRingEntry>  registrations;
+        std::unordered_map<PlatformSocket, uint64_t>     tokens;
+    };
+
+    static int RingEnter(PlatformRing* ring, unsigned submit, unsigned wait, unsigned flags, void* argument, size_t argumentSize) {
+        return static_cast<int>(syscall(__NR_io_uring_enter, ring->fd, submit, wait, flags, argument, argumentSize));
+    }
+
+    /**
+     * Submit queued entries, optionally waiting for completions. Entries the kernel did not consume stay pending, so
+     * a failed or interrupted call is retried on the next submission.
+     */
+    static bool Submit(PlatformRing* ring, unsigned wait, unsigned flags, void* argument, size_t argumentSize) {
+        int submitted = RingEnter(ring, ring->pending, wait, flags, argument, argumentSize);
+        if(submitted < 0) {
+            return false;
+        }
+
+        ring->pending -= std::min(static_cast<unsigned>(submitted), ring->pending);
+        return true;
+    }
+
+    static unsigned LoadAcquire(unsigned* value) {
+        return reinterpret_cast<std::atomic<unsigned>*>(value)->load(std::memory_order_acquire);
+    }
+
+    static void StoreRelease(unsigned* value, unsigned newValue) {
+        reinterpret_cast<std::atomic<unsigned>*>(value)->store(newValue, std::memory_order_release);
+    }
+
+    /**
+     * Claim the next free submission queue entry, submitting queued entries first if the queue is full.
+     */
+    static struct io_uring_sqe* NextSubmission(PlatformRing* ring) {
+        unsigned tail = *ring->sqTail;
+
+        if(tail - LoadAcquire(ring->sqHead) >= ring->entries) {
+            if(!Submit(ring, 0, 0, NULL, 0)) {
+                return NULL;
+            }
+
+            if(tail - LoadAcquire(ring->sqHead) >= ring->entries) {
+                return NULL;
+            }
+        }
+
+        unsigned index          = tail & *ring->sqMask;
+        struct io_uring_sqe* sqe = &ring->sqes[index];
+        memset(sqe, 0, sizeof(*sqe));
+
+        ring->sqArray[index] = index;
+        StoreRelease(ring->sqTail, tail + 1);
+        ring->pending++;
+
+        return sqe;
+    }
+
+    static bool ArmPoll(PlatformRing* ring, const PlatformRingEntry& entry, uint64_t token) {
+        struct io_uring_sqe* sqe = NextSubmission(ring);
+        if(sqe == NULL) {
+            return false;
+        }
+
+        sqe->opcode         = IORING_OP_POLL_ADD;
+        sqe->fd             = entry.socket;
+        sqe->poll32_events  = ((entry.interest & Reactor::READABLE) ? (POLLIN | POLLRDHUP) : 0) | ((entry.interest & Reactor::WRITABLE) ? POLLOUT : 0);
+        sqe->user_data      = token;
+        return true;
+    }
+
+    static void DestroyRing(PlatformRing* ring) {
+        if(ring->sqes != MAP_FAILED && ring->sqes != NULL) {
+            munmap(ring->sqes, ring->sqesSize);
+        }
+        if(ring->cqRing != MAP_FAILED && ring->cqRing != NULL && ring->cqRing != ring->sqRing) {
+            munmap(ring->cqRing, ring->cqRingSize);
+        }
+        if(ring->sqRing != MAP_FAILED && ring->sqRing != NULL) {
+            munmap(ring->sqRing, ring->sqRingSize);
+        }
+        if(ring->fd != -1) {
+            close(ring->fd);
+        }
+        delete ring;
+    }
+
+    Reactor::Reactor() :
+    m_reactor(nullptr)
+    {}
+
+    bool Reactor::Initialize() {
+        if(m_reactor != nullptr) {
+            return true;
+        }
+
+        struct io_uring_params params;
+        memset(&params, 0, sizeof(params));
+
+        PlatformRing* ring  = new PlatformRing();
+        ring->sqRing        = NULL;
+        ring->cqRing        = NULL;
+        ring->sqes          = NULL;
+        ring->pending       = 0;
+        ring->nextToken     = 1;
+        ring->fd            = static_cast<int>(syscall(__NR_io_uring_setup, RING_ENTRIES, &params));
+
+        // Poll() passes its timeout through IORING_ENTER_EXT_ARG, which kernels before 5.11 reject.
+        if(ring->fd == -1 || !(params.features & IORING_FEAT_EXT_ARG)) {
+            DestroyRing(ring);
+            return false;
+        }
+
+        ring->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        ring->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+        if(params.features & IORING_FEAT_SINGLE_MMAP) {
+            ring->sqRingSize = ring->cqRingSize = std::max(ring->sqRingSize, ring->cqRingSize);
+        }
+
+        ring->sqRing = mmap(NULL, ring->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+        if(ring->sqRing == MAP_FAILED) {
+            DestroyRing(ring);
+            return false;
+        }
+
+        if(params.features & IORING_FEAT_SINGLE_MMAP) {
+            ring->cqRing = ring->sqRing;
+        } else {
+            ring->cqRing = mmap(NULL, ring->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+            if(ring->cqRing == MAP_FAILED) {
+                DestroyRing(ring);
+                return false;
+            }
+        }
+
+        ring->sqesSize  = params.sq_entries * sizeof(struct io_uring_sqe);
+        ring->sqes      = reinterpret_cast<struct io_uring_sqe*>(mmap(NULL, ring->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES));
+        if(ring->sqes == MAP_FAILED) {
+            DestroyRing(ring);
+            return false;
+        }
+
+        uint8_t* sq     = reinterpret_cast<uint8_t*>(ring->sqRing);
+        uint8_t* cq     = reinterpret_cast<uint8_t*>(ring->cqRing);
+        ring->sqHead    = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        ring->sqTail    = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        ring->sqMask    = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        ring->sqArray   = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        ring->cqHead    = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        ring->cqTail    = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        ring->cqMask    = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        ring->cqes      = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+        ring->entries   = params.sq_entries;
+
+        m_reactor = ring;
+        return true;
+    }
+
+    bool Reactor::Register(PlatformSocket socket, Reactor::Handler* handler, uint8_t interest) {
+        uint64_t            token = m_reactor->nextToken++;
+        PlatformRingEntry   entry{socket, handler, interest};
+
+        if(!ArmPoll(m_reactor, entry, token)) {
+            return false;
+        }
+
+        m_reactor->registrations[token] = entry;
+        m_reactor->tokens[socket]       = token;
+        return true;
+    }
+
+    bool Reactor::Modify(PlatformSocket socket, Reactor::Handler* handler, uint8_t interest) {
+        // Poll masks can't be changed in place, so replace the poll request with one under a new token.
+        Deregister(socket);
+        return Register(socket, handler, interest);
+    }
+
+    void Reactor::Deregister(PlatformSocket socket) {
+        auto it = m_reactor->tokens.find(socket);
+        if(it == m_reactor->tokens.end()) {
+            return;
+        }
+
+        struct io_uring_sqe* sqe = NextSubmission(m_reactor);
+        if(sqe != NULL) {
+            sqe->opcode     = IORING_OP_POLL_REMOVE;
+            sqe->addr       = it->second;
+            sqe->user_data  = 0;
+        }
+
+        m_reactor->registrations.erase(it->second);
+        m_reactor->tokens.erase(it);
+    }
+
+    size_t Reactor::Poll(std::chrono::milliseconds timeout) {
+        struct __kernel_timespec deadline;
+        deadline.tv_sec     = timeout.count() / 1000;
+        deadline.tv_nsec    = (timeout.count() % 1000) * 1000000;
+
+        struct io_uring_getevents_arg argument;
+        memset(&argument, 0, sizeof(argument));
+        argument.ts = reinterpret_cast<uint64_t>(&deadline);
+
+        // Submit every queued registration change and wait for completions in a single system call.
+        bool wait = LoadAcquire(m_reactor->cqTail) == *m_reactor->cqHead && timeout.count() > 0;
+        if(m_reactor->pending > 0 || wait) {
+            // A timeout or signal while waiting is not an error; anything left unsubmitted goes out on the next poll.
+            Submit(m_reactor, wait ? 1 : 0, IORING_ENTER_EXT_ARG | (wait ? IORING_ENTER_GETEVENTS : 0), &argument, sizeof(argument));
+        }
+
+        size_t      dispatched  = 0;
+        unsigned    head        = *m_reactor->cqHead;
+        unsigned    tail        = LoadAcquire(m_reactor->cqTail);
+
+        for(; head != tail; head++) {
+            struct io_uring_cqe cqe = m_reactor->cqes[head & *m_reactor->cqMask];
+            StoreRelease(m_reactor->cqHead, head + 1);
+
+            auto it = m_reactor->registrations.find(cqe.user_data);
+            if(it == m_reactor->registrations.end()) {
+                continue;
+            }
+
+            auto entry = it->second;
+
+            // A failed poll request is reported to the handler as a socket error.
+            int events = cqe.res < 0 ? POLLERR : cqe.res;
+
+            if(events & (POLLOUT | POLLERR | POLLHUP)) {
+                entry.handler->OnWritable();
+            }
+            if(events & (POLLIN | POLLRDHUP | POLLERR | POLLHUP)) {
+                entry.handler->OnReadable();
+            }
+            dispatched++;
+
+            // Keep watching the socket unless a handler deregistered it or replaced its poll request,
+            // including after a failed poll, which would otherwise leave the socket unwatched for good.
+            if(m_reactor->registrations.count(cqe.user_data) > 0) {
+                ArmPoll(m_reactor, entry, cqe.user_data);
+            }
+        }
+
+        return dispatched;
+    }
+
+    Reactor::~Reactor() {
+        if(m_reactor != nullptr) {
+            DestroyRing(m_reactor);
+        }
+    }
+}
+
+#endif // KVM_USE_IO_URING
\ No newline at end of file
@@ -0,0 +1,21 @@
+#include <platform/process.h>
+#include <libproc.h>
+#include <mach/mach_time.h>
+
+namespace kvm {
+    std::optional<std::chrono::microseconds> GetProcessCPUTime(int pid) {
+        struct proc_taskinfo info;
+        if(proc_pidinfo(pid, PROC_PIDTASKINFO, 0, &info, sizeof(info)) != sizeof(info)) {
+            return std::nullopt;
+        }
+
+        // Task times are in Mach absolute time units, which are only nanoseconds on Intel.
+        mach_timebase_info_data_t timebase;
+        if(mach_timebase_info(&timebase) != KERN_SUCCESS || timebase.denom == 0) {
+            return std::nullopt;
+        }
+
+        uint64_t total = info.pti_total_user + info.pti_total_system;
+        return std::chrono::microseconds(total * timebase.numer / timebase.denom / 1000);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,74 @@
+#include <networking/reactor.h>
+#include <sys/event.h>
+#include <unistd.h>
+#include <cerrno>
+
+#define MAX_EVENTS_PER_POLL 64
+
+namespace kvm {
+    Reactor::Reactor() :
+    m_reactor(-1)
+    {}
+
+    bool Reactor::Initialize() {
+        if(m_reactor == -1) {
+            m_reactor = kqueue();
+        }
+        return m_reactor != -1;
+    }
+
+    bool Reactor::Register(PlatformSocket socket, Reactor::Handler* handler, uint8_t interest) {
+        return Modify(socket, handler, interest);
+    }
+
+    bool Reactor::Modify(PlatformSocket socket, Reactor::Handler* handler, uint8_t interest) {
+        struct kevent changes[2];
+        EV_SET(&changes[0], socket, EVFILT_READ, (interest & Reactor::READABLE) ? EV_ADD : EV_DELETE, 0, 0, handler);
+        EV_SET(&changes[1], socket, EVFILT_WRITE, (interest & Reactor::WRITABLE) ? EV_ADD : EV_DELETE, 0, 0, handler);
+
+        // Receipts stop a delete of a filter that was never added from aborting the other change.
+        changes[0].flags |= EV_RECEIPT;
+        changes[1].flags |= EV_RECEIPT;
+
+        struct kevent receipts[2];
+        int count = kevent(m_reactor, changes, 2, receipts, 2, NULL);
+
+        for(int i = 0; i < count; i++) {
+            if((receipts[i].flags & EV_ERROR) && receipts[i].data != 0 && receipts[i].data != ENOENT) {
+                return false;
+            }
+        }
+        return count == 2;
+    }
+
+    void Reactor::Deregister(PlatformSocket socket) {
+        Modify(socket, NULL, 0);
+    }
+
+    size_t Reactor::Poll(std::chrono::milliseconds timeout) {
+        struct kevent   events[MAX_EVENTS_PER_POLL];
+        struct timespec wait;
+        wait.tv_sec     = timeout.count() / 1000;
+        wait.tv_nsec    = (timeout.count() % 1000) * 1000000;
+
+        int count = kevent(m_reactor, NULL, 0, events, MAX_EVENTS_PER_POLL, &wait);
+
+        for(int i = 0; i < count; i++) {
+            auto handler = reinterpret_cast<Reactor::Handler*>(events[i].udata);
+
+            if(events[i].filter == EVFILT_WRITE) {
+                handler->OnWritable();
+            } else {
+                handler->OnReadable();
+            }
+        }
+
+        return count > 0 ? count : 0;
+    }
+
+    Reactor::~Reactor() {
+        if(m_reactor != -1) {
+            close(m_reactor);
+        }
+    }
+}
@@ -0,0 +1,144 @@
+#include <networking/datagram.h>
+#include <netinet/in.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <cerrno>
+
+namespace kvm {
+    const size_t DatagramSocket::MaxPayloadSize = 1400;
+
+    DatagramSocket::DatagramSocket() :
+    m_socket(-1),
+    m_open(false)
+    {}
+
+    bool DatagramSocket::Open(uint16_t port) {
+        Close();
+
+        m_socket = socket(AF_INET, SOCK_DGRAM, 0);
+
+        if(m_socket == -1) {
+            return false;
+        }
+
+        int reuse = 1;
+        setsockopt(m_socket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+        SocketAddress address = {};
+        address.sin_family      = AF_INET;
+        address.sin_addr.s_addr = INADDR_ANY;
+        address.sin_port        = HostToNetwork(port);
+
+        if(bind(m_socket, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) < 0) {
+            close(m_socket);
+            m_socket = -1;
+            return false;
+        }
+
+        m_open = true;
+        return true;
+    }
+
+    bool DatagramSocket::JoinGroup(const SocketAddress& group) {
+        if(!m_open) {
+            return false;
+        }
+
+        struct ip_mreq membership;
+        membership.imr_multiaddr        = group.sin_addr;
+        membership.imr_interface.s_addr = INADDR_ANY;
+
+        uint8_t loop = 0;
+        setsockopt(m_socket, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+
+        return setsockopt(m_socket, IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership, sizeof(membership)) == 0;
+    }
+
+    bool DatagramSocket::EnableBroadcast() {
+        if(!m_open) {
+            return false;
+        }
+
+        int broadcast = 1;
+        return setsockopt(m_socket, SOL_SOCKET, SO_BROADCAST, &broadcast, sizeof(broadcast)) == 0;
+    }
+
+    bool DatagramSocket::SendTo(const SocketAddress& destination, const NetworkBuffer& buffer) {
+        if(!m_open || !buffer || buffer.GetSize() > MaxPayloadSize) {
+            return false;
+        }
+
+        return sendto(m_socket, buffer.GetBuffer(), buffer.GetSize(), 0, reinterpret_cast<const struct sockaddr*>(&destination), sizeof(destination)) == static_cast<ssize_t>(buffer.GetSize());
+    }
+
+    size_t DatagramSocket::SendTo(const std::vector<SocketAddress>& destinations, const NetworkBuffer& buffer) {
+        if(!m_open || !buffer || buffer.GetSize() > MaxPayloadSize || destinations.empty()) {
+            return 0;
+        }
+
+#if defined(KVM_OS_LINUX)
+        struct iovec payload;
+        payload.iov_base    = const_cast<uint8_t*>(buffer.GetBuffer());
+        payload.iov_len     = buffer.GetSize();
+
+        std::vector<struct mmsghdr> messages(destinations.size());
+        for(size_t i = 0; i < destinations.size(); i++) {
+            messages[i].msg_hdr             = {};
+            messages[i].msg_hdr.msg_name    = const_cast<SocketAddress*>(&destinations[i]);
+            messages[i].msg_hdr.msg_namelen = sizeof(SocketAddress);
+            messages[i].msg_hdr.msg_iov     = &payload;
+            messages[i].msg_hdr.msg_iovlen  = 1;
+            messages[i].msg_len             = 0;
+        }
+
+        int sent = sendmmsg(m_socket, messages.data(), messages.size(), 0);
+        return sent > 0 ? sent : 0;
+#else
+        size_t sent = 0;
+        for(auto& destination : destinations) {
+            if(SendTo(destination, buffer)) {
+                sent++;
+            }
+        }
+        return sent;
+#endif
+    }
+
+    bool DatagramSocket::ReceiveFrom(NetworkBuffer& buffer, SocketAddress& sender) {
+        if(!m_open) {
+            return false;
+        }
+
+        socklen_t senderLength = sizeof(sender);
+        buffer.Window(0, 0).Reserve(MaxPayloadSize);
+
+        ssize_t size = recvfrom(m_socket, buffer.GetBuffer(), buffer.GetCapacity(), MSG_DONTWAIT, reinterpret_cast<struct sockaddr*>(&sender), &senderLength);
+
+        if(size <= 0) {
+            return false;
+        }
+
+        buffer.Window(0, size);
+        return true;
+    }
+
+    void DatagramSocket::Close() {
+        if(m_open) {
+            close(m_socket);
+            m_socket    = -1;
+            m_open      = false;
+        }
+    }
+
+    bool DatagramSocket::IsOpen() const {
+        return m_open;
+    }
+
+    PlatformSocket DatagramSocket::GetHandle() const {
+        return m_socket;
+    }
+
+    DatagramSocket::~DatagramSocket() {
+        Close();
+    }
+}
\ No newline at end of file
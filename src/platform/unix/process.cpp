@@ -0,0 +1,30 @@
+#include <platform/process.h>
+#include <sys/resource.h>
+#include <algorithm>
+
+namespace kvm {
+    size_t RaiseOpenFileLimit(size_t count) {
+        struct rlimit limit;
+        if(getrlimit(RLIMIT_NOFILE, &limit) != 0) {
+            return 0;
+        }
+
+        if(limit.rlim_cur == RLIM_INFINITY || limit.rlim_cur >= count) {
+            return limit.rlim_cur == RLIM_INFINITY ? count : limit.rlim_cur;
+        }
+
+        // Only the soft limit can be raised without privileges, and only as far as the hard limit.
+        rlim_t wanted = limit.rlim_max == RLIM_INFINITY ? count : std::min<rlim_t>(count, limit.rlim_max);
+#ifdef OPEN_MAX
+        wanted = std::min<rlim_t>(wanted, OPEN_MAX);
+#endif
+        if(wanted > limit.rlim_cur) {
+            struct rlimit raised = limit;
+            raised.rlim_cur = wanted;
+            if(setrlimit(RLIMIT_NOFILE, &raised) == 0) {
+                return wanted;
+            }
+        }
+        return limit.rlim_cur;
+    }
+}
\ No newline at end of file
@@ -2,21 +2,41 @@
 #include <core/core.h>
 #include <arpa/inet.h>
 #include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <cerrno>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
 
 #define MAX_BACKLOG_LENGTH 64
+#define RECEIVE_CHUNK_SIZE 2048
+#define FAST_OPEN_QUEUE_LENGTH 16
 
 namespace kvm {
     Socket::Socket() :
     m_socket(-1),
-    m_state(Socket::SocketState::DISCONNECTED)
+    m_state(Socket::SocketState::DISCONNECTED),
+    m_receiveFrame(0),
+    m_receiveLength(0)
     {}
 
     Socket::Socket(PlatformSocket socket, SocketAddress address) :
-    m_state(Socket::SocketState::CONNECTED),
     m_socket(socket),
-    m_address(address)
+    m_address(address),
+    m_state(Socket::SocketState::CONNECTED),
+    m_receiveFrame(0),
+    m_receiveLength(0)
     {}
 
+    static void SetNonBlocking(PlatformSocket socket) {
+        fcntl(socket, F_SETFL, fcntl(socket, F_GETFL, 0) | O_NONBLOCK);
+    }
+
     Socket::ConnectResult Socket::Connect(const SocketAddress& address) {
         if(m_state != Socket::SocketState::DISCONNECTED) {
             Disconnect();
@@ -28,11 +48,40 @@ namespace kvm {
             return Socket::ConnectResult(Socket::SocketError::INITIALIZATION_ERROR);
         }
 
-        if(connect(m_socket, reinterpret_cast<const struct sockaddr*>(&address), sizeof(address)) < 0) {
+        SetNonBlocking(m_socket);
+
+#if defined(TCP_FASTOPEN_CONNECT)
+        // With a cached cookie from an earlier connection the handshake is deferred until the first send,
+        // which then travels in the SYN. Without one this is an ordinary connect.
+        int fastOpen = 1;
+        setsockopt(m_socket, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, &fastOpen, sizeof(fastOpen));
+#endif
+
+        if(connect(m_socket, reinterpret_cast<const struct sockaddr*>(&address), sizeof(address)) < 0 && errno != EINPROGRESS) {
+            close(m_socket);
             m_socket = -1;
             return Socket::ConnectResult(Socket::SocketError::CONNECT_ERROR);
         }
 
+        m_state     = Socket::SocketState::CONNECTING;
+        m_address   = address;
+
+        return Socket::ConnectResult();
+    }
+
+    Socket::ConnectResult Socket::CompleteConnect() {
+        if(m_state != Socket::SocketState::CONNECTING) {
+            return Socket::ConnectResult(Socket::SocketError::INITIALIZATION_ERROR);
+        }
+
+        int         error       = 0;
+        socklen_t   errorLength = sizeof(error);
+
+        if(getsockopt(m_socket, SOL_SOCKET, SO_ERROR, &error, &errorLength) < 0 || error != 0) {
+            Disconnect();
+            return Socket::ConnectResult(Socket::SocketError::CONNECT_ERROR);
+        }
+
         m_state = Socket::SocketState::CONNECTED;
 
         return Socket::ConnectResult();
@@ -49,6 +98,14 @@ namespace kvm {
             return Socket::ListenResult(Socket::SocketError::INITIALIZATION_ERROR);
         }
 
+        int reuse = 1;
+        setsockopt(m_socket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+#if defined(TCP_FASTOPEN)
+        int fastOpenQueueLength = FAST_OPEN_QUEUE_LENGTH;
+        setsockopt(m_socket, IPPROTO_TCP, TCP_FASTOPEN, &fastOpenQueueLength, sizeof(fastOpenQueueLength));
+#endif
+
         SocketAddress address;
         address.sin_family      = AF_INET;
         address.sin_addr.s_addr = INADDR_ANY;
@@ -59,6 +116,8 @@ namespace kvm {
             return Socket::ListenResult(Socket::SocketError::BIND_ERROR);
         }
         
+        // Accepting never blocks, so a reactor can drain every waiting connection on one readiness report.
+        SetNonBlocking(m_socket);
         listen(m_socket, MAX_BACKLOG_LENGTH);
 
         m_state = Socket::SocketState::LISTENING;
@@ -67,57 +126,71 @@ namespace kvm {
 
     Socket::AcceptResult Socket::Accept() const {
         if(m_state == Socket::SocketState::LISTENING) {
-            fd_set readSet;
-            struct timeval timeout;
-            FD_ZERO(&readSet);
-            FD_SET(m_socket, &readSet);
-
-            timeout.tv_sec  = 0;
-            timeout.tv_usec = 0;
-
-            if(select(m_socket + 1, &readSet, NULL, NULL, &timeout) > 0) {
-                SocketAddress   clientAddress;
-                socklen_t       clientAddressLength = sizeof(SocketAddress);
-                PlatformSocket  clientSocket = accept(m_socket, (struct sockaddr*) &clientAddress, &clientAddressLength);
-
-                if(clientSocket != -1) {
-                    return Socket::AcceptResult(Socket(clientSocket, clientAddress));
-                }
+            SocketAddress   clientAddress;
+            socklen_t       clientAddressLength = sizeof(SocketAddress);
+            PlatformSocket  clientSocket = accept(m_socket, (struct sockaddr*) &clientAddress, &clientAddressLength);
+
+            if(clientSocket != -1) {
+                SetNonBlocking(clientSocket);
+                return Socket::AcceptResult(Socket(clientSocket, clientAddress));
             }
         }
         return Socket::AcceptResult();
     }
 
-    bool Socket::Send(const NetworkBuffer& buffer) {
-        if(m_state == Socket::SocketState::CONNECTED && buffer.GetOffset() > 0 && buffer) {
-            return send(m_socket, buffer.GetBuffer(), buffer.GetOffset(), 0) > 0;
+    std::optional<size_t> Socket::SendPartial(const NetworkBuffer& buffer, size_t offset) {
+        if(m_state != Socket::SocketState::CONNECTED || buffer.GetSize() == 0 || !buffer || offset >= GetFrameSize(buffer)) {
+            return std::nullopt;
         }
-        return false;
-    }
 
-    bool Socket::Receive(NetworkBuffer& buffer) {
-        if(m_state == Socket::SocketState::CONNECTED) {
-            fd_set readSet;
-            struct timeval timeout;
-            FD_ZERO(&readSet);
-            FD_SET(m_socket, &readSet);
+        uint32_t header = HostToNetwork(static_cast<uint32_t>(buffer.GetSize()));
+
+        struct iovec parts[2];
+        struct msghdr message = {};
+        message.msg_iov = parts;
+
+        if(offset < sizeof(header)) {
+            parts[0].iov_base   = reinterpret_cast<uint8_t*>(&header) + offset;
+            parts[0].iov_len    = sizeof(header) - offset;
+            parts[1].iov_base   = const_cast<uint8_t*>(buffer.GetBuffer());
+            parts[1].iov_len    = buffer.GetSize();
+            message.msg_iovlen  = 2;
+        } else {
+            parts[0].iov_base   = const_cast<uint8_t*>(buffer.GetBuffer()) + (offset - sizeof(header));
+            parts[0].iov_len    = buffer.GetSize() - (offset - sizeof(header));
+            message.msg_iovlen  = 1;
+        }
 
-            timeout.tv_sec  = 0;
-            timeout.tv_usec = 0;
+        ssize_t sent = sendmsg(m_socket, &message, MSG_NOSIGNAL | MSG_DONTWAIT);
 
-            if(select(m_socket + 1, &readSet, NULL, NULL, &timeout) > 0) {
-                uint8_t receiveBuffer[2048];            
-                int receiveSize = recv(m_socket, (char*) receiveBuffer, 2048, 0);
+        if(sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return 0;
+        }
 
-                if(receiveSize == -1) {
-                    m_state = Socket::SocketState::DISCONNECTED;
-                    return false;
-                }
+        if(sent <= 0) {
+            return std::nullopt;
+        }
 
-                buffer.Reset(receiveBuffer, receiveSize);
+        return static_cast<size_t>(sent);
+    }
+
+    bool Socket::Receive() {
+        if(m_state == Socket::SocketState::CONNECTED) {
+            m_receiveBuffer.Window(0, m_receiveLength).Reserve(m_receiveLength + RECEIVE_CHUNK_SIZE);
 
+            ssize_t receiveSize = recv(m_socket, m_receiveBuffer.GetBuffer() + m_receiveLength, m_receiveBuffer.GetCapacity() - m_receiveLength, MSG_DONTWAIT);
+
+            if(receiveSize < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
                 return true;
             }
+
+            if(receiveSize <= 0) {
+                return false;
+            }
+
+            m_receiveLength += receiveSize;
+
+            return IsFrameValid();
         }
         return false;
     }
@@ -128,6 +201,8 @@ namespace kvm {
             m_socket    = -1;
             m_state     = Socket::SocketState::DISCONNECTED;
         }
+        m_receiveFrame  = 0;
+        m_receiveLength = 0;
     }
     
     Socket::GetAddressResult Socket::GetAddressForIP(int ip, uint16_t port) {
@@ -139,28 +214,32 @@ namespace kvm {
         return Socket::GetAddressResult(address);
     }
 
-    Socket::GetAddressResult Socket::GetAddressForHostname(const Socket::HostName& hostname, uint16_t port) {
-        struct hostent*     entry;
-        struct in_addr**    addresses;
+    static Socket::GetAddressResult LookupAddress(const Socket::HostName& hostname, uint16_t port, int flags) {
+        struct addrinfo hints = {};
+        hints.ai_family     = AF_INET;
+        hints.ai_socktype   = SOCK_STREAM;
+        hints.ai_flags      = flags;
 
-        if((entry = gethostbyname(hostname.c_str())) == NULL) {
+        struct addrinfo* results = NULL;
+        if(getaddrinfo(hostname.c_str(), NULL, &hints, &results) != 0 || results == NULL) {
             return Socket::GetAddressResult(Socket::SocketError::DNS_ERROR);
         }
 
-        if(entry->h_length == 0) {
-            return Socket::GetAddressResult(Socket::SocketError::DNS_ERROR);
-        }
-        
-        addresses = reinterpret_cast<struct in_addr**>(entry->h_addr_list);
-
-        struct sockaddr_in address;
-        address.sin_addr.s_addr     = addresses[0]->s_addr;
-        address.sin_family          = AF_INET;
-        address.sin_port            = HostToNetwork(port);
+        SocketAddress address = *reinterpret_cast<struct sockaddr_in*>(results->ai_addr);
+        address.sin_port = HostToNetwork(port);
+        freeaddrinfo(results);
 
         return Socket::GetAddressResult(address);
     }
 
+    Socket::GetAddressResult Socket::GetAddressForHostname(const Socket::HostName& hostname, uint16_t port) {
+        return LookupAddress(hostname, port, 0);
+    }
+
+    Socket::GetAddressResult Socket::ParseAddress(const Socket::HostName& hostname, uint16_t port) {
+        return LookupAddress(hostname, port, AI_NUMERICHOST);
+    }
+
     Socket::~Socket()
     {}
 }
\ No newline at end of file
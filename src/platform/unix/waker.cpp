@@ -0,0 +1,76 @@
+#include <networking/waker.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace kvm {
+    Waker::Waker() :
+    m_reactor(nullptr),
+    m_receiver(-1),
+    m_sender(-1),
+    m_pending(false),
+    m_open(false)
+    {}
+
+    bool Waker::Open(Reactor& reactor) {
+        Close();
+
+        int ends[2];
+        if(pipe(ends) != 0) {
+            return false;
+        }
+
+        for(int end : ends) {
+            fcntl(end, F_SETFL, fcntl(end, F_GETFL) | O_NONBLOCK);
+            fcntl(end, F_SETFD, FD_CLOEXEC);
+        }
+
+        m_receiver  = ends[0];
+        m_sender    = ends[1];
+
+        if(!reactor.Register(m_receiver, this)) {
+            close(m_receiver);
+            close(m_sender);
+            return false;
+        }
+
+        m_reactor   = &reactor;
+        m_open      = true;
+        return true;
+    }
+
+    void Waker::Wake() {
+        if(!m_open || m_pending.exchange(true)) {
+            return;
+        }
+
+        uint8_t signal = 1;
+        if(write(m_sender, &signal, sizeof(signal)) < 0) {
+            // The pipe is full, so the reactor already has a wake to consume.
+        }
+    }
+
+    void Waker::OnReadable() {
+        // Cleared before draining, so a wake that races with this one writes again and isn't lost.
+        m_pending.store(false);
+
+        uint8_t signals[64];
+        while(read(m_receiver, signals, sizeof(signals)) > 0)
+        {}
+    }
+
+    void Waker::Close() {
+        if(!m_open) {
+            return;
+        }
+
+        m_reactor->Deregister(m_receiver);
+        close(m_receiver);
+        close(m_sender);
+        m_reactor   = nullptr;
+        m_open      = false;
+    }
+
+    Waker::~Waker() {
+        Close();
+    }
+}
\ No newline at end of file
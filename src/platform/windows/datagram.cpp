@@ -0,0 +1,129 @@
+#include <networking/datagram.h>
+#include <ws2tcpip.h>
+
+namespace kvm {
+    extern ReferenceCounter<WSAData> PlatformSocketReferences;
+
+    const size_t DatagramSocket::MaxPayloadSize = 1400;
+
+    DatagramSocket::DatagramSocket() :
+    m_open(false) {
+      m_socket.id = INVALID_SOCKET;
+    }
+
+    bool DatagramSocket::Open(uint16_t port) {
+      Close();
+
+      ++PlatformSocketReferences;
+      m_socket.id = socket(AF_INET, SOCK_DGRAM, 0);
+
+      if(m_socket.id == INVALID_SOCKET) {
+        --PlatformSocketReferences;
+        return false;
+      }
+
+      BOOL reuse = TRUE;
+      setsockopt(m_socket.id, SOL_SOCKET, SO_REUSEADDR, (const char*) &reuse, sizeof(reuse));
+
+      // Readiness reports from WSAPoll can be stale, so never let a receive block.
+      u_long nonBlocking = 1;
+      ioctlsocket(m_socket.id, FIONBIO, &nonBlocking);
+
+      SocketAddress address = {};
+      address.sin_family            = AF_INET;
+      address.sin_addr.S_un.S_addr  = INADDR_ANY;
+      address.sin_port              = HostToNetwork(port);
+
+      if(bind(m_socket.id, (struct sockaddr*) &address, sizeof(address)) == SOCKET_ERROR) {
+        --PlatformSocketReferences;
+        closesocket(m_socket.id);
+        m_socket.id = INVALID_SOCKET;
+        return false;
+      }
+
+      m_open = true;
+      return true;
+    }
+
+    bool DatagramSocket::JoinGroup(const SocketAddress& group) {
+      if(!m_open) {
+        return false;
+      }
+
+      struct ip_mreq membership;
+      membership.imr_multiaddr                = group.sin_addr;
+      membership.imr_interface.S_un.S_addr    = INADDR_ANY;
+
+      DWORD loop = 0;
+      setsockopt(m_socket.id, IPPROTO_IP, IP_MULTICAST_LOOP, (const char*) &loop, sizeof(loop));
+
+      return setsockopt(m_socket.id, IPPROTO_IP, IP_ADD_MEMBERSHIP, (const char*) &membership, sizeof(membership)) == 0;
+    }
+
+    bool DatagramSocket::EnableBroadcast() {
+      if(!m_open) {
+        return false;
+      }
+
+      BOOL broadcast = TRUE;
+      return setsockopt(m_socket.id, SOL_SOCKET, SO_BROADCAST, (const char*) &broadcast, sizeof(broadcast)) == 0;
+    }
+
+    bool DatagramSocket::SendTo(const SocketAddress& destination, const NetworkBuffer& buffer) {
+      if(!m_open || !buffer || buffer.GetSize() > MaxPayloadSize) {
+        return false;
+      }
+
+      int size = static_cast<int>(buffer.GetSize());
+      return sendto(m_socket.id, (const char*) buffer.GetBuffer(), size, 0, (const struct sockaddr*) &destination, sizeof(destination)) == size;
+    }
+
+    size_t DatagramSocket::SendTo(const std::vector<SocketAddress>& destinations, const NetworkBuffer& buffer) {
+      size_t sent = 0;
+      for(auto& destination : destinations) {
+        if(SendTo(destination, buffer)) {
+          sent++;
+        }
+      }
+      return sent;
+    }
+
+    bool DatagramSocket::ReceiveFrom(NetworkBuffer& buffer, SocketAddress& sender) {
+      if(!m_open) {
+        return false;
+      }
+
+      int senderLength = sizeof(sender);
+      buffer.Window(0, 0).Reserve(MaxPayloadSize);
+
+      int size = recvfrom(m_socket.id, (char*) buffer.GetBuffer(), static_cast<int>(buffer.GetCapacity()), 0, (struct sockaddr*) &sender, &senderLength);
+
+      if(size == SOCKET_ERROR || size == 0) {
+        return false;
+      }
+
+      buffer.Window(0, size);
+      return true;
+    }
+
+    void DatagramSocket::Close() {
+      if(m_open) {
+        --PlatformSocketReferences;
+        closesocket(m_socket.id);
+        m_socket.id = INVALID_SOCKET;
+        m_open      = false;
+      }
+    }
+
+    bool DatagramSocket::IsOpen() const {
+      return m_open;
+    }
+
+    PlatformSocket DatagramSocket::GetHandle() const {
+      return m_socket;
+    }
+
+    DatagramSocket::~DatagramSocket() {
+      Close();
+    }
+}
\ No newline at end of file
@@ -0,0 +1,31 @@
+#include <platform/process.h>
+#include <Windows.h>
+
+namespace kvm {
+    std::optional<std::chrono::microseconds> GetProcessCPUTime(int pid) {
+        HANDLE process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, static_cast<DWORD>(pid));
+        if(process == NULL) {
+            return std::nullopt;
+        }
+
+        FILETIME created, exited, kernel, user;
+        BOOL succeeded = GetProcessTimes(process, &created, &exited, &kernel, &user);
+        CloseHandle(process);
+        if(!succeeded) {
+            return std::nullopt;
+        }
+
+        // Process times are counted in 100 nanosecond intervals.
+        ULARGE_INTEGER kernelTime, userTime;
+        kernelTime.LowPart  = kernel.dwLowDateTime;
+        kernelTime.HighPart = kernel.dwHighDateTime;
+        userTime.LowPart    = user.dwLowDateTime;
+        userTime.HighPart   = user.dwHighDateTime;
+        return std::chrono::microseconds((kernelTime.QuadPart + userTime.QuadPart) / 10);
+    }
+
+    size_t RaiseOpenFileLimit(size_t count) {
+        // Windows doesn't cap the number of sockets a process may open.
+        return count;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,86 @@
+#include <networking/reactor.h>
+
+namespace kvm {
+    Reactor::Reactor()
+    {}
+
+    bool Reactor::Initialize() {
+      return true;
+    }
+
+    static SHORT ToPollEvents(uint8_t interest) {
+      SHORT events = 0;
+      if(interest & Reactor::READABLE) {
+        events |= POLLRDNORM;
+      }
+      if(interest & Reactor::WRITABLE) {
+        events |= POLLWRNORM;
+      }
+      return events;
+    }
+
+    bool Reactor::Register(PlatformSocket socket, Reactor::Handler* handler, uint8_t interest) {
+      WSAPOLLFD descriptor;
+      descriptor.fd       = socket.id;
+      descriptor.events   = ToPollEvents(interest);
+      descriptor.revents  = 0;
+
+      m_reactor.descriptors.push_back(descriptor);
+      m_reactor.handlers.push_back(handler);
+      return true;
+    }
+
+    bool Reactor::Modify(PlatformSocket socket, Reactor::Handler* handler, uint8_t interest) {
+      for(size_t i = 0; i < m_reactor.descriptors.size(); i++) {
+        if(m_reactor.descriptors[i].fd == socket.id) {
+          m_reactor.descriptors[i].events = ToPollEvents(interest);
+          m_reactor.handlers[i]           = handler;
+          return true;
+        }
+      }
+      return false;
+    }
+
+    void Reactor::Deregister(PlatformSocket socket) {
+      for(size_t i = 0; i < m_reactor.descriptors.size(); i++) {
+        if(m_reactor.descriptors[i].fd == socket.id) {
+          m_reactor.descriptors.erase(m_reactor.descriptors.begin() + i);
+          m_reactor.handlers.erase(m_reactor.handlers.begin() + i);
+          return;
+        }
+      }
+    }
+
+    size_t Reactor::Poll(std::chrono::milliseconds timeout) {
+      if(m_reactor.descriptors.empty()) {
+        Sleep(static_cast<DWORD>(timeout.count()));
+        return 0;
+      }
+
+      if(WSAPoll(m_reactor.descriptors.data(), static_cast<ULONG>(m_reactor.descriptors.size()), static_cast<INT>(timeout.count())) <= 0) {
+        return 0;
+      }
+
+      // Handlers may register or deregister sockets, so collect ready handlers before dispatching.
+      std::vector<std::pair<Reactor::Handler*, SHORT>> ready;
+      for(size_t i = 0; i < m_reactor.descriptors.size(); i++) {
+        if(m_reactor.descriptors[i].revents != 0) {
+          ready.push_back(std::make_pair(reinterpret_cast<Reactor::Handler*>(m_reactor.handlers[i]), m_reactor.descriptors[i].revents));
+        }
+      }
+
+      for(auto& event : ready) {
+        if(event.second & (POLLWRNORM | POLLERR | POLLHUP)) {
+          event.first->OnWritable();
+        }
+        if(event.second & (POLLRDNORM | POLLERR | POLLHUP)) {
+          event.first->OnReadable();
+        }
+      }
+
+      return ready.size();
+    }
+
+    Reactor::~Reactor()
+    {}
+}
\ No newline at end of file
@@ -1,4 +1,8 @@
 #include <networking/socket.h>
+#include <ws2tcpip.h>
+
+#define RECEIVE_CHUNK_SIZE 2048
+#define FAST_OPEN_QUEUE_LENGTH 16
 
 namespace kvm {
     ReferenceCounter<WSAData> PlatformSocketReferences(
@@ -14,16 +18,25 @@ namespace kvm {
     );
 
     Socket::Socket() :
-    m_state(Socket::SocketState::DISCONNECTED) {
+    m_state(Socket::SocketState::DISCONNECTED),
+    m_receiveFrame(0),
+    m_receiveLength(0) {
       m_socket.id = INVALID_SOCKET;
     }
 
     Socket::Socket(PlatformSocket socket, SocketAddress address) :
-    m_state(Socket::SocketState::CONNECTED),
     m_socket(socket),
-    m_address(address)
+    m_address(address),
+    m_state(Socket::SocketState::CONNECTED),
+    m_receiveFrame(0),
+    m_receiveLength(0)
     {}
 
+    static void SetNonBlocking(SOCKET socket) {
+      u_long nonBlocking = 1;
+      ioctlsocket(socket, FIONBIO, &nonBlocking);
+    }
+
     Socket::ConnectResult Socket::Connect(const SocketAddress& address) {
       if(m_state != Socket::SocketState::DISCONNECTED) {
         return Socket::ConnectResult(Socket::SocketError::INITIALIZATION_ERROR);
@@ -41,16 +54,37 @@ namespace kvm {
         return Connect(address);
       }
 
-      if(connect(m_socket.id, (struct sockaddr*) &address, sizeof(address)) < 0) {
+      SetNonBlocking(m_socket.id);
+
+      if(connect(m_socket.id, (struct sockaddr*) &address, sizeof(address)) == SOCKET_ERROR && WSAGetLastError() != WSAEWOULDBLOCK) {
+        Disconnect();
         return Socket::ConnectResult(Socket::SocketError::CONNECT_ERROR);
       }
 
-      m_state   = Socket::SocketState::CONNECTED;
+      m_state   = Socket::SocketState::CONNECTING;
       m_address = address;
 
       return Socket::ConnectResult();
     }
 
+    Socket::ConnectResult Socket::CompleteConnect() {
+      if(m_state != Socket::SocketState::CONNECTING) {
+        return Socket::ConnectResult(Socket::SocketError::INITIALIZATION_ERROR);
+      }
+
+      int error       = 0;
+      int errorLength = sizeof(error);
+
+      if(getsockopt(m_socket.id, SOL_SOCKET, SO_ERROR, (char*) &error, &errorLength) == SOCKET_ERROR || error != 0) {
+        Disconnect();
+        return Socket::ConnectResult(Socket::SocketError::CONNECT_ERROR);
+      }
+
+      m_state = Socket::SocketState::CONNECTED;
+
+      return Socket::ConnectResult();
+    }
+
     Socket::ListenResult Socket::Listen(uint16_t port) {
       SocketAddress address;
       address.sin_family            = AF_INET;
@@ -69,10 +103,19 @@ namespace kvm {
         return Listen(port);
       }
 
+      BOOL reuse = TRUE;
+      setsockopt(m_socket.id, SOL_SOCKET, SO_REUSEADDR, (const char*) &reuse, sizeof(reuse));
+
+#if defined(TCP_FASTOPEN)
+      DWORD fastOpen = TRUE;
+      setsockopt(m_socket.id, IPPROTO_TCP, TCP_FASTOPEN, (const char*) &fastOpen, sizeof(fastOpen));
+#endif
+
       if(bind(m_socket.id, (struct sockaddr*) &address, sizeof(address)) == SOCKET_ERROR) {
         return Socket::ListenResult(Socket::SocketError::BIND_ERROR);
       }
 
+      SetNonBlocking(m_socket.id);
       listen(m_socket.id, 10);
 
       m_state     = Socket::SocketState::LISTENING;
@@ -83,78 +126,86 @@ namespace kvm {
 
     Socket::AcceptResult Socket::Accept() const {
       if(m_state == Socket::SocketState::LISTENING) {
-        fd_set          readSet;
         SOCKET          client;
         SocketAddress   address;
         int             addressSize = sizeof(struct sockaddr_in);
-        struct timeval  waitFor{0, 0};
 
-        FD_ZERO(&readSet);
-        FD_SET(m_socket.id, &readSet);
-
-        if(select(0, &readSet, NULL, NULL, &waitFor) == SOCKET_ERROR) {
-          return Socket::AcceptResult();
-        }
-
-        if(FD_ISSET(m_socket.id, &readSet)) {
-          ++PlatformSocketReferences;
-          client = accept(m_socket.id, (struct sockaddr*) &address, &addressSize);
+        ++PlatformSocketReferences;
+        client = accept(m_socket.id, (struct sockaddr*) &address, &addressSize);
 
-          if(client != INVALID_SOCKET) {
-            PlatformSocket newSocket;
-            newSocket.id = client;
-            return Socket::AcceptResult(Socket(newSocket, address));
-          }
+        if(client != INVALID_SOCKET) {
+          SetNonBlocking(client);
+          PlatformSocket newSocket;
+          newSocket.id = client;
+          return Socket::AcceptResult(Socket(newSocket, address));
         }
+        --PlatformSocketReferences;
       }
 
       return Socket::AcceptResult();
     }
 
     void Socket::Disconnect() {
-      --PlatformSocketReferences;
-      closesocket(m_socket.id);
-      m_socket.id = INVALID_SOCKET;
+      if(m_socket.id != INVALID_SOCKET) {
+        --PlatformSocketReferences;
+        closesocket(m_socket.id);
+        m_socket.id = INVALID_SOCKET;
+      }
+      m_state         = Socket::SocketState::DISCONNECTED;
+      m_receiveFrame  = 0;
+      m_receiveLength = 0;
     }
 
-    bool Socket::Send(const NetworkBuffer& buffer) {
-      if(m_state == Socket::SocketState::CONNECTED && buffer.GetOffset() > 0 && buffer.GetState() == NetworkBuffer::State::OK) {
-        auto result = send(m_socket.id, (char*) buffer.GetBuffer(), buffer.GetOffset(), 0);
-        if(result >= 0) {
-          return true;
-        } else {
-          auto error = WSAGetLastError();
-          m_state = Socket::SocketState::DISCONNECTED;
+    std::optional<size_t> Socket::SendPartial(const NetworkBuffer& buffer, size_t offset) {
+      if(m_state != Socket::SocketState::CONNECTED || buffer.GetSize() == 0 || buffer.GetState() != NetworkBuffer::State::OK || offset >= GetFrameSize(buffer)) {
+        return std::nullopt;
+      }
+
+      uint32_t  header = HostToNetwork(static_cast<uint32_t>(buffer.GetSize()));
+      WSABUF    parts[2];
+      DWORD     count;
+      DWORD     sent;
+
+      if(offset < sizeof(header)) {
+        parts[0].buf = (char*) &header + offset;
+        parts[0].len = static_cast<ULONG>(sizeof(header) - offset);
+        parts[1].buf = (char*) buffer.GetBuffer();
+        parts[1].len = static_cast<ULONG>(buffer.GetSize());
+        count        = 2;
+      } else {
+        parts[0].buf = (char*) buffer.GetBuffer() + (offset - sizeof(header));
+        parts[0].len = static_cast<ULONG>(buffer.GetSize() - (offset - sizeof(header)));
+        count        = 1;
+      }
+
+      if(WSASend(m_socket.id, parts, count, &sent, 0, NULL, NULL) == SOCKET_ERROR) {
+        if(WSAGetLastError() == WSAEWOULDBLOCK) {
+          return 0;
         }
+        return std::nullopt;
       }
-      return false;
+
+      return static_cast<size_t>(sent);
     }
 
-    bool Socket::Receive(NetworkBuffer& buffer) {
+    bool Socket::Receive() {
       if(m_state == Socket::SocketState::CONNECTED) {
-        fd_set          readSet;
-        struct timeval  waitFor{0, 0};
-        
-        FD_ZERO(&readSet);
-        FD_SET(m_socket.id, &readSet);
-        
-        if(select(0, &readSet, NULL, NULL, &waitFor) == SOCKET_ERROR) {
-          return false;
-        }
-      
-        if(FD_ISSET(m_socket.id, &readSet)) {
-          uint8_t receiveBuffer[2048];
-          int receiveSize = recv(m_socket.id, (char*) receiveBuffer, 2048, 0);
-
-          if(receiveSize == SOCKET_ERROR) {
-            m_state = Socket::SocketState::DISCONNECTED;
-            return false;
-          }
+        m_receiveBuffer.Window(0, m_receiveLength).Reserve(m_receiveLength + RECEIVE_CHUNK_SIZE);
 
-          buffer.Reset(receiveBuffer, receiveSize);
+        int available   = static_cast<int>(m_receiveBuffer.GetCapacity() - m_receiveLength);
+        int receiveSize = recv(m_socket.id, (char*) m_receiveBuffer.GetBuffer() + m_receiveLength, available, 0);
 
+        if(receiveSize == SOCKET_ERROR && WSAGetLastError() == WSAEWOULDBLOCK) {
           return true;
         }
+
+        if(receiveSize == SOCKET_ERROR || receiveSize == 0) {
+          return false;
+        }
+
+        m_receiveLength += receiveSize;
+
+        return IsFrameValid();
       }
       return false;
     }
@@ -169,26 +220,35 @@ namespace kvm {
       return Socket::GetAddressResult(address);
     }
 
-    Socket::GetAddressResult Socket::GetAddressForHostname(const HostName& hostname, uint16_t port) {
-      struct hostent*   hostEntry;
-      struct in_addr**  addressList;
+    static Socket::GetAddressResult LookupAddress(const Socket::HostName& hostname, uint16_t port, int flags) {
+      struct addrinfo hints = {};
+      hints.ai_family     = AF_INET;
+      hints.ai_socktype   = SOCK_STREAM;
+      hints.ai_flags      = flags;
+
+      // Winsock must be started for lookups to work, even if no socket is open yet.
+      ++PlatformSocketReferences;
 
-      if((hostEntry = gethostbyname(hostname.c_str())) == NULL) {
+      struct addrinfo* results = NULL;
+      if(getaddrinfo(hostname.c_str(), NULL, &hints, &results) != 0 || results == NULL) {
+        --PlatformSocketReferences;
         return Socket::GetAddressResult(Socket::SocketError::DNS_ERROR);
       }
 
-      addressList = (struct in_addr**) hostEntry->h_addr_list;
+      SocketAddress address = *(struct sockaddr_in*) results->ai_addr;
+      address.sin_port = HostToNetwork(port);
+      freeaddrinfo(results);
 
-      if(addressList[0] != NULL) {
-        SocketAddress address;
-        address.sin_family  = AF_INET;
-        address.sin_addr    = *addressList[0];
-        address.sin_port    = HostToNetwork(port);
+      --PlatformSocketReferences;
+      return Socket::GetAddressResult(address);
+    }
 
-        return Socket::GetAddressResult(address);
-      }
+    Socket::GetAddressResult Socket::GetAddressForHostname(const HostName& hostname, uint16_t port) {
+      return LookupAddress(hostname, port, 0);
+    }
 
-      return Socket::GetAddressResult(Socket::SocketError::DNS_ERROR);
+    Socket::GetAddressResult Socket::ParseAddress(const HostName& hostname, uint16_t port) {
+      return LookupAddress(hostname, port, AI_NUMERICHOST);
     }
 
     bool Socket::operator==(const Socket& other) const {
@@ -0,0 +1,93 @@
+#include <networking/waker.h>
+#include <ws2tcpip.h>
+
+namespace kvm {
+    extern ReferenceCounter<WSAData> PlatformSocketReferences;
+
+    Waker::Waker() :
+    m_reactor(nullptr),
+    m_pending(false),
+    m_open(false) {
+      m_receiver.id = INVALID_SOCKET;
+      m_sender.id   = INVALID_SOCKET;
+    }
+
+    bool Waker::Open(Reactor& reactor) {
+      Close();
+
+      // Windows has no pipes that WSAPoll can watch, so wakes are datagrams that a loopback socket sends
+      // to itself.
+      ++PlatformSocketReferences;
+      SOCKET channel = socket(AF_INET, SOCK_DGRAM, 0);
+      if(channel == INVALID_SOCKET) {
+        --PlatformSocketReferences;
+        return false;
+      }
+
+      u_long nonBlocking = 1;
+      ioctlsocket(channel, FIONBIO, &nonBlocking);
+
+      SocketAddress address = {};
+      address.sin_family            = AF_INET;
+      address.sin_addr.S_un.S_addr  = htonl(INADDR_LOOPBACK);
+      address.sin_port              = 0;
+
+      int length = sizeof(address);
+      if( bind(channel, (struct sockaddr*) &address, sizeof(address)) == SOCKET_ERROR ||
+          getsockname(channel, (struct sockaddr*) &address, &length) == SOCKET_ERROR ||
+          connect(channel, (struct sockaddr*) &address, sizeof(address)) == SOCKET_ERROR) {
+        closesocket(channel);
+        --PlatformSocketReferences;
+        return false;
+      }
+
+      m_receiver.id = channel;
+      m_sender.id   = channel;
+
+      if(!reactor.Register(m_receiver, this)) {
+        closesocket(channel);
+        --PlatformSocketReferences;
+        return false;
+      }
+
+      m_reactor = &reactor;
+      m_open    = true;
+      return true;
+    }
+
+    void Waker::Wake() {
+      if(!m_open || m_pending.exchange(true)) {
+        return;
+      }
+
+      char signal = 1;
+      send(m_sender.id, &signal, sizeof(signal), 0);
+    }
+
+    void Waker::OnReadable() {
+      // Cleared before draining, so a wake that races with this one sends again and isn't lost.
+      m_pending.store(false);
+
+      char signals[64];
+      while(recv(m_receiver.id, signals, sizeof(signals), 0) > 0)
+      {}
+    }
+
+    void Waker::Close() {
+      if(!m_open) {
+        return;
+      }
+
+      m_reactor->Deregister(m_receiver);
+      closesocket(m_receiver.id);
+      --PlatformSocketReferences;
+      m_receiver.id = INVALID_SOCKET;
+      m_sender.id   = INVALID_SOCKET;
+      m_reactor     = nullptr;
+      m_open        = false;
+    }
+
+    Waker::~Waker() {
+      Close();
+    }
+}
\ No newline at end of file
@@ -0,0 +1,407 @@
+#include <iostream>
+#include <iomanip>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <cstring>
+#include <core/histogram.h>
+#include <core/time.h>
+#include <networking/node.h>
+#include <networking/reactor.h>
+#include <networking/message/registry.h>
+#include <platform/process.h>
+
+/**
+ * Drives a running kvm daemon with many simulated peers, to find how many peers and requests per second
+ * it can serve before Cluster::Pump falls behind. Peers connect to the daemon's listen port at a fixed
+ * rate, heartbeat it like any other node and share a stream of input change requests between them. Each
+ * report covers the interval since the last: how long the daemon took to accept and greet new peers,
+ * how long it took to answer requests, and how much CPU it used if its process ID was given.
+ */
+
+const std::chrono::milliseconds MaxPollWait(1);
+/// Requests unanswered for this long are counted as lost
+const std::chrono::seconds RequestTimeout(5);
+
+typedef struct {
+  std::string                             hostname;
+  uint16_t                                port;
+  int                                     peers;
+  double                                  connectRate;
+  double                                  requestRate;
+  std::chrono::milliseconds               heartbeatInterval;
+  std::vector<kvm::Display::SerialNumber> displays;
+  double                                  duration;
+  double                                  reportInterval;
+  int                                     pid;
+} Options;
+
+bool ParseOptions(int argc, char** argv, Options& options) {
+  options.port              = 10191;
+  options.peers             = 1000;
+  options.connectRate       = 200;
+  options.requestRate       = 100;
+  options.heartbeatInterval = kvm::FailureDetector::Settings().heartbeatInterval;
+  options.duration          = 30;
+  options.reportInterval    = 1;
+  options.pid               = 0;
+
+  for(int i = 1; i != argc; i++) {
+    if(strcmp(argv[i], "--port") == 0 && (i + 1) < argc) {
+      options.port = atoi(argv[++i]);
+    } else if(strcmp(argv[i], "--peers") == 0 && (i + 1) < argc) {
+      options.peers = atoi(argv[++i]);
+    } else if(strcmp(argv[i], "--connect-rate") == 0 && (i + 1) < argc) {
+      options.connectRate = atof(argv[++i]);
+    } else if(strcmp(argv[i], "--request-rate") == 0 && (i + 1) < argc) {
+      options.requestRate = atof(argv[++i]);
+    } else if(strcmp(argv[i], "--heartbeat-interval") == 0 && (i + 1) < argc) {
+      options.heartbeatInterval = std::chrono::milliseconds(atoi(argv[++i]));
+    } else if(strcmp(argv[i], "--display") == 0 && (i + 1) < argc) {
+      options.displays.push_back(strtoul(argv[++i], nullptr, 10));
+    } else if(strcmp(argv[i], "--duration") == 0 && (i + 1) < argc) {
+      options.duration = atof(argv[++i]);
+    } else if(strcmp(argv[i], "--report-interval") == 0 && (i + 1) < argc) {
+      options.reportInterval = atof(argv[++i]);
+    } else if(strcmp(argv[i], "--pid") == 0 && (i + 1) < argc) {
+      options.pid = atoi(argv[++i]);
+    } else if(argv[i][0] != '-' && options.hostname.empty()) {
+      options.hostname = argv[i];
+    } else {
+      std::cerr << "Unknown option " << argv[i] << std::endl;
+      return false;
+    }
+  }
+
+  if(options.hostname.empty() || options.peers < 1 || options.connectRate <= 0 || options.requestRate < 0 || options.reportInterval <= 0) {
+    std::cerr << "Usage: " << argv[0] << " <daemon host> [--port port] [--peers count] [--connect-rate peers/s] [--request-rate requests/s] "
+                 "[--heartbeat-interval ms] [--display serial]... [--duration s] [--report-interval s] [--pid daemon pid]" << std::endl;
+    return false;
+  }
+
+  // Requests name a display the daemon doesn't have unless told otherwise, so that it does all the work
+  // of handling them without switching any real monitor.
+  if(options.displays.empty()) {
+    options.displays.push_back(0xFFFFFFFF);
+  }
+  return true;
+}
+
+/**
+ * Owns the simulated peers and measures the daemon's responses to them.
+ */
+class LoadGenerator : public kvm::Node::Listener {
+public:
+
+  LoadGenerator(const Options& options) :
+  m_options(options),
+  m_nextPeer(0),
+  m_nextRequest(1),
+  m_identified(0)
+  {}
+
+  bool Initialize() {
+    return m_reactor.Initialize();
+  }
+
+  /**
+   * Start connecting another peer to the daemon.
+   */
+  void AddPeer() {
+    auto peer = std::make_unique<Peer>();
+    peer->node        = std::make_unique<kvm::Node>(m_options.hostname, m_options.port);
+    peer->added       = kvm::Clock::now();
+    peer->greeted     = false;
+    peer->identified  = false;
+
+    kvm::FailureDetector::Settings settings;
+    settings.heartbeatInterval = m_options.heartbeatInterval;
+
+    peer->node->SetLocalIdentity(&peer->identity);
+    peer->node->SetFailureDetection(settings);
+    peer->node->SetReactor(&m_reactor);
+    peer->node->AddListener(this);
+
+    m_peers.emplace(peer->node.get(), m_order.size());
+    m_order.push_back(std::move(peer));
+  }
+
+  size_t GetPeerCount() const {
+    return m_order.size();
+  }
+
+  size_t GetIdentifiedCount() const {
+    return m_identified;
+  }
+
+  /**
+   * Send an input change request from the next peer that the daemon has greeted. Returns false if no
+   * peer could send it.
+   */
+  bool SendRequest() {
+    kvm::Display::InputMap changes;
+    for(auto serial : m_options.displays) {
+      changes[kvm::Display(serial)] = kvm::Display::Input::HDMI1;
+    }
+
+    kvm::ChangeInputRequest request(m_nextRequest, changes);
+    kvm::NetworkBuffer buffer;
+    if(!request.Serialize(buffer)) {
+      return false;
+    }
+
+    for(size_t tried = 0; tried < m_order.size(); tried++) {
+      auto& peer = *m_order[m_nextPeer];
+      m_nextPeer = (m_nextPeer + 1) % m_order.size();
+
+      if(peer.node->IsIdentified() && peer.node->Send(buffer)) {
+        m_outstanding.emplace(m_nextRequest++, kvm::Clock::now());
+        requestsSent++;
+        return true;
+      }
+    }
+
+    requestsUnsent++;
+    return false;
+  }
+
+  /**
+   * Watch for traffic for up to the given time, then pump every peer.
+   */
+  void Pump(std::chrono::milliseconds timeout) {
+    m_reactor.Poll(timeout);
+    for(auto &peer : m_order) {
+      peer->node->Pump();
+    }
+  }
+
+  /**
+   * Count requests that have gone unanswered for too long as lost, and get the number still waiting.
+   */
+  size_t ExpireRequests() {
+    auto now = kvm::Clock::now();
+    for(auto it = m_outstanding.begin(); it != m_outstanding.end();) {
+      if(now - it->second >= RequestTimeout) {
+        it = m_outstanding.erase(it);
+        requestsLost++;
+      } else {
+        ++it;
+      }
+    }
+    return m_outstanding.size();
+  }
+
+  /**
+   * Get the heartbeat round-trip times measured across every peer, in microseconds.
+   */
+  kvm::Histogram GetRoundTripTimes() const {
+    kvm::Histogram merged;
+    for(auto &peer : m_order) {
+      auto statistics = peer->node->GetStatistics();
+      if(statistics.roundTripTime.GetCount() > 0) {
+        merged.Record(statistics.roundTripTime.GetPercentile(50));
+      }
+    }
+    return merged;
+  }
+
+  virtual void OnNodeIdentified(kvm::Node& node) override {
+    auto& peer = *m_order[m_peers.at(&node)];
+    if(!peer.greeted) {
+      peer.greeted = true;
+      acceptLatency.Record(std::chrono::duration_cast<std::chrono::microseconds>(kvm::Clock::now() - peer.added).count());
+    }
+
+    if(!peer.identified) {
+      peer.identified = true;
+      m_identified++;
+    }
+  }
+
+  virtual void OnNodeDisconnected(const kvm::Node& node) override {
+    auto& peer = *m_order[m_peers.at(&node)];
+    if(peer.identified) {
+      peer.identified = false;
+      m_identified--;
+      disconnects++;
+    }
+  }
+
+  virtual void OnMessageReceived(kvm::Node& sender, kvm::NetworkBuffer& buffer) override {
+    kvm::MessageDispatcher<LoadGenerator, kvm::NetworkMessageType::CHANGE_INPUT_RESPONSE>::Dispatch(buffer, *this);
+  }
+
+  /// Time from a peer being added to the daemon's hello arriving, in microseconds
+  kvm::Histogram acceptLatency;
+  /// Time from a request being sent to its response arriving, in microseconds
+  kvm::Histogram responseLatency;
+  uint64_t requestsSent = 0;
+  uint64_t requestsUnsent = 0;
+  uint64_t requestsLost = 0;
+  uint64_t responses = 0;
+  uint64_t disconnects = 0;
+
+private:
+
+  template<typename, kvm::NetworkMessageType...> friend class kvm::MessageDispatcher;
+
+  void OnMessage(const kvm::ChangeInputResponse& response) {
+    auto sent = m_outstanding.find(response.GetRequestId());
+    if(sent == m_outstanding.end()) {
+      return;
+    }
+
+    responseLatency.Record(std::chrono::duration_cast<std::chrono::microseconds>(kvm::Clock::now() - sent->second).count());
+    m_outstanding.erase(sent);
+    responses++;
+  }
+
+  /**
+   * A simulated peer, with its own identity so that the daemon doesn't mistake it for a duplicate
+   * connection from another.
+   */
+  struct Peer {
+    kvm::NodeIdentity             identity;
+    std::unique_ptr<kvm::Node>    node;
+    kvm::Clock::time_point        added;
+    /// Whether the daemon has greeted this peer since it was added
+    bool                          greeted;
+    /// Whether the daemon has greeted this peer on its current connection
+    bool                          identified;
+  };
+
+  /// Settings
+  const Options& m_options;
+  /// Watches every peer's socket
+  kvm::Reactor m_reactor;
+  /// Peers, in the order they were added
+  std::vector<std::unique_ptr<Peer>> m_order;
+  /// Index of each peer's node in m_order
+  std::unordered_map<const kvm::Node*, size_t> m_peers;
+  /// Peer that sends the next request
+  size_t m_nextPeer;
+  /// ID of the next request
+  kvm::ChangeInputRequest::RequestId m_nextRequest;
+  /// Send time of each request still awaiting a response
+  std::unordered_map<kvm::ChangeInputRequest::RequestId, kvm::Clock::time_point> m_outstanding;
+  /// Number of peers currently connected and greeted
+  size_t m_identified;
+};
+
+int main(int argc, char** argv) {
+  Options options;
+  if(!ParseOptions(argc, argv, options)) {
+    return EXIT_FAILURE;
+  }
+
+  // Each peer holds a socket, plus a few for the reactor and standard streams.
+  auto limit = kvm::RaiseOpenFileLimit(options.peers + 64);
+  if(limit < static_cast<size_t>(options.peers) + 16) {
+    std::cerr << "Only " << limit << " files may be open at once, which isn't enough for " << options.peers << " Peers" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  LoadGenerator generator(options);
+  if(!generator.Initialize()) {
+    std::cerr << "Failed to initialize reactor" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  typedef std::chrono::duration<double> Seconds;
+  auto started      = kvm::Clock::now();
+  auto end          = started + std::chrono::duration_cast<kvm::Clock::duration>(Seconds(options.duration));
+  auto interval     = std::chrono::duration_cast<kvm::Clock::duration>(Seconds(options.reportInterval));
+  auto nextReport   = started + interval;
+  auto lastReport   = started;
+  uint64_t requests = 0, responses = 0, lost = 0, disconnects = 0;
+
+  // Peak rate the daemon kept up with: answered as many requests as were sent in an interval and lost none.
+  double sustainedRate = 0;
+
+  std::optional<std::chrono::microseconds> daemonCPU;
+  if(options.pid) {
+    daemonCPU = kvm::GetProcessCPUTime(options.pid);
+    if(!daemonCPU) {
+      std::cerr << "Can't read the CPU time of process " << options.pid << "; daemon CPU won't be reported" << std::endl;
+    }
+  }
+
+  std::cout << std::fixed << std::setprecision(1);
+  std::cout << "Time(s)  Peers  Greeted  Accept p50/p99(ms)  Sent/s  Answered/s  Response p50/p99/max(ms)  Waiting  Lost  Drops  Daemon CPU" << std::endl;
+
+  while(true) {
+    auto now = kvm::Clock::now();
+    if(now >= end) {
+      break;
+    }
+
+    auto elapsed = std::chrono::duration_cast<Seconds>(now - started).count();
+
+    auto dueConnects = std::min(static_cast<size_t>(options.peers), static_cast<size_t>(elapsed * options.connectRate) + 1);
+    while(generator.GetPeerCount() < dueConnects) {
+      generator.AddPeer();
+    }
+
+    // Requests fall behind schedule rather than bunching up while no peer has been greeted yet.
+    auto dueRequests = static_cast<uint64_t>(elapsed * options.requestRate);
+    while(generator.requestsSent + generator.requestsUnsent < dueRequests) {
+      if(!generator.SendRequest()) {
+        break;
+      }
+    }
+
+    generator.Pump(MaxPollWait);
+
+    if(now >= nextReport) {
+      auto waiting      = generator.ExpireRequests();
+      auto span         = std::chrono::duration_cast<Seconds>(now - lastReport).count();
+      auto sentRate     = (generator.requestsSent - requests) / span;
+      auto answeredRate = (generator.responses - responses) / span;
+
+      std::cout << std::setw(7) << elapsed
+                << std::setw(7) << generator.GetPeerCount()
+                << std::setw(9) << generator.GetIdentifiedCount()
+                << std::setw(11) << (generator.acceptLatency.GetPercentile(50) / 1000.0) << "/" << std::left << std::setw(8) << (generator.acceptLatency.GetPercentile(99) / 1000.0) << std::right
+                << std::setw(8) << sentRate
+                << std::setw(12) << answeredRate
+                << std::setw(12) << (generator.responseLatency.GetPercentile(50) / 1000.0) << "/" << (generator.responseLatency.GetPercentile(99) / 1000.0) << "/" << (generator.responseLatency.GetMax() / 1000.0)
+                << std::setw(11) << waiting
+                << std::setw(6) << generator.requestsLost
+                << std::setw(7) << (generator.disconnects - disconnects);
+
+      if(daemonCPU) {
+        auto cpu = kvm::GetProcessCPUTime(options.pid);
+        if(cpu) {
+          auto used = std::chrono::duration_cast<Seconds>(cpu.value() - daemonCPU.value_or(cpu.value())).count();
+          std::cout << std::setw(10) << (100.0 * used / span) << "%";
+          daemonCPU = cpu;
+        }
+      }
+      std::cout << std::endl;
+
+      if(generator.requestsLost == lost && sentRate > 0 && answeredRate >= sentRate * 0.99) {
+        sustainedRate = std::max(sustainedRate, sentRate);
+      }
+
+      requests    = generator.requestsSent;
+      responses   = generator.responses;
+      lost        = generator.requestsLost;
+      disconnects = generator.disconnects;
+      lastReport  = now;
+      nextReport  = now + interval;
+      generator.acceptLatency.Clear();
+      generator.responseLatency.Clear();
+    }
+  }
+
+  generator.ExpireRequests();
+  auto roundTrips = generator.GetRoundTripTimes();
+
+  std::cout << "Peers " << generator.GetPeerCount() << ", " << generator.GetIdentifiedCount() << " Greeted at the End, " << generator.disconnects << " Disconnects" << std::endl;
+  std::cout << "Requests " << generator.requestsSent << " Sent, " << generator.responses << " Answered, " << generator.requestsLost << " Lost, " << generator.requestsUnsent << " Not Sent for Want of a Peer" << std::endl;
+  std::cout << "Median Heartbeat Round Trip per Peer p50/p99/max " << (roundTrips.GetPercentile(50) / 1000.0) << "/" << (roundTrips.GetPercentile(99) / 1000.0) << "/" << (roundTrips.GetMax() / 1000.0) << "ms" << std::endl;
+  std::cout << "Highest Request Rate Answered in Full: " << sustainedRate << "/s" << std::endl;
+
+  return EXIT_SUCCESS;
+}
\ No newline at end of file
@@ -0,0 +1,162 @@
+#include <iostream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <cstring>
+#include <core/histogram.h>
+#include <networking/capture.h>
+#include <networking/cluster.h>
+#include <networking/message/types.h>
+#include <platform/functions.h>
+
+/**
+ * Plays a capture written with kvm --capture back into a cluster's message handling, at the recorded
+ * pace or as fast as possible, so that message handling can be profiled and bugs reproduced offline.
+ * Messages go straight to Cluster::OnMessageReceived() from stand-in nodes, one per recorded peer; no
+ * sockets are opened and nothing is sent. Every message is decoded and dispatched, but since the stand-ins
+ * aren't attached to the cluster and it never sent a request, only input change requests go on to reach
+ * listeners. Responses and display announcements are dropped once dispatched, as they would be from an
+ * unknown node.
+ */
+
+typedef struct {
+  std::string                             captureFile;
+  bool                                    fast;
+  kvm::CapturedMessage::Direction         direction;
+  int                                     repeat;
+} Options;
+
+const char* MessageTypeToString(uint8_t type) {
+  switch(static_cast<kvm::NetworkMessageType>(type)) {
+    case kvm::NetworkMessageType::HEARTBEAT:              return "Heartbeat";
+    case kvm::NetworkMessageType::CHANGE_INPUT_REQUEST:   return "Change Input Request";
+    case kvm::NetworkMessageType::CHANGE_INPUT_RESPONSE:  return "Change Input Response";
+    case kvm::NetworkMessageType::MULTICAST_ENVELOPE:     return "Multicast Envelope";
+    case kvm::NetworkMessageType::MULTICAST_ACK:          return "Multicast Ack";
+    case kvm::NetworkMessageType::HELLO:                  return "Hello";
+    case kvm::NetworkMessageType::BEACON:                 return "Beacon";
+    case kvm::NetworkMessageType::DISPLAY_ANNOUNCEMENT:   return "Display Announcement";
+  }
+  return "Unknown";
+}
+
+bool ParseOptions(int argc, char** argv, Options& options) {
+  options.fast      = false;
+  options.direction = kvm::CapturedMessage::Direction::RECEIVED;
+  options.repeat    = 1;
+
+  for(int i = 1; i != argc; i++) {
+    if(strcmp(argv[i], "--fast") == 0) {
+      options.fast = true;
+    } else if(strcmp(argv[i], "--sent") == 0) {
+      options.direction = kvm::CapturedMessage::Direction::SENT;
+    } else if(strcmp(argv[i], "--repeat") == 0 && (i + 1) < argc) {
+      options.repeat = atoi(argv[++i]);
+    } else {
+      options.captureFile = argv[i];
+    }
+  }
+
+  if(options.captureFile.empty() || options.repeat < 1) {
+    std::cerr << "Usage: " << argv[0] << " <capture file> [--fast] [--sent] [--repeat count]" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Counts the input change requests that replayed messages pass on to listeners.
+ */
+class ReplayListener : public kvm::Cluster::Listener {
+public:
+
+  virtual void OnInputChangeRequested(const kvm::Node& sender, kvm::ChangeInputRequest::RequestId id, const kvm::Display::InputMap& changes) override {
+    requestCount++;
+    changeCount += changes.size();
+  }
+
+  virtual void OnInputChangeResponse(const kvm::Node& sender, kvm::ChangeInputRequest::RequestId id, const std::map<kvm::Display, bool>& results, std::chrono::microseconds elapsed) override
+  {}
+
+  uint64_t requestCount = 0;
+  uint64_t changeCount = 0;
+};
+
+int main(int argc, char** argv) {
+  Options options;
+  if(!ParseOptions(argc, argv, options)) {
+    return EXIT_FAILURE;
+  }
+
+  kvm::Cluster cluster(0);
+  ReplayListener listener;
+  cluster.AddListener(&listener);
+
+  // Stand-in senders, one per recorded peer. They're never pumped, so they never connect.
+  std::map<std::pair<uint32_t, uint16_t>, std::unique_ptr<kvm::Node>> senders;
+
+  std::map<uint8_t, uint64_t> counts;
+  kvm::Histogram              handlingTime;
+  uint64_t                    bytes = 0;
+  bool                        damaged = false;
+  auto                        started = std::chrono::steady_clock::now();
+
+  for(int pass = 0; pass != options.repeat && !damaged; pass++) {
+    kvm::CaptureReader reader;
+    if(!reader.Open(options.captureFile)) {
+      std::cerr << "Failed to open capture file " << options.captureFile << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    auto passStarted = std::chrono::steady_clock::now();
+    kvm::CapturedMessage record;
+
+    while(reader.Next(record)) {
+      if(record.direction != options.direction || record.message.GetSize() == 0) {
+        continue;
+      }
+
+      auto& sender = senders[std::make_pair(record.peer.sin_addr.s_addr, record.peer.sin_port)];
+      if(!sender) {
+        sender = std::make_unique<kvm::Node>(kvm::AddressToString(record.peer), kvm::NetworkToHost(static_cast<uint16_t>(record.peer.sin_port)));
+      }
+
+      if(!options.fast) {
+        std::this_thread::sleep_until(passStarted + record.timestamp);
+      }
+
+      counts[record.message.GetBuffer()[0]]++;
+      bytes += record.message.GetSize();
+
+      auto before = std::chrono::steady_clock::now();
+      cluster.OnMessageReceived(*sender, record.message);
+      handlingTime.Record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - before).count());
+    }
+
+    damaged = !reader.IsAtEnd();
+  }
+
+  auto elapsed  = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+  auto messages = handlingTime.GetCount();
+
+  std::cout << "Replayed " << messages << " Messages (" << bytes << "B) from " << senders.size() << " Peers in " << std::fixed << std::setprecision(3) << elapsed << "s";
+  if(elapsed > 0) {
+    std::cout << ", " << std::setprecision(0) << (messages / elapsed) << " Messages/s";
+  }
+  std::cout << std::endl;
+
+  for(auto &count : counts) {
+    std::cout << "  " << MessageTypeToString(count.first) << ": " << count.second << std::endl;
+  }
+
+  std::cout << "Handling Time p50/p99/max " << handlingTime.GetPercentile(50) << "/" << handlingTime.GetPercentile(99) << "/" << handlingTime.GetMax() << "ns" << std::endl;
+  std::cout << "Input Change Requests " << listener.requestCount << " (" << listener.changeCount << " Changes)" << std::endl;
+
+  if(damaged) {
+    std::cerr << "Capture ends with a damaged or truncated record" << std::endl;
+  }
+
+  return EXIT_SUCCESS;
+}
\ No newline at end of file
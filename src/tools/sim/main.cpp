@@ -0,0 +1,455 @@
+#include "network.h"
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <optional>
+#include <set>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <core/histogram.h>
+#include <networking/cluster.h>
+#include <platform/functions.h>
+
+/**
+ * Runs a cluster of simulated desks on virtual time. Each desk is a real Cluster, wired to the others
+ * through SimulatedNetwork, that drives its own displays: requests for them are answered after a
+ * simulated DDC delay, as KVM does on real hardware. Requesting desks switch a few displays at a time
+ * and the run reports how long the switches took and how many messages they cost. With contention,
+ * several desks ask for the same displays at the same instant, each for its own input, and the run
+ * reports how many of those switches left the displays split between desks.
+ */
+
+const uint16_t SimulatedPort = 10191;
+const uint32_t FirstHostIP = 0x0A000001;
+const std::chrono::milliseconds MaxPollWait(1000);
+/// Pumps at a single instant beyond which a host is assumed to be spinning
+const size_t MaxPumpsPerInstant = 1000000;
+
+typedef struct {
+  double                    start;
+  double                    duration;
+} PartitionOption;
+
+typedef struct {
+  int                           desks;
+  int                           requesters;
+  bool                          mesh;
+  bool                          broadcast;
+  int                           displaysPerDesk;
+  int                           displaysPerSwitch;
+  int                           switches;
+  int                           contention;
+  double                        switchInterval;
+  double                        warmup;
+  double                        latency;
+  double                        jitter;
+  double                        loss;
+  std::vector<PartitionOption>  partitions;
+  double                        ddcDelay;
+  double                        probeDelay;
+  int                           coalesceWindow;
+  int                           leaseDuration;
+  kvm::FailureDetector::Settings failureDetection;
+  uint64_t                      seed;
+} Options;
+
+std::chrono::microseconds Milliseconds(double milliseconds) {
+  return std::chrono::microseconds(static_cast<int64_t>(milliseconds * 1000));
+}
+
+bool ParseOptions(int argc, char** argv, Options& options) {
+  options.desks             = 10;
+  options.requesters        = 1;
+  options.mesh              = false;
+  options.broadcast         = false;
+  options.displaysPerDesk   = 1;
+  options.displaysPerSwitch = 2;
+  options.switches          = 20;
+  options.contention        = 1;
+  options.switchInterval    = 500;
+  options.warmup            = 2000;
+  options.latency           = 0.25;
+  options.jitter            = 0;
+  options.loss              = 0;
+  options.ddcDelay          = 50;
+  options.probeDelay        = 10;
+  options.coalesceWindow    = 5;
+  options.leaseDuration     = 1000;
+  options.seed              = 1;
+
+  for(int i = 1; i != argc; i++) {
+    if(strcmp(argv[i], "--desks") == 0 && (i + 1) < argc) {
+      options.desks = atoi(argv[++i]);
+    } else if(strcmp(argv[i], "--requesters") == 0 && (i + 1) < argc) {
+      options.requesters = atoi(argv[++i]);
+    } else if(strcmp(argv[i], "--mesh") == 0) {
+      options.mesh = true;
+    } else if(strcmp(argv[i], "--broadcast") == 0) {
+      options.broadcast = true;
+    } else if(strcmp(argv[i], "--displays") == 0 && (i + 1) < argc) {
+      options.displaysPerDesk = atoi(argv[++i]);
+    } else if(strcmp(argv[i], "--displays-per-switch") == 0 && (i + 1) < argc) {
+      options.displaysPerSwitch = atoi(argv[++i]);
+    } else if(strcmp(argv[i], "--switches") == 0 && (i + 1) < argc) {
+      options.switches = atoi(argv[++i]);
+    } else if(strcmp(argv[i], "--contention") == 0 && (i + 1) < argc) {
+      options.contention = atoi(argv[++i]);
+    } else if(strcmp(argv[i], "--switch-interval") == 0 && (i + 1) < argc) {
+      options.switchInterval = atof(argv[++i]);
+    } else if(strcmp(argv[i], "--warmup") == 0 && (i + 1) < argc) {
+      options.warmup = atof(argv[++i]);
+    } else if(strcmp(argv[i], "--latency") == 0 && (i + 1) < argc) {
+      options.latency = atof(argv[++i]);
+    } else if(strcmp(argv[i], "--jitter") == 0 && (i + 1) < argc) {
+      options.jitter = atof(argv[++i]);
+    } else if(strcmp(argv[i], "--loss") == 0 && (i + 1) < argc) {
+      options.loss = atof(argv[++i]);
+    } else if(strcmp(argv[i], "--partition") == 0 && (i + 2) < argc) {
+      auto start    = atof(argv[++i]);
+      auto duration = atof(argv[++i]);
+      options.partitions.push_back(PartitionOption{start, duration});
+    } else if(strcmp(argv[i], "--ddc-delay") == 0 && (i + 1) < argc) {
+      options.ddcDelay = atof(argv[++i]);
+    } else if(strcmp(argv[i], "--probe-delay") == 0 && (i + 1) < argc) {
+      options.probeDelay = atof(argv[++i]);
+    } else if(strcmp(argv[i], "--coalesce-window") == 0 && (i + 1) < argc) {
+      options.coalesceWindow = atoi(argv[++i]);
+    } else if(strcmp(argv[i], "--lease-duration") == 0 && (i + 1) < argc) {
+      options.leaseDuration = atoi(argv[++i]);
+    } else if(strcmp(argv[i], "--heartbeat-interval") == 0 && (i + 1) < argc) {
+      options.failureDetection.heartbeatInterval = std::chrono::milliseconds(atoi(argv[++i]));
+    } else if(strcmp(argv[i], "--seed") == 0 && (i + 1) < argc) {
+      options.seed = strtoull(argv[++i], nullptr, 10);
+    } else {
+      std::cerr << "Unknown option " << argv[i] << std::endl;
+      return false;
+    }
+  }
+
+  if(options.mesh) {
+    options.requesters = options.desks;
+  }
+
+  if(options.desks < 2 || options.requesters < 1 || options.requesters > options.desks || options.displaysPerDesk < 1 || options.displaysPerSwitch < 1) {
+    std::cerr << "Need at least two desks, at least one requesting desk and at least one display per desk and switch" << std::endl;
+    return false;
+  }
+
+  if(options.contention < 1 || options.contention > options.requesters || options.contention >= options.desks) {
+    std::cerr << "Contention must be between one and the number of requesting desks, and leave a desk to switch" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Totals gathered across every desk.
+ */
+struct Statistics {
+  uint64_t        switchesRequested = 0;
+  uint64_t        switchesSucceeded = 0;
+  uint64_t        switchesFailed = 0;
+  uint64_t        requestsReceived = 0;
+  uint64_t        requestsUnservable = 0;
+  uint64_t        displaysSwitched = 0;
+  uint64_t        displaysRefused = 0;
+  uint64_t        switchesSplit = 0;
+  kvm::Histogram  switchLatency;
+};
+
+/**
+ * A machine at a desk: a cluster that owns some displays and answers requests for them.
+ */
+class Desk : public kvm::Cluster::Listener {
+public:
+
+  Desk(size_t host, const Options& options, Statistics& statistics) :
+  m_host(host),
+  m_options(options),
+  m_statistics(statistics),
+  m_cluster(SimulatedPort)
+  {}
+
+  bool Initialize(const std::vector<kvm::Display::SerialNumber>& displays) {
+    m_displays = displays;
+    m_cluster.SetNodeId(m_host + 1);
+    m_cluster.SetFailureDetection(m_options.failureDetection);
+    m_cluster.SetCoalesceWindow(std::chrono::milliseconds(m_options.coalesceWindow));
+    m_cluster.SetLeaseDuration(std::chrono::milliseconds(m_options.leaseDuration));
+    m_cluster.AddListener(this);
+
+    // Without announcements, every desk is sent every request, as before display ownership was tracked.
+    if(!m_options.broadcast) {
+      m_cluster.SetDisplays(displays);
+    }
+    return m_cluster.Initialize();
+  }
+
+  kvm::Cluster& GetCluster() {
+    return m_cluster;
+  }
+
+  const std::vector<kvm::Display::SerialNumber>& GetDisplays() const {
+    return m_displays;
+  }
+
+  /**
+   * Get the input that one of the desk's displays was last switched to, if it has been switched.
+   */
+  std::optional<kvm::Display::Input> GetInput(kvm::Display::SerialNumber serial) const {
+    auto input = m_inputs.find(serial);
+    return input == m_inputs.end() ? std::nullopt : std::optional<kvm::Display::Input>(input->second);
+  }
+
+  virtual void OnInputChangeRequested(const kvm::Node& sender, kvm::ChangeInputRequest::RequestId id, const kvm::Display::InputMap& changes) override {
+    m_statistics.requestsReceived++;
+
+    // Listing displays costs the probe delay whether or not any of them were asked for, and each
+    // display we own takes a DDC write on top.
+    std::map<kvm::Display, bool> results;
+    for(auto &change : changes) {
+      for(auto serial : m_displays) {
+        if(change.first.GetSerialNumber() == serial) {
+          results[change.first] = true;
+          m_inputs[serial]      = change.second;
+        }
+      }
+    }
+
+    if(results.empty()) {
+      m_statistics.requestsUnservable++;
+    }
+    m_statistics.displaysSwitched += results.size();
+
+    auto handle   = m_cluster.GetNodeHandle(sender);
+    auto elapsed  = Milliseconds(m_options.probeDelay + m_options.ddcDelay * results.size());
+    if(!handle) {
+      return;
+    }
+
+    auto& network = kvm::SimulatedNetwork::Shared();
+    network.Schedule(network.Now() + elapsed, [this, handle, id, results, elapsed]() {
+      auto& network = kvm::SimulatedNetwork::Shared();
+      network.SetCurrentHost(m_host);
+      m_cluster.RespondToInputChangeRequest(handle.value(), id, results, elapsed);
+      network.Wake(m_host);
+    });
+  }
+
+  virtual void OnInputChangeResponse(const kvm::Node& sender, kvm::ChangeInputRequest::RequestId id, const std::map<kvm::Display, bool>& results, std::chrono::microseconds elapsed) override {
+    for(auto &result : results) {
+      m_statistics.displaysRefused += result.second ? 0 : 1;
+    }
+  }
+
+  virtual void OnInputChangeCompleted(kvm::ChangeInputRequest::RequestId id, bool succeeded, std::chrono::microseconds latency) override {
+    (succeeded ? m_statistics.switchesSucceeded : m_statistics.switchesFailed)++;
+    m_statistics.switchLatency.Record(latency.count());
+  }
+
+private:
+
+  /// Simulated host that the desk runs on
+  size_t m_host;
+  /// Simulation settings
+  const Options& m_options;
+  /// Totals to add to
+  Statistics& m_statistics;
+  /// Displays attached to this desk
+  std::vector<kvm::Display::SerialNumber> m_displays;
+  /// Input that each display was last switched to
+  std::map<kvm::Display::SerialNumber, kvm::Display::Input> m_inputs;
+  /// Desk's cluster
+  kvm::Cluster m_cluster;
+};
+
+int main(int argc, char** argv) {
+  Options options;
+  if(!ParseOptions(argc, argv, options)) {
+    return EXIT_FAILURE;
+  }
+
+  auto& network = kvm::SimulatedNetwork::Shared();
+  network.Install(options.seed);
+  network.SetSettings(kvm::SimulatedNetwork::Settings{
+    Milliseconds(options.latency),
+    Milliseconds(options.jitter),
+    options.loss,
+    std::chrono::milliseconds(200)
+  });
+
+  auto started  = network.Now();
+  auto& random  = network.GetRandom();
+
+  // Desks in the first half are cut off from the second half during each partition.
+  for(auto &partition : options.partitions) {
+    network.AddPartition(started + Milliseconds(partition.start), started + Milliseconds(partition.start + partition.duration), options.desks / 2);
+  }
+
+  Statistics statistics;
+  std::vector<std::unique_ptr<Desk>> desks;
+  kvm::Display::SerialNumber nextSerial = 1;
+
+  for(int i = 0; i < options.desks; i++) {
+    auto host = network.AddHost(FirstHostIP + i);
+    network.SetCurrentHost(host);
+
+    std::vector<kvm::Display::SerialNumber> displays;
+    for(int j = 0; j < options.displaysPerDesk; j++) {
+      displays.push_back(nextSerial++);
+    }
+
+    desks.push_back(std::make_unique<Desk>(host, options, statistics));
+    if(!desks.back()->Initialize(displays)) {
+      std::cerr << "Failed to initialize desk " << i << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  // Requesting desks connect to every other desk. The rest only accept connections.
+  for(int i = 0; i < options.requesters; i++) {
+    network.SetCurrentHost(i);
+    for(int j = 0; j < options.desks; j++) {
+      if(i != j) {
+        desks[i]->GetCluster().AddNode(kvm::AddressToString(network.GetHostAddress(j, SimulatedPort)), SimulatedPort);
+      }
+    }
+  }
+
+  for(size_t i = 0; i < desks.size(); i++) {
+    network.Wake(i);
+  }
+
+  size_t linksUp = 0;
+  network.Schedule(started + Milliseconds(options.warmup), [&]() {
+    for(auto &desk : desks) {
+      for(auto &link : desk->GetCluster().GetLinkStatistics()) {
+        linksUp += link.connected ? 1 : 0;
+      }
+    }
+  });
+
+  std::vector<kvm::Display::Input> inputs = { kvm::Display::Input::DP1, kvm::Display::Input::HDMI1, kvm::Display::Input::HDMI2 };
+  for(int i = 0; i < options.switches; i++) {
+    network.Schedule(started + Milliseconds(options.warmup + i * options.switchInterval), [&]() {
+      auto requester = std::uniform_int_distribution<size_t>(0, options.requesters - 1);
+      auto target    = std::uniform_int_distribution<size_t>(0, desks.size() - 1);
+      auto input     = std::uniform_int_distribution<size_t>(0, inputs.size() - 1);
+
+      std::vector<size_t> requesters;
+      while(requesters.size() < static_cast<size_t>(options.contention)) {
+        auto desk = requester(random);
+        if(std::find(requesters.begin(), requesters.end(), desk) == requesters.end()) {
+          requesters.push_back(desk);
+        }
+      }
+
+      // Switch displays at other desks, as a desk's own displays are switched locally.
+      kvm::Display::InputMap changes;
+      while(changes.size() < static_cast<size_t>(options.displaysPerSwitch) && changes.size() < (desks.size() - requesters.size()) * options.displaysPerDesk) {
+        auto desk = target(random);
+        if(std::find(requesters.begin(), requesters.end(), desk) == requesters.end()) {
+          auto& displays = desks[desk]->GetDisplays();
+          changes[kvm::Display(displays[random() % displays.size()])] = inputs[input(random)];
+        }
+      }
+
+      // Contending desks each want every display on their own input.
+      for(size_t contender = 0; contender < requesters.size(); contender++) {
+        if(requesters.size() > 1) {
+          for(auto &change : changes) {
+            change.second = inputs[contender % inputs.size()];
+          }
+        }
+
+        auto desk = requesters[contender];
+        network.SetCurrentHost(desk);
+        desks[desk]->GetCluster().RequestInputChange(changes);
+        network.Wake(desk);
+        statistics.switchesRequested++;
+      }
+
+      if(requesters.size() < 2) {
+        return;
+      }
+
+      // Just before the next switch, see whether one desk got all of the displays.
+      network.Schedule(network.Now() + Milliseconds(options.switchInterval) - std::chrono::microseconds(1), [&, changes]() {
+        std::set<kvm::Display::Input> landed;
+        for(auto &change : changes) {
+          auto serial = change.first.GetSerialNumber();
+          auto input  = desks[(serial - 1) / options.displaysPerDesk]->GetInput(serial);
+          if(input) {
+            landed.insert(input.value());
+          }
+        }
+        statistics.switchesSplit += landed.size() > 1 ? 1 : 0;
+      });
+    });
+  }
+
+  // Leave time for the last switch to finish or time out.
+  auto end = started + Milliseconds(options.warmup + options.switches * options.switchInterval) + std::chrono::seconds(6);
+
+  auto      wallStarted = std::chrono::steady_clock::now();
+  uint64_t  pumps = 0;
+  size_t    pumpsThisInstant = 0;
+  auto      instant = network.Now();
+
+  while(true) {
+    auto runnable = network.TakeRunnableHosts();
+    if(runnable.empty()) {
+      if(!network.RunNext(end)) {
+        break;
+      }
+      continue;
+    }
+
+    if(network.Now() != instant) {
+      instant           = network.Now();
+      pumpsThisInstant  = 0;
+    }
+
+    pumpsThisInstant += runnable.size();
+    if(pumpsThisInstant > MaxPumpsPerInstant) {
+      std::cerr << "Hosts are still busy after " << MaxPumpsPerInstant << " pumps without time passing; giving up" << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    for(auto host : runnable) {
+      network.SetCurrentHost(host);
+      desks[host]->GetCluster().Pump(MaxPollWait);
+      pumps++;
+    }
+  }
+
+  auto simulated  = std::chrono::duration<double>(network.Now() - started).count();
+  auto wall       = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStarted).count();
+
+  std::cout << std::fixed << std::setprecision(3);
+  std::cout << "Simulated " << options.desks << " Desks (" << options.requesters << " Requesting) for " << simulated << "s in " << wall << "s, " << pumps << " Pumps" << std::endl;
+  std::cout << "Links Up at First Switch: " << linksUp << std::endl;
+  std::cout << "Switches " << statistics.switchesRequested << " Requested, " << statistics.switchesSucceeded << " Succeeded, " << statistics.switchesFailed << " Failed" << std::endl;
+  std::cout << "Switch Latency p50/p99/max " << statistics.switchLatency.GetPercentile(50) << "/" << statistics.switchLatency.GetPercentile(99) << "/" << statistics.switchLatency.GetMax() << "us" << std::endl;
+  std::cout << "Requests Received " << statistics.requestsReceived << ", " << statistics.requestsUnservable << " by Desks Owning None of the Displays, " << statistics.displaysSwitched << " Displays Switched, " << statistics.displaysRefused << " Refused" << std::endl;
+  if(options.contention > 1) {
+    std::cout << "Contended Switches Left Split Between Desks: " << statistics.switchesSplit << " of " << options.switches << std::endl;
+  }
+
+  std::cout << "Messages Heartbeat " << network.GetMessageCount(kvm::NetworkMessageType::HEARTBEAT)
+            << " Hello " << network.GetMessageCount(kvm::NetworkMessageType::HELLO)
+            << " Request " << network.GetMessageCount(kvm::NetworkMessageType::CHANGE_INPUT_REQUEST)
+            << " Response " << network.GetMessageCount(kvm::NetworkMessageType::CHANGE_INPUT_RESPONSE)
+            << " Display Announcement " << network.GetMessageCount(kvm::NetworkMessageType::DISPLAY_ANNOUNCEMENT)
+            << " (" << network.GetByteCount() << "B)" << std::endl;
+
+  if(statistics.switchesRequested > 0) {
+    auto switchMessages = network.GetMessageCount(kvm::NetworkMessageType::CHANGE_INPUT_REQUEST) + network.GetMessageCount(kvm::NetworkMessageType::CHANGE_INPUT_RESPONSE);
+    std::cout << "Messages per Switch " << std::setprecision(1) << (static_cast<double>(switchMessages) / statistics.switchesRequested) << std::endl;
+  }
+
+  return EXIT_SUCCESS;
+}
\ No newline at end of file
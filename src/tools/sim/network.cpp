@@ -0,0 +1,437 @@
+#include "network.h"
+#include <platform/functions.h>
+#include <algorithm>
+#include <cstring>
+
+/// Handles start well clear of real file descriptors, so that the two are never mistaken for each other
+#define SOCKET_HANDLE_BASE  (1 << 24)
+#define FIRST_EPHEMERAL_PORT 32768
+
+namespace kvm {
+  SimulatedNetwork& SimulatedNetwork::Shared() {
+    static SimulatedNetwork network;
+    return network;
+  }
+
+  SimulatedNetwork::TimePoint SimulatedNetwork::ReadClock() {
+    return Shared().m_now;
+  }
+
+  SimulatedNetwork::SimulatedNetwork() :
+  m_now(),
+  m_settings{std::chrono::microseconds(250), Duration(0), 0, std::chrono::milliseconds(200)},
+  m_currentHost(0),
+  m_sequence(0),
+  m_bytes(0) {
+    m_messages.fill(0);
+  }
+
+  void SimulatedNetwork::Install(uint64_t seed) {
+    m_random.seed(seed);
+    Clock::SetSource(&SimulatedNetwork::ReadClock);
+  }
+
+  void SimulatedNetwork::SetSettings(const Settings& settings) {
+    m_settings = settings;
+  }
+
+  SimulatedNetwork::TimePoint SimulatedNetwork::Now() const {
+    return m_now;
+  }
+
+  std::mt19937_64& SimulatedNetwork::GetRandom() {
+    return m_random;
+  }
+
+  size_t SimulatedNetwork::AddHost(uint32_t ip) {
+    m_hosts.push_back(Host{ip, false, 0});
+    m_nextPort.push_back(FIRST_EPHEMERAL_PORT);
+    return m_hosts.size() - 1;
+  }
+
+  SocketAddress SimulatedNetwork::GetHostAddress(size_t host, uint16_t port) const {
+    SocketAddress address = {};
+    address.sin_family      = AF_INET;
+    address.sin_addr.s_addr = HostToNetwork(m_hosts[host].ip);
+    address.sin_port        = HostToNetwork(port);
+    return address;
+  }
+
+  void SimulatedNetwork::SetCurrentHost(size_t host) {
+    m_currentHost = host;
+  }
+
+  void SimulatedNetwork::AddPartition(TimePoint start, TimePoint end, size_t split) {
+    m_partitions.push_back(Partition{start, end, split});
+  }
+
+  void SimulatedNetwork::Schedule(TimePoint at, std::function<void()> action) {
+    m_schedule.push(ScheduledAction{std::max(at, m_now), m_sequence++, std::move(action)});
+  }
+
+  void SimulatedNetwork::Wake(size_t host) {
+    if(!m_hosts[host].runnable) {
+      m_hosts[host].runnable = true;
+      m_runnable.push_back(host);
+    }
+  }
+
+  std::vector<size_t> SimulatedNetwork::TakeRunnableHosts() {
+    std::vector<size_t> runnable;
+    runnable.swap(m_runnable);
+    for(auto host : runnable) {
+      m_hosts[host].runnable = false;
+    }
+    return runnable;
+  }
+
+  bool SimulatedNetwork::RunNext(TimePoint limit) {
+    if(m_schedule.empty() || m_schedule.top().at > limit) {
+      return false;
+    }
+
+    m_now = m_schedule.top().at;
+    while(!m_schedule.empty() && m_schedule.top().at == m_now) {
+      // The action may schedule more, so take it off the queue before running it.
+      auto action = std::move(const_cast<ScheduledAction&>(m_schedule.top()).action);
+      m_schedule.pop();
+      action();
+    }
+    return true;
+  }
+
+  void SimulatedNetwork::CountMessage(NetworkMessage::Type type) {
+    if(type < m_messages.size()) {
+      m_messages[type]++;
+    }
+  }
+
+  uint64_t SimulatedNetwork::GetMessageCount(NetworkMessageType type) const {
+    return m_messages[static_cast<size_t>(type)];
+  }
+
+  uint64_t SimulatedNetwork::GetByteCount() const {
+    return m_bytes;
+  }
+
+  SimulatedNetwork::Endpoint* SimulatedNetwork::Find(PlatformSocket socket) {
+    auto index = static_cast<size_t>(socket) - SOCKET_HANDLE_BASE;
+    return socket >= SOCKET_HANDLE_BASE && index < m_endpoints.size() ? &m_endpoints[index] : nullptr;
+  }
+
+  const SimulatedNetwork::Endpoint* SimulatedNetwork::Find(PlatformSocket socket) const {
+    auto index = static_cast<size_t>(socket) - SOCKET_HANDLE_BASE;
+    return socket >= SOCKET_HANDLE_BASE && index < m_endpoints.size() ? &m_endpoints[index] : nullptr;
+  }
+
+  SimulatedNetwork::TimePoint SimulatedNetwork::Transit(size_t from, size_t to, TimePoint notBefore) {
+    auto arrival = m_now + m_settings.latency;
+    if(m_settings.jitter.count() > 0) {
+      arrival += Duration(std::uniform_int_distribution<Duration::rep>(0, m_settings.jitter.count())(m_random));
+    }
+
+    std::uniform_real_distribution<double> chance(0, 1);
+    while(m_settings.loss > 0 && chance(m_random) < m_settings.loss) {
+      arrival += m_settings.retransmitTimeout;
+    }
+
+    // Segments that would cross a partition, whether sent during it or due to arrive during it, get
+    // through once it heals.
+    for(auto &partition : m_partitions) {
+      if((from < partition.split) == (to < partition.split)) {
+        continue;
+      }
+
+      bool sentDuring     = m_now >= partition.start && m_now < partition.end;
+      bool arrivesDuring  = arrival >= partition.start && arrival < partition.end;
+      if(sentDuring || arrivesDuring) {
+        arrival = std::max(arrival, partition.end + m_settings.latency);
+      }
+    }
+
+    return std::max(arrival, notBefore);
+  }
+
+  void SimulatedNetwork::Deliver(size_t from, size_t to, std::function<void()> action) {
+    auto& endpoint        = m_endpoints[to];
+    auto  arrival         = Transit(from, endpoint.host, endpoint.lastArrival);
+    endpoint.lastArrival  = arrival;
+    Schedule(arrival, std::move(action));
+  }
+
+  PlatformSocket SimulatedNetwork::Listen(uint16_t port) {
+    uint64_t key = (static_cast<uint64_t>(m_hosts[m_currentHost].ip) << 16) | port;
+    if(m_listeners.count(key) > 0) {
+      return -1;
+    }
+
+    Endpoint listener = {};
+    listener.state  = Endpoint::State::LISTENING;
+    listener.host   = m_currentHost;
+    listener.local  = GetHostAddress(m_currentHost, port);
+
+    m_endpoints.push_back(std::move(listener));
+    m_listeners[key] = m_endpoints.size() - 1;
+    return static_cast<PlatformSocket>(SOCKET_HANDLE_BASE + m_endpoints.size() - 1);
+  }
+
+  PlatformSocket SimulatedNetwork::Connect(const SocketAddress& address) {
+    Endpoint client = {};
+    client.state    = Endpoint::State::CONNECTING;
+    client.host     = m_currentHost;
+    client.local    = GetHostAddress(m_currentHost, m_nextPort[m_currentHost]++);
+    client.remote   = address;
+
+    m_endpoints.push_back(std::move(client));
+    auto index = m_endpoints.size() - 1;
+
+    auto ip       = NetworkToHost(static_cast<uint32_t>(address.sin_addr.s_addr));
+    uint64_t key  = (static_cast<uint64_t>(ip) << 16) | NetworkToHost(static_cast<uint16_t>(address.sin_port));
+    auto listener = m_listeners.find(key);
+    if(listener == m_listeners.end()) {
+      // A host with nothing listening refuses the connection. Nothing answers for addresses that
+      // aren't simulated hosts, so those attempts time out.
+      auto host = std::find_if(m_hosts.begin(), m_hosts.end(), [ip](const Host& host) { return host.ip == ip; });
+      if(host != m_hosts.end()) {
+        Deliver(static_cast<size_t>(host - m_hosts.begin()), index, [this, index]() {
+          if(m_endpoints[index].state == Endpoint::State::CONNECTING) {
+            m_endpoints[index].state = Endpoint::State::REFUSED;
+            MarkReady(index);
+          }
+        });
+      }
+      return static_cast<PlatformSocket>(SOCKET_HANDLE_BASE + index);
+    }
+
+    auto server = listener->second;
+    Schedule(Transit(m_currentHost, m_endpoints[server].host, m_now), [this, index, server]() {
+      if(m_endpoints[index].state != Endpoint::State::CONNECTING) {
+        return;
+      }
+
+      // Refused if the listener closed while the connection attempt was on its way.
+      if(m_endpoints[server].state != Endpoint::State::LISTENING) {
+        Deliver(m_endpoints[server].host, index, [this, index]() {
+          if(m_endpoints[index].state == Endpoint::State::CONNECTING) {
+            m_endpoints[index].state = Endpoint::State::REFUSED;
+            MarkReady(index);
+          }
+        });
+        return;
+      }
+
+      Endpoint accepted = {};
+      accepted.state    = Endpoint::State::CONNECTED;
+      accepted.host     = m_endpoints[server].host;
+      accepted.local    = m_endpoints[server].local;
+      accepted.remote   = m_endpoints[index].local;
+      accepted.peer     = index;
+
+      m_endpoints.push_back(std::move(accepted));
+      auto peer = m_endpoints.size() - 1;
+
+      m_endpoints[index].peer = peer;
+      m_endpoints[server].backlog.push_back(peer);
+      MarkReady(server);
+
+      Deliver(m_endpoints[peer].host, index, [this, index]() {
+        if(m_endpoints[index].state == Endpoint::State::CONNECTING) {
+          m_endpoints[index].state = Endpoint::State::CONNECTED;
+          MarkReady(index);
+        }
+      });
+    });
+
+    return static_cast<PlatformSocket>(SOCKET_HANDLE_BASE + index);
+  }
+
+  std::optional<std::pair<PlatformSocket, SocketAddress>> SimulatedNetwork::Accept(PlatformSocket listener) {
+    auto endpoint = Find(listener);
+    if(endpoint == nullptr || endpoint->state != Endpoint::State::LISTENING || endpoint->backlog.empty()) {
+      return std::nullopt;
+    }
+
+    auto accepted = endpoint->backlog.front();
+    endpoint->backlog.pop_front();
+    MarkReady(accepted);
+    return std::make_pair(static_cast<PlatformSocket>(SOCKET_HANDLE_BASE + accepted), m_endpoints[accepted].remote);
+  }
+
+  bool SimulatedNetwork::IsConnected(PlatformSocket socket) const {
+    auto endpoint = Find(socket);
+    return endpoint != nullptr && endpoint->state == Endpoint::State::CONNECTED;
+  }
+
+  bool SimulatedNetwork::Write(PlatformSocket socket, const uint8_t* data, size_t size) {
+    auto endpoint = Find(socket);
+    if(endpoint == nullptr || endpoint->state != Endpoint::State::CONNECTED || endpoint->peerClosed || !endpoint->peer) {
+      return false;
+    }
+
+    m_bytes += size;
+
+    auto peer = endpoint->peer.value();
+    std::vector<uint8_t> segment(data, data + size);
+    Deliver(endpoint->host, peer, [this, peer, segment = std::move(segment)]() {
+      auto& receiver = m_endpoints[peer];
+      if(receiver.state == Endpoint::State::CONNECTED) {
+        receiver.inbox.insert(receiver.inbox.end(), segment.begin(), segment.end());
+        MarkReady(peer);
+      }
+    });
+    return true;
+  }
+
+  std::optional<size_t> SimulatedNetwork::Read(PlatformSocket socket, uint8_t* data, size_t size) {
+    auto endpoint = Find(socket);
+    if(endpoint == nullptr || endpoint->state != Endpoint::State::CONNECTED) {
+      return std::nullopt;
+    }
+
+    auto available = endpoint->inbox.size() - endpoint->inboxOffset;
+    if(available == 0) {
+      return endpoint->peerClosed ? std::nullopt : std::optional<size_t>(0);
+    }
+
+    auto count = std::min(size, available);
+    memcpy(data, endpoint->inbox.data() + endpoint->inboxOffset, count);
+    endpoint->inboxOffset += count;
+
+    if(endpoint->inboxOffset == endpoint->inbox.size()) {
+      endpoint->inbox.clear();
+      endpoint->inboxOffset = 0;
+    }
+    return count;
+  }
+
+  void SimulatedNetwork::Close(PlatformSocket socket) {
+    auto endpoint = Find(socket);
+    if(endpoint == nullptr || endpoint->state == Endpoint::State::CLOSED) {
+      return;
+    }
+
+    if(endpoint->state == Endpoint::State::LISTENING) {
+      uint64_t key = (static_cast<uint64_t>(NetworkToHost(static_cast<uint32_t>(endpoint->local.sin_addr.s_addr))) << 16) | NetworkToHost(static_cast<uint16_t>(endpoint->local.sin_port));
+      m_listeners.erase(key);
+    }
+
+    // The peer hears about the close after any data already on its way.
+    if(endpoint->peer && endpoint->state == Endpoint::State::CONNECTED) {
+      auto peer = endpoint->peer.value();
+      Deliver(endpoint->host, peer, [this, peer]() {
+        m_endpoints[peer].peerClosed = true;
+        MarkReady(peer);
+      });
+    }
+
+    endpoint->state = Endpoint::State::CLOSED;
+    endpoint->inbox.clear();
+    endpoint->inbox.shrink_to_fit();
+    endpoint->inboxOffset = 0;
+    endpoint->reactor.reset();
+  }
+
+  PlatformReactor SimulatedNetwork::CreateReactor() {
+    m_reactors.push_back(SimulatedReactor{m_currentHost, {}});
+    return static_cast<PlatformReactor>(m_reactors.size() - 1);
+  }
+
+  void SimulatedNetwork::Register(PlatformReactor reactor, PlatformSocket socket, Reactor::Handler* handler, uint8_t interest) {
+    auto endpoint = Find(socket);
+    if(endpoint == nullptr) {
+      return;
+    }
+
+    endpoint->reactor   = static_cast<size_t>(reactor);
+    endpoint->handler   = handler;
+    endpoint->interest  = interest;
+    MarkReady(static_cast<size_t>(socket) - SOCKET_HANDLE_BASE);
+  }
+
+  void SimulatedNetwork::Deregister(PlatformReactor reactor, PlatformSocket socket) {
+    auto endpoint = Find(socket);
+    if(endpoint != nullptr && endpoint->reactor == static_cast<size_t>(reactor)) {
+      endpoint->reactor.reset();
+    }
+  }
+
+  size_t SimulatedNetwork::Poll(PlatformReactor handle, std::chrono::milliseconds timeout) {
+    auto& reactor = m_reactors[handle];
+    auto  host    = reactor.host;
+
+    std::vector<size_t> ready;
+    ready.swap(reactor.ready);
+
+    size_t dispatched = 0;
+    for(auto index : ready) {
+      m_endpoints[index].queued = false;
+
+      auto registered = [this, index, handle]() {
+        return m_endpoints[index].reactor == static_cast<size_t>(handle);
+      };
+
+      if(!registered()) {
+        continue;
+      }
+
+      auto handler  = m_endpoints[index].handler;
+      bool writable = (m_endpoints[index].interest & Reactor::WRITABLE) && IsWritable(m_endpoints[index]);
+      bool readable = (m_endpoints[index].interest & Reactor::READABLE) && IsReadable(m_endpoints[index]);
+
+      if(writable) {
+        handler->OnWritable();
+      }
+      if(readable && registered()) {
+        handler->OnReadable();
+      }
+      if(writable || readable) {
+        dispatched++;
+      }
+
+      // Readiness is level-triggered, so whatever the handler left unconsumed is reported again.
+      if(registered() && (IsReadable(m_endpoints[index]) || ((m_endpoints[index].interest & Reactor::WRITABLE) && IsWritable(m_endpoints[index])))) {
+        MarkReady(index);
+      }
+    }
+
+    // Stand in for the wait the real reactor would have done: wake the host when the timeout expires,
+    // unless something else wakes it first and it polls again.
+    auto generation = ++m_hosts[host].wakeGeneration;
+    Schedule(m_now + timeout, [this, host, generation]() {
+      if(m_hosts[host].wakeGeneration == generation) {
+        Wake(host);
+      }
+    });
+
+    return dispatched;
+  }
+
+  void SimulatedNetwork::MarkReady(size_t index) {
+    auto& endpoint = m_endpoints[index];
+    if(!endpoint.reactor || endpoint.queued) {
+      return;
+    }
+
+    endpoint.queued = true;
+    auto& reactor   = m_reactors[endpoint.reactor.value()];
+    reactor.ready.push_back(index);
+    Wake(reactor.host);
+  }
+
+  bool SimulatedNetwork::IsReadable(const Endpoint& endpoint) const {
+    switch(endpoint.state) {
+      case Endpoint::State::LISTENING:
+        return !endpoint.backlog.empty();
+      case Endpoint::State::CONNECTED:
+        return endpoint.inbox.size() > endpoint.inboxOffset || endpoint.peerClosed;
+      case Endpoint::State::REFUSED:
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  bool SimulatedNetwork::IsWritable(const Endpoint& endpoint) const {
+    return endpoint.state == Endpoint::State::CONNECTED || endpoint.state == Endpoint::State::REFUSED;
+  }
+}
\ No newline at end of file
@@ -0,0 +1,277 @@
+#ifndef KVM_TOOLS_SIM_NETWORK_H
+#define KVM_TOOLS_SIM_NETWORK_H
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <optional>
+#include <queue>
+#include <random>
+#include <unordered_map>
+#include <vector>
+#include <core/time.h>
+#include <networking/reactor.h>
+#include <networking/message/types.h>
+#include <platform/types.h>
+
+namespace kvm {
+  /**
+   * In-process stand-in for the network and the clock, which kvm_sim links in place of the platform
+   * socket, reactor and waker implementations. Time is virtual and only moves when the simulation runs
+   * out of work at the current instant, so a run is reproducible from its seed and takes as long as
+   * the work done rather than as long as the time simulated. Connections behave like TCP: bytes arrive
+   * in order after the link latency, a lost segment arrives one retransmission timeout late, and
+   * segments sent across a partition arrive once it heals.
+   */
+  class SimulatedNetwork {
+  public:
+
+    typedef Clock::time_point TimePoint;
+    typedef Clock::duration   Duration;
+
+    /**
+     * Link behaviour, applied to every segment.
+     */
+    struct Settings {
+      /// One-way delay
+      Duration  latency;
+      /// Upper bound of a uniformly distributed delay added to the latency
+      Duration  jitter;
+      /// Probability that a segment is lost and must be retransmitted
+      double    loss;
+      /// Delay added for each retransmission
+      Duration  retransmitTimeout;
+    };
+
+    /**
+     * Get the network that every simulated socket and reactor in the process shares.
+     */
+    static SimulatedNetwork& Shared();
+
+    /**
+     * Get the current virtual time. Installed as the Clock source by Install().
+     */
+    static TimePoint ReadClock();
+
+    /**
+     * Take over the Clock and seed the network's random number generator.
+     */
+    void Install(uint64_t seed);
+
+    /**
+     * Set the link behaviour.
+     */
+    void SetSettings(const Settings& settings);
+
+    /**
+     * Get the current virtual time.
+     */
+    TimePoint Now() const;
+
+    /**
+     * Get the network's random number generator, so that the simulation draws from the same seed.
+     */
+    std::mt19937_64& GetRandom();
+
+    /**
+     * Add a host with the given IPv4 address, in host byte order, and return its index.
+     */
+    size_t AddHost(uint32_t ip);
+
+    /**
+     * Get the address of the given host.
+     */
+    SocketAddress GetHostAddress(size_t host, uint16_t port) const;
+
+    /**
+     * Set the host whose code is running. Sockets and reactors created from now on belong to it.
+     */
+    void SetCurrentHost(size_t host);
+
+    /**
+     * Cut hosts below the given index off from the rest for the given window of virtual time.
+     */
+    void AddPartition(TimePoint start, TimePoint end, size_t split);
+
+    /**
+     * Run an action at the given virtual time.
+     */
+    void Schedule(TimePoint at, std::function<void()> action);
+
+    /**
+     * Mark a host as having work to do at the current instant, so that it's pumped.
+     */
+    void Wake(size_t host);
+
+    /**
+     * Take the hosts that need pumping at the current instant.
+     */
+    std::vector<size_t> TakeRunnableHosts();
+
+    /**
+     * Advance to the next scheduled instant, if it's no later than the given limit, and run every
+     * action due then. Returns false if there's nothing left to do before the limit.
+     */
+    bool RunNext(TimePoint limit);
+
+    /**
+     * Count a message going out onto the network.
+     */
+    void CountMessage(NetworkMessage::Type type);
+
+    /**
+     * Get the number of messages of the given type sent over the network.
+     */
+    uint64_t GetMessageCount(NetworkMessageType type) const;
+
+    /**
+     * Get the number of bytes sent over the network, including framing.
+     */
+    uint64_t GetByteCount() const;
+
+    // Socket operations, called by the simulated platform.
+    PlatformSocket Listen(uint16_t port);
+    PlatformSocket Connect(const SocketAddress& address);
+    std::optional<std::pair<PlatformSocket, SocketAddress>> Accept(PlatformSocket listener);
+    bool IsConnected(PlatformSocket socket) const;
+    bool Write(PlatformSocket socket, const uint8_t* data, size_t size);
+    std::optional<size_t> Read(PlatformSocket socket, uint8_t* data, size_t size);
+    void Close(PlatformSocket socket);
+
+    // Reactor operations, called by the simulated platform.
+    PlatformReactor CreateReactor();
+    void Register(PlatformReactor reactor, PlatformSocket socket, Reactor::Handler* handler, uint8_t interest);
+    void Deregister(PlatformReactor reactor, PlatformSocket socket);
+    size_t Poll(PlatformReactor reactor, std::chrono::milliseconds timeout);
+
+  private:
+
+    SimulatedNetwork();
+
+    /**
+     * One end of a connection, or a listening socket.
+     */
+    struct Endpoint {
+      enum class State {
+        LISTENING,
+        CONNECTING,
+        CONNECTED,
+        REFUSED,
+        CLOSED
+      };
+
+      State                   state;
+      size_t                  host;
+      SocketAddress           local;
+      SocketAddress           remote;
+      /// Other end of the connection, once known
+      std::optional<size_t>   peer;
+      /// Bytes that have arrived and not yet been read
+      std::vector<uint8_t>    inbox;
+      size_t                  inboxOffset;
+      /// Whether the other end has closed the connection
+      bool                    peerClosed;
+      /// Connections waiting to be accepted, for listening sockets
+      std::deque<size_t>      backlog;
+      /// Arrival time of the last segment sent to this endpoint, which later segments can't overtake
+      TimePoint               lastArrival;
+      /// Reactor watching this endpoint, if any
+      std::optional<size_t>   reactor;
+      Reactor::Handler*       handler;
+      uint8_t                 interest;
+      /// Whether the endpoint is in its reactor's ready list
+      bool                    queued;
+    };
+
+    struct Host {
+      uint32_t  ip;
+      bool      runnable;
+      /// Bumped whenever the host's next wake-up is rescheduled, so that earlier wake-ups are ignored
+      uint64_t  wakeGeneration;
+    };
+
+    struct SimulatedReactor {
+      size_t              host;
+      std::vector<size_t> ready;
+    };
+
+    struct Partition {
+      TimePoint start;
+      TimePoint end;
+      size_t    split;
+    };
+
+    struct ScheduledAction {
+      TimePoint             at;
+      uint64_t              sequence;
+      std::function<void()> action;
+
+      bool operator>(const ScheduledAction& other) const {
+        return at > other.at || (at == other.at && sequence > other.sequence);
+      }
+    };
+
+    /**
+     * Get the endpoint behind a socket handle, or nullptr if it isn't one of ours.
+     */
+    Endpoint* Find(PlatformSocket socket);
+    const Endpoint* Find(PlatformSocket socket) const;
+
+    /**
+     * Work out when a segment sent now from one host to another arrives, no earlier than the given
+     * time so that segments on one connection stay in order.
+     */
+    TimePoint Transit(size_t from, size_t to, TimePoint notBefore);
+
+    /**
+     * Schedule an action to happen when a segment sent now reaches the given endpoint.
+     */
+    void Deliver(size_t from, size_t to, std::function<void()> action);
+
+    /**
+     * Put an endpoint on its reactor's ready list if its readiness might have changed.
+     */
+    void MarkReady(size_t endpoint);
+
+    /**
+     * Determine whether an endpoint has something to report for the given interest.
+     */
+    bool IsReadable(const Endpoint& endpoint) const;
+    bool IsWritable(const Endpoint& endpoint) const;
+
+    /// Current virtual time
+    TimePoint m_now;
+    /// Link behaviour
+    Settings m_settings;
+    /// Drives jitter, loss and the simulation's own choices
+    std::mt19937_64 m_random;
+    /// Hosts, by index
+    std::vector<Host> m_hosts;
+    /// Host whose code is running
+    size_t m_currentHost;
+    /// Endpoints, by handle less the handle base. Never reused.
+    std::vector<Endpoint> m_endpoints;
+    /// Listening endpoint at each IP address and port, in host byte order
+    std::unordered_map<uint64_t, size_t> m_listeners;
+    /// Next ephemeral port to hand out on each host
+    std::vector<uint16_t> m_nextPort;
+    /// Reactors, by handle
+    std::vector<SimulatedReactor> m_reactors;
+    /// Scripted partitions
+    std::vector<Partition> m_partitions;
+    /// Actions to run, soonest first
+    std::priority_queue<ScheduledAction, std::vector<ScheduledAction>, std::greater<ScheduledAction>> m_schedule;
+    /// Breaks ties between actions scheduled for the same instant in the order they were scheduled
+    uint64_t m_sequence;
+    /// Hosts with work to do at the current instant
+    std::vector<size_t> m_runnable;
+    /// Messages sent, by type
+    std::array<uint64_t, NetworkMessageTypeCount> m_messages;
+    /// Bytes sent
+    uint64_t m_bytes;
+  };
+}
+
+#endif // KVM_TOOLS_SIM_NETWORK_H
\ No newline at end of file
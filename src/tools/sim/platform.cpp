@@ -0,0 +1,217 @@
+#include "network.h"
+#include <networking/socket.h>
+#include <networking/reactor.h>
+#include <networking/waker.h>
+#include <platform/functions.h>
+#include <arpa/inet.h>
+#include <cstring>
+#include <vector>
+
+#define RECEIVE_CHUNK_SIZE 2048
+
+/**
+ * Socket, reactor and waker implementations that run over the simulated network rather than the
+ * operating system's. Linked into kvm_sim in place of the platform implementations.
+ */
+
+namespace kvm {
+  Socket::Socket() :
+  m_socket(-1),
+  m_state(Socket::SocketState::DISCONNECTED),
+  m_receiveFrame(0),
+  m_receiveLength(0)
+  {}
+
+  Socket::Socket(PlatformSocket socket, SocketAddress address) :
+  m_socket(socket),
+  m_address(address),
+  m_state(Socket::SocketState::CONNECTED),
+  m_receiveFrame(0),
+  m_receiveLength(0)
+  {}
+
+  Socket::ConnectResult Socket::Connect(const SocketAddress& address) {
+    if(m_state != Socket::SocketState::DISCONNECTED) {
+      Disconnect();
+    }
+
+    m_socket  = SimulatedNetwork::Shared().Connect(address);
+    m_state   = Socket::SocketState::CONNECTING;
+    m_address = address;
+    return Socket::ConnectResult();
+  }
+
+  Socket::ConnectResult Socket::CompleteConnect() {
+    if(m_state != Socket::SocketState::CONNECTING) {
+      return Socket::ConnectResult(Socket::SocketError::INITIALIZATION_ERROR);
+    }
+
+    if(!SimulatedNetwork::Shared().IsConnected(m_socket)) {
+      Disconnect();
+      return Socket::ConnectResult(Socket::SocketError::CONNECT_ERROR);
+    }
+
+    m_state = Socket::SocketState::CONNECTED;
+    return Socket::ConnectResult();
+  }
+
+  Socket::ListenResult Socket::Listen(uint16_t port) {
+    if(m_state != Socket::SocketState::DISCONNECTED) {
+      Disconnect();
+    }
+
+    m_socket = SimulatedNetwork::Shared().Listen(port);
+    if(m_socket == -1) {
+      return Socket::ListenResult(Socket::SocketError::BIND_ERROR);
+    }
+
+    m_state = Socket::SocketState::LISTENING;
+    return Socket::ListenResult();
+  }
+
+  Socket::AcceptResult Socket::Accept() const {
+    if(m_state == Socket::SocketState::LISTENING) {
+      auto accepted = SimulatedNetwork::Shared().Accept(m_socket);
+      if(accepted) {
+        return Socket::AcceptResult(Socket(accepted->first, accepted->second));
+      }
+    }
+    return Socket::AcceptResult();
+  }
+
+  std::optional<size_t> Socket::SendPartial(const NetworkBuffer& buffer, size_t offset) {
+    if(m_state != Socket::SocketState::CONNECTED || buffer.GetSize() == 0 || !buffer || offset >= GetFrameSize(buffer)) {
+      return std::nullopt;
+    }
+
+    // Simulated send buffers never fill, so the rest of the frame always goes in one segment.
+    uint32_t header = HostToNetwork(static_cast<uint32_t>(buffer.GetSize()));
+    std::vector<uint8_t> frame(GetFrameSize(buffer));
+    memcpy(frame.data(), &header, sizeof(header));
+    memcpy(frame.data() + sizeof(header), buffer.GetBuffer(), buffer.GetSize());
+
+    auto& network = SimulatedNetwork::Shared();
+    if(!network.Write(m_socket, frame.data() + offset, frame.size() - offset)) {
+      return std::nullopt;
+    }
+
+    if(offset == 0) {
+      network.CountMessage(buffer.GetBuffer()[0]);
+    }
+    return frame.size() - offset;
+  }
+
+  bool Socket::Receive() {
+    if(m_state != Socket::SocketState::CONNECTED) {
+      return false;
+    }
+
+    m_receiveBuffer.Window(0, m_receiveLength).Reserve(m_receiveLength + RECEIVE_CHUNK_SIZE);
+
+    auto received = SimulatedNetwork::Shared().Read(m_socket, m_receiveBuffer.GetBuffer() + m_receiveLength, m_receiveBuffer.GetCapacity() - m_receiveLength);
+    if(!received) {
+      return false;
+    }
+
+    m_receiveLength += received.value();
+    return IsFrameValid();
+  }
+
+  void Socket::Disconnect() {
+    if(m_state != Socket::SocketState::DISCONNECTED) {
+      SimulatedNetwork::Shared().Close(m_socket);
+      m_socket  = -1;
+      m_state   = Socket::SocketState::DISCONNECTED;
+    }
+    m_receiveFrame  = 0;
+    m_receiveLength = 0;
+  }
+
+  Socket::GetAddressResult Socket::GetAddressForIP(int ip, uint16_t port) {
+    SocketAddress address = {};
+    address.sin_addr.s_addr = ip;
+    address.sin_family      = AF_INET;
+    address.sin_port        = HostToNetwork(port);
+    return Socket::GetAddressResult(address);
+  }
+
+  Socket::GetAddressResult Socket::GetAddressForHostname(const Socket::HostName& hostname, uint16_t port) {
+    // There's no DNS in the simulation; hosts are only known by their addresses.
+    return ParseAddress(hostname, port);
+  }
+
+  Socket::GetAddressResult Socket::ParseAddress(const Socket::HostName& hostname, uint16_t port) {
+    SocketAddress address = {};
+    address.sin_family  = AF_INET;
+    address.sin_port    = HostToNetwork(port);
+
+    if(inet_pton(AF_INET, hostname.c_str(), &address.sin_addr) != 1) {
+      return Socket::GetAddressResult(Socket::SocketError::DNS_ERROR);
+    }
+    return Socket::GetAddressResult(address);
+  }
+
+  Socket::~Socket()
+  {}
+
+  Reactor::Reactor() :
+  m_reactor(-1)
+  {}
+
+  bool Reactor::Initialize() {
+    if(m_reactor == -1) {
+      m_reactor = SimulatedNetwork::Shared().CreateReactor();
+    }
+    return true;
+  }
+
+  bool Reactor::Register(PlatformSocket socket, Reactor::Handler* handler, uint8_t interest) {
+    SimulatedNetwork::Shared().Register(m_reactor, socket, handler, interest);
+    return true;
+  }
+
+  bool Reactor::Modify(PlatformSocket socket, Reactor::Handler* handler, uint8_t interest) {
+    SimulatedNetwork::Shared().Register(m_reactor, socket, handler, interest);
+    return true;
+  }
+
+  void Reactor::Deregister(PlatformSocket socket) {
+    SimulatedNetwork::Shared().Deregister(m_reactor, socket);
+  }
+
+  size_t Reactor::Poll(std::chrono::milliseconds timeout) {
+    return SimulatedNetwork::Shared().Poll(m_reactor, timeout);
+  }
+
+  Reactor::~Reactor()
+  {}
+
+  // The simulation runs every host on one thread, so there's never another thread to wake a host from.
+  Waker::Waker() :
+  m_reactor(nullptr),
+  m_receiver(-1),
+  m_sender(-1),
+  m_pending(false),
+  m_open(false)
+  {}
+
+  bool Waker::Open(Reactor& reactor) {
+    m_reactor = &reactor;
+    m_open    = true;
+    return true;
+  }
+
+  void Waker::Wake()
+  {}
+
+  void Waker::OnReadable()
+  {}
+
+  void Waker::Close() {
+    m_reactor = nullptr;
+    m_open    = false;
+  }
+
+  Waker::~Waker()
+  {}
+}
\ No newline at end of file
@@ -3,6 +3,26 @@
 #include <kvm.h>
 #include <networking/message/types.h>
 #include <networking/message/change_input_request.h>
+#include <networking/message/change_input_response.h>
+#include <networking/message/heartbeat.h>
+#include <networking/pool.h>
+#include <networking/multicast.h>
+#include <networking/message/multicast_ack.h>
+#include <networking/message/hello.h>
+#include <networking/message/display_announcement.h>
+#include <networking/message/registry.h>
+#include <networking/failure_detector.h>
+#include <networking/lease.h>
+#include <networking/resolver.h>
+#include <networking/capture.h>
+#include <core/histogram.h>
+#include <core/time.h>
+#include <core/slot_map.h>
+#include <core/spsc_ring.h>
+#include <algorithm>
+#include <functional>
+#include <random>
+#include <thread>
 
 using namespace kvm;
 
@@ -13,7 +33,8 @@ TEST_CASE("messages are serialized and deserialized correctly", "[networking]")
   Display::InputMap changes;
   changes[display] = Display::Input::HDMI1;
   
-  ChangeInputRequest in(changes);
+  ChangeInputRequest in(7, changes);
+  in.SetFences({{2222, 5}});
   in.Serialize(buffer);
 
   buffer.Reset();
@@ -23,8 +44,838 @@ TEST_CASE("messages are serialized and deserialized correctly", "[networking]")
   ChangeInputRequest out;
   out.Deserialize(buffer);
 
+  REQUIRE(out.GetId() == 7);
   REQUIRE(out.GetInputMap().size() == 1);
   REQUIRE(out.GetInputMap().begin()->first == display);
   REQUIRE(out.GetInputMap().begin()->second == Display::Input::HDMI1);
+  REQUIRE(out.GetFences() == ChangeInputRequest::FenceMap{{2222, 5}});
 
+}
+
+TEST_CASE("responses carry their request ID, results and timing", "[networking]") {
+  NetworkBuffer buffer;
+
+  ChangeInputResponse::ResultMap results;
+  results[Display("GSM", 1111, 2222, "Test Display")] = true;
+  results[Display("DEL", 3333, 4444, "Other Display")] = false;
+
+  ChangeInputResponse in(42, results, std::chrono::microseconds(1500));
+  in.SetLeases({{4444, LeaseResult{LeaseDecision::HELD, 9, 0x123456789ABCDEF0, std::chrono::milliseconds(1000)}}});
+  REQUIRE(in.Serialize(buffer));
+
+  buffer.Reset();
+
+  ChangeInputResponse out;
+  REQUIRE(out.Deserialize(buffer));
+  REQUIRE(out.GetRequestId() == 42);
+  REQUIRE(out.GetElapsed() == std::chrono::microseconds(1500));
+  REQUIRE(out.GetResultMap() == results);
+  REQUIRE(out.GetLeases().size() == 1);
+  REQUIRE(out.GetLeases().at(4444).decision == LeaseDecision::HELD);
+  REQUIRE(out.GetLeases().at(4444).token == 9);
+  REQUIRE(out.GetLeases().at(4444).holder == 0x123456789ABCDEF0);
+  REQUIRE(out.GetLeases().at(4444).term == std::chrono::milliseconds(1000));
+}
+TEST_CASE("strings are read as views into the buffer", "[networking]") {
+  NetworkBuffer buffer;
+  buffer << std::string("office-desktop") << std::string_view("hdmi1");
+  buffer.Reset();
+
+  std::string_view name;
+  std::string input;
+  REQUIRE(buffer >> name >> input);
+  REQUIRE(name == "office-desktop");
+  REQUIRE(input == "hdmi1");
+
+  auto start = reinterpret_cast<const char*>(buffer.GetBuffer());
+  REQUIRE(name.data() > start);
+  REQUIRE(name.data() + name.size() <= start + buffer.GetSize());
+
+  // A length that runs past the end of the buffer fails without reading.
+  NetworkBuffer truncated;
+  truncated << Varint(uint32_t(64)) << static_cast<uint8_t>('x');
+  truncated.Reset();
+  REQUIRE_FALSE(truncated >> name);
+}
+
+TEST_CASE("buffers grow on demand and reuse pooled storage", "[networking]") {
+  Display::InputMap changes;
+  for(Display::SerialNumber serial = 0; serial < 2000; serial++) {
+    changes[Display(serial)] = Display::Input::DP2;
+  }
+
+  {
+    NetworkBuffer buffer;
+    REQUIRE(ChangeInputRequest(1, changes).Serialize(buffer));
+    REQUIRE(buffer.GetSize() > 2048);
+
+    NetworkBuffer moved(std::move(buffer));
+    REQUIRE(buffer.GetSize() == 0);
+    moved.Reset();
+
+    ChangeInputRequest out;
+    REQUIRE(out.Deserialize(moved));
+    REQUIRE(out.GetInputMap() == changes);
+  }
+
+  auto cached = BufferPool::Local().GetCachedSegmentCount();
+  REQUIRE(cached > 0);
+
+  {
+    NetworkBuffer buffer;
+    Heartbeat().Serialize(buffer);
+    REQUIRE(buffer.GetCapacity() == BufferPool::MinSegmentSize);
+    REQUIRE(BufferPool::Local().GetCachedSegmentCount() == cached - 1);
+  }
+
+  REQUIRE(BufferPool::Local().GetCachedSegmentCount() == cached);
+}
+
+TEST_CASE("messages are read in place from a window over a larger buffer", "[networking]") {
+  NetworkBuffer buffer;
+
+  Display::InputMap changes;
+  changes[Display(1111)] = Display::Input::HDMI2;
+
+  buffer << static_cast<uint32_t>(0xDEADBEEF);
+  ChangeInputRequest(1, changes).Serialize(buffer);
+  auto size = buffer.GetSize();
+  buffer << static_cast<uint32_t>(0xDEADBEEF);
+
+  buffer.Window(sizeof(uint32_t), size - sizeof(uint32_t));
+
+  REQUIRE(buffer.GetOffset() == 0);
+  REQUIRE(NetworkMessage::IsContainedIn(static_cast<NetworkMessage::Type>(NetworkMessageType::CHANGE_INPUT_REQUEST), buffer));
+
+  // Copies take just the window.
+  NetworkBuffer copy(buffer);
+  REQUIRE(copy.GetSize() == buffer.GetSize());
+  REQUIRE(std::equal(copy.GetBuffer(), copy.GetBuffer() + copy.GetSize(), buffer.GetBuffer()));
+
+  ChangeInputRequest out;
+  REQUIRE(out.Deserialize(buffer));
+  REQUIRE(buffer.GetRemaining() == 0);
+  REQUIRE(out.GetInputMap().at(Display(1111)) == Display::Input::HDMI2);
+}
+
+TEST_CASE("varints use as few bytes as their value needs", "[networking]") {
+  NetworkBuffer buffer;
+  buffer << Varint(uint32_t(0)) << Varint(uint32_t(127)) << Varint(uint32_t(128)) << Varint(UINT64_MAX);
+  REQUIRE(buffer.GetSize() == 1 + 1 + 2 + 10);
+
+  buffer.Reset();
+
+  uint32_t a, b, c;
+  uint64_t d;
+  REQUIRE(buffer >> Varint(a) >> Varint(b) >> Varint(c) >> Varint(d));
+  REQUIRE(a == 0);
+  REQUIRE(b == 127);
+  REQUIRE(c == 128);
+  REQUIRE(d == UINT64_MAX);
+
+  // Values too large for the field being read are rejected.
+  NetworkBuffer wide;
+  wide << Varint(uint32_t(300));
+  wide.Reset();
+  uint8_t narrow;
+  REQUIRE_FALSE(wide >> Varint(narrow));
+
+  // A typical single-display request fits in a handful of bytes.
+  Display::InputMap changes;
+  changes[Display(1111)] = Display::Input::HDMI2;
+  NetworkBuffer request;
+  REQUIRE(ChangeInputRequest(1, changes).Serialize(request));
+  REQUIRE(request.GetSize() <= 6);
+}
+
+struct DispatchCounter {
+  int heartbeats = 0;
+  int hellos = 0;
+  NodeId lastId = 0;
+
+  void OnMessage(const Heartbeat& heartbeat, int weight) { heartbeats += weight; }
+  void OnMessage(const Hello& hello, int weight) { hellos += weight; lastId = hello.GetIdentity().GetId(); }
+};
+
+TEST_CASE("messages are dispatched to the handler for their type", "[networking]") {
+  typedef MessageDispatcher<DispatchCounter, NetworkMessageType::HEARTBEAT, NetworkMessageType::HELLO> Dispatcher;
+  DispatchCounter counter;
+
+  NodeIdentity identity;
+  identity.SetId(99);
+
+  NetworkBuffer hello;
+  REQUIRE(Hello(identity).Serialize(hello));
+  hello.Reset();
+  REQUIRE(Dispatcher::Dispatch(hello, counter, 2));
+  REQUIRE(counter.hellos == 2);
+  REQUIRE(counter.lastId == 99);
+
+  NetworkBuffer heartbeat;
+  REQUIRE(Heartbeat().Serialize(heartbeat));
+  heartbeat.Reset();
+  REQUIRE(Dispatcher::Dispatch(heartbeat, counter, 1));
+  REQUIRE(counter.heartbeats == 1);
+
+  // Types the dispatcher doesn't handle are left in the buffer for someone else.
+  NetworkBuffer request;
+  REQUIRE(ChangeInputRequest(1, Display::InputMap()).Serialize(request));
+  request.Reset();
+  REQUIRE_FALSE(Dispatcher::Dispatch(request, counter, 1));
+  REQUIRE(request.GetOffset() == 0);
+  REQUIRE(NetworkMessage::IsContainedIn(static_cast<NetworkMessage::Type>(NetworkMessageType::CHANGE_INPUT_REQUEST), request));
+
+  // A failed peek doesn't spoil the buffer.
+  NetworkBuffer empty;
+  uint32_t value;
+  REQUIRE_FALSE(empty.Peek(value));
+  REQUIRE(empty);
+  REQUIRE_FALSE(Dispatcher::Dispatch(empty, counter, 1));
+}
+
+TEST_CASE("only messages that fit in a datagram are sent over multicast", "[networking]") {
+  Display::InputMap changes;
+  changes[Display(1111)] = Display::Input::HDMI2;
+
+  NetworkBuffer small;
+  ChangeInputRequest(1, changes).Serialize(small);
+  REQUIRE(MulticastChannel::CanCarry(small));
+
+  for(int i = 0; i < 1000; i++) {
+    changes[Display(i)] = Display::Input::DP1;
+  }
+
+  NetworkBuffer large;
+  ChangeInputRequest(1, changes).Serialize(large);
+  REQUIRE_FALSE(MulticastChannel::CanCarry(large));
+
+  MulticastChannel channel;
+  REQUIRE_FALSE(channel.Send(small).has_value());
+
+  NetworkBuffer buffer;
+  MulticastAck(42, 0xFEDCBA9876543210ULL).Serialize(buffer);
+  buffer.Reset();
+
+  MulticastAck ack;
+  REQUIRE(ack.Deserialize(buffer));
+  REQUIRE(ack.GetSequence() == 42);
+  REQUIRE(ack.GetNodeId() == 0xFEDCBA9876543210ULL);
+}
+
+TEST_CASE("hello messages carry the full node ID and feature bitmask", "[networking]") {
+  NodeIdentity identity(0xFEDCBA9876543210ULL);
+  identity.SetFeature(NodeFeature::MULTICAST, true);
+
+  NetworkBuffer buffer;
+  REQUIRE(Hello(identity).Serialize(buffer));
+  buffer.Reset();
+
+  Hello hello;
+  REQUIRE(hello.Deserialize(buffer));
+  REQUIRE(hello.GetIdentity().GetId() == 0xFEDCBA9876543210ULL);
+  REQUIRE(hello.GetIdentity().HasFeature(NodeFeature::MULTICAST));
+}
+
+TEST_CASE("beacons advertise a node's ID, port and displays", "[networking]") {
+  NetworkBuffer buffer;
+  REQUIRE(Beacon(0x123456789ABCDEF0ULL, 10191, {1111, 2222, 3333}).Serialize(buffer));
+  REQUIRE(buffer.GetSize() <= DatagramSocket::MaxPayloadSize);
+
+  buffer.Reset();
+
+  Beacon out;
+  REQUIRE(out.Deserialize(buffer));
+  REQUIRE(out.GetProtocolVersion() == NetworkMessage::ProtocolVersion);
+  REQUIRE(out.GetNodeId() == 0x123456789ABCDEF0ULL);
+  REQUIRE(out.GetPort() == 10191);
+  REQUIRE(out.GetDisplays() == std::vector<Display::SerialNumber>{1111, 2222, 3333});
+}
+
+TEST_CASE("display announcements carry whole sets and changes", "[networking]") {
+  NetworkBuffer buffer;
+  REQUIRE(DisplayAnnouncement(false, {1111, 2222}, {3333}).Serialize(buffer));
+  buffer.Reset();
+
+  DisplayAnnouncement out(true, {});
+  REQUIRE(out.Deserialize(buffer));
+  REQUIRE_FALSE(out.IsComplete());
+  REQUIRE(out.GetAdded() == std::vector<Display::SerialNumber>{1111, 2222});
+  REQUIRE(out.GetRemoved() == std::vector<Display::SerialNumber>{3333});
+}
+
+/**
+ * Find a port that nothing is listening on, starting from a random one so that test runs in parallel
+ * don't contend for the same ports.
+ */
+uint16_t FindFreePort() {
+  static std::minstd_rand random(std::random_device{}());
+  while(true) {
+    uint16_t port = 20000 + random() % 20000;
+    Socket probe;
+    if(!probe.Listen(port).has_value()) {
+      probe.Disconnect();
+      return port;
+    }
+  }
+}
+
+/**
+ * A cluster on its own free port that applies every change it's asked for straight away, and counts
+ * the requests it receives and the outcomes of the requests it sends.
+ */
+struct Desk : public Cluster::Listener {
+  uint16_t port;
+  Cluster cluster;
+  std::vector<Display::InputMap> requests;
+  size_t completed = 0;
+  size_t succeeded = 0;
+
+  Desk() : port(FindFreePort()), cluster(port) {
+    cluster.SetCoalesceWindow(std::chrono::milliseconds(0));
+    cluster.AddListener(this);
+  }
+
+  virtual void OnInputChangeRequested(const Node& sender, ChangeInputRequest::RequestId id, const Display::InputMap& changes) override {
+    requests.push_back(changes);
+    std::map<Display, bool> results;
+    for(auto &change : changes) {
+      results[change.first] = true;
+    }
+    cluster.RespondToInputChangeRequest(sender, id, results, std::chrono::microseconds(0));
+  }
+
+  virtual void OnInputChangeResponse(const Node& sender, ChangeInputRequest::RequestId id, const std::map<Display, bool>& results, std::chrono::microseconds elapsed) override {}
+
+  virtual void OnInputChangeCompleted(ChangeInputRequest::RequestId id, bool success, std::chrono::microseconds latency) override {
+    completed++;
+    succeeded += success ? 1 : 0;
+  }
+};
+
+/**
+ * Pump every desk until the condition holds or enough rounds have passed that it never will.
+ */
+bool PumpUntil(const std::vector<Desk*>& desks, std::function<bool()> done) {
+  for(int i = 0; i < 500 && !done(); i++) {
+    for(auto desk : desks) {
+      desk->cluster.Pump(desk == desks.back() ? std::chrono::milliseconds(1) : std::chrono::milliseconds(0));
+    }
+  }
+  return done();
+}
+
+TEST_CASE("input changes are only sent to the nodes that own the displays", "[networking]") {
+  Desk requester, left, right;
+  REQUIRE(requester.cluster.Initialize());
+  REQUIRE(left.cluster.Initialize());
+  REQUIRE(right.cluster.Initialize());
+
+  left.cluster.SetDisplays({1111});
+  right.cluster.SetDisplays({2222, 3333});
+  requester.cluster.AddNode("127.0.0.1", left.port);
+  requester.cluster.AddNode("127.0.0.1", right.port);
+
+  std::vector<Desk*> desks = {&requester, &left, &right};
+  REQUIRE(PumpUntil(desks, [&]() { return !requester.cluster.GetDisplayOwners(1111).empty() && requester.cluster.GetDisplayOwners(3333).size() == 1; }));
+
+  Display::InputMap changes;
+  changes[Display(1111)] = Display::Input::DP1;
+  requester.cluster.RequestInputChange(changes);
+  REQUIRE(PumpUntil(desks, [&]() { return requester.completed == 1; }));
+  REQUIRE(left.requests.size() == 1);
+  REQUIRE(right.requests.empty());
+
+  // Detached displays are no longer sent changes, and neither are displays nobody has announced.
+  right.cluster.SetDisplays({2222});
+  REQUIRE(PumpUntil(desks, [&]() { return requester.cluster.GetDisplayOwners(3333).empty(); }));
+
+  changes.clear();
+  changes[Display(2222)] = Display::Input::HDMI1;
+  changes[Display(3333)] = Display::Input::HDMI1;
+  requester.cluster.RequestInputChange(changes);
+  REQUIRE(PumpUntil(desks, [&]() { return requester.completed == 2; }));
+  REQUIRE(left.requests.size() == 1);
+  REQUIRE(right.requests.size() == 1);
+  REQUIRE(right.requests[0].size() == 1);
+  REQUIRE(right.requests[0].count(Display(2222)) == 1);
+}
+
+TEST_CASE("requests made within the coalescing window go out as one", "[networking]") {
+  Desk requester, left, right;
+  REQUIRE(requester.cluster.Initialize());
+  REQUIRE(left.cluster.Initialize());
+  REQUIRE(right.cluster.Initialize());
+
+  left.cluster.SetDisplays({1111});
+  right.cluster.SetDisplays({2222});
+  requester.cluster.AddNode("127.0.0.1", left.port);
+  requester.cluster.AddNode("127.0.0.1", right.port);
+
+  std::vector<Desk*> desks = {&requester, &left, &right};
+  REQUIRE(PumpUntil(desks, [&]() { return !requester.cluster.GetDisplayOwners(1111).empty() && !requester.cluster.GetDisplayOwners(2222).empty(); }));
+
+  requester.cluster.SetCoalesceWindow(std::chrono::milliseconds(100));
+
+  Display::InputMap first, second;
+  first[Display(1111)]  = Display::Input::DP1;
+  first[Display(2222)]  = Display::Input::DP1;
+  second[Display(1111)] = Display::Input::HDMI1;
+
+  auto id = requester.cluster.RequestInputChange(first);
+  REQUIRE(requester.cluster.RequestInputChange(second) == id);
+  REQUIRE(PumpUntil(desks, [&]() { return requester.completed == 1; }));
+  REQUIRE(requester.succeeded == 1);
+
+  // Each peer hears one request, carrying the last change asked for each of its displays.
+  REQUIRE(left.requests.size() == 1);
+  REQUIRE(left.requests[0].at(Display(1111)) == Display::Input::HDMI1);
+  REQUIRE(right.requests.size() == 1);
+  REQUIRE(right.requests[0].at(Display(2222)) == Display::Input::DP1);
+}
+
+TEST_CASE("display leases go to the first requester and fence out stale requests", "[networking]") {
+  LeaseTable leases(std::chrono::milliseconds(1000));
+  auto now = LeaseTable::Clock::now();
+
+  auto first = leases.Acquire(1111, 1, 1, 0, now);
+  REQUIRE(first.decision == LeaseDecision::GRANTED);
+  REQUIRE(first.holder == 1);
+
+  // A desk that triggers at the same moment is refused until the lease lapses.
+  auto second = leases.Acquire(1111, 2, 1, 0, now);
+  REQUIRE(second.decision == LeaseDecision::HELD);
+  REQUIRE(second.holder == 1);
+
+  // The holder renews with its token, but not with a copy of a request it has already made.
+  REQUIRE(leases.Acquire(1111, 1, 1, first.token, now).decision == LeaseDecision::STALE);
+  auto renewed = leases.Acquire(1111, 1, 2, first.token, now);
+  REQUIRE(renewed.decision == LeaseDecision::GRANTED);
+  REQUIRE(renewed.token > first.token);
+
+  // Once the lease lapses another desk takes it, and a request delayed from the old lease is fenced out.
+  now += std::chrono::milliseconds(1500);
+  auto taken = leases.Acquire(1111, 2, 2, 0, now);
+  REQUIRE(taken.decision == LeaseDecision::GRANTED);
+  REQUIRE(taken.token > renewed.token);
+  now += std::chrono::milliseconds(1500);
+  REQUIRE(leases.Acquire(1111, 1, 3, renewed.token, now).decision == LeaseDecision::STALE);
+  REQUIRE(leases.Acquire(1111, 1, 4, 0, now).decision == LeaseDecision::GRANTED);
+
+  // A desk that restarts numbers its requests from one again.
+  REQUIRE(leases.Acquire(1111, 1, 1, 0, now).decision == LeaseDecision::STALE);
+  leases.ResetRequestOrder(1);
+  REQUIRE(leases.Acquire(1111, 1, 1, 0, now).decision == LeaseDecision::GRANTED);
+}
+
+TEST_CASE("desks that trigger at the same time don't both switch a display", "[networking]") {
+  Desk owner, left, right;
+  REQUIRE(owner.cluster.Initialize());
+  REQUIRE(left.cluster.Initialize());
+  REQUIRE(right.cluster.Initialize());
+
+  owner.cluster.SetDisplays({1111});
+  left.cluster.AddNode("127.0.0.1", owner.port);
+  right.cluster.AddNode("127.0.0.1", owner.port);
+
+  std::vector<Desk*> desks = {&left, &right, &owner};
+  REQUIRE(PumpUntil(desks, [&]() { return !left.cluster.GetDisplayOwners(1111).empty() && !right.cluster.GetDisplayOwners(1111).empty(); }));
+
+  Display::InputMap changes;
+  changes[Display(1111)] = Display::Input::DP1;
+  left.cluster.RequestInputChange(changes);
+  changes[Display(1111)] = Display::Input::HDMI1;
+  right.cluster.RequestInputChange(changes);
+
+  REQUIRE(PumpUntil(desks, [&]() { return left.completed == 1 && right.completed == 1; }));
+  REQUIRE(owner.requests.size() == 1);
+  REQUIRE(left.succeeded + right.succeeded == 1);
+
+  // The winner keeps switching under its lease.
+  auto& winner = left.succeeded == 1 ? left : right;
+  winner.cluster.RequestInputChange(changes);
+  REQUIRE(PumpUntil(desks, [&]() { return winner.completed == 2; }));
+  REQUIRE(owner.requests.size() == 2);
+  REQUIRE(winner.succeeded == 2);
+}
+
+TEST_CASE("resolver answers from its cache without blocking", "[networking]") {
+  Resolver resolver(std::chrono::milliseconds(50), std::chrono::milliseconds(50));
+
+  // Numeric addresses are answered on the spot.
+  auto numeric = resolver.Lookup("127.0.0.1", 10191);
+  REQUIRE(numeric);
+  REQUIRE(AddressToString(numeric.value()) == "127.0.0.1");
+  REQUIRE(NetworkToHost(numeric->sin_port) == 10191);
+
+  // Names are resolved in the background, so the first lookup may come back empty.
+  std::optional<SocketAddress> named;
+  for(int i = 0; i < 200 && !named; i++) {
+    named = resolver.Lookup("localhost", 10192);
+    if(!named) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  }
+  REQUIRE(named);
+  REQUIRE(NetworkToHost(named->sin_port) == 10192);
+
+  // A stale address is still returned while it's being refreshed.
+  resolver.Invalidate("localhost");
+  REQUIRE(resolver.Lookup("localhost", 10192));
+}
+
+TEST_CASE("captures play back the recorded messages in order", "[networking]") {
+  const char* path = "kvm_test_capture.bin";
+
+  auto peer = Socket::GetAddressForHostname("10.0.0.7", 10191);
+  REQUIRE(peer.DidSucceed());
+
+  Display::InputMap changes;
+  changes[Display(1111)] = Display::Input::HDMI2;
+
+  NetworkBuffer heartbeat, request;
+  Heartbeat().Serialize(heartbeat);
+  ChangeInputRequest(9, changes).Serialize(request);
+
+  // Records can be read back once flushed, while the capture is still being written.
+  CaptureWriter writer;
+  REQUIRE(writer.Open(path));
+  writer.Write(CapturedMessage::Direction::RECEIVED, peer.GetValue(), heartbeat);
+  writer.Write(CapturedMessage::Direction::SENT, peer.GetValue(), request);
+  writer.Flush();
+
+  CaptureReader reader;
+  REQUIRE(reader.Open(path));
+
+  CapturedMessage record;
+  REQUIRE(reader.Next(record));
+  REQUIRE(record.direction == CapturedMessage::Direction::RECEIVED);
+  REQUIRE(record.peer.sin_addr.s_addr == peer.GetValue().sin_addr.s_addr);
+  REQUIRE(record.peer.sin_port == peer.GetValue().sin_port);
+  REQUIRE(record.message.GetSize() == heartbeat.GetSize());
+
+  auto first = record.timestamp;
+  REQUIRE(reader.Next(record));
+  REQUIRE(record.direction == CapturedMessage::Direction::SENT);
+  REQUIRE(record.timestamp >= first);
+
+  ChangeInputRequest replayed;
+  REQUIRE(replayed.Deserialize(record.message));
+  REQUIRE(replayed.GetId() == 9);
+  REQUIRE(replayed.GetInputMap().at(Display(1111)) == Display::Input::HDMI2);
+
+  REQUIRE(!reader.Next(record));
+  REQUIRE(reader.IsAtEnd());
+
+  writer.Close();
+  std::remove(path);
+}
+
+TEST_CASE("failure detector suspicion grows with silence and adapts to jitter", "[networking]") {
+  FailureDetector::Settings settings;
+  settings.heartbeatInterval    = std::chrono::milliseconds(100);
+  settings.minStandardDeviation = std::chrono::milliseconds(10);
+
+  auto start = FailureDetector::Clock::now();
+  auto now   = start;
+
+  FailureDetector steady(settings);
+  steady.Reset(now);
+  for(int i = 0; i < 50; i++) {
+    now += std::chrono::milliseconds(100);
+    steady.OnHeartbeat(now);
+  }
+
+  REQUIRE(steady.IsAvailable(now + std::chrono::milliseconds(100)));
+  REQUIRE(steady.GetSuspicion(now + std::chrono::milliseconds(150)) > steady.GetSuspicion(now + std::chrono::milliseconds(100)));
+  REQUIRE_FALSE(steady.IsAvailable(now + std::chrono::milliseconds(400)));
+
+  FailureDetector noisy(settings);
+  now = start;
+  noisy.Reset(now);
+  for(int i = 0; i < 50; i++) {
+    now += std::chrono::milliseconds(i % 2 == 0 ? 20 : 380);
+    noisy.OnHeartbeat(now);
+  }
+
+  REQUIRE(noisy.IsAvailable(now + std::chrono::milliseconds(400)));
+}
+
+TEST_CASE("histograms report percentiles to within a bucket", "[core]") {
+  Histogram histogram;
+  REQUIRE(histogram.GetPercentile(50) == 0);
+
+  for(uint64_t i = 1; i <= 1000; i++) {
+    histogram.Record(i);
+  }
+
+  REQUIRE(histogram.GetCount() == 1000);
+  REQUIRE(histogram.GetMin() == 1);
+  REQUIRE(histogram.GetMax() == 1000);
+  REQUIRE(histogram.GetMean() == Approx(500.5));
+  REQUIRE(histogram.GetPercentile(50) >= 500);
+  REQUIRE(histogram.GetPercentile(50) <= 500 * 1.125);
+  REQUIRE(histogram.GetPercentile(100) == 1000);
+}
+
+namespace {
+  Clock::time_point FixedTime() {
+    return Clock::time_point(std::chrono::seconds(42));
+  }
+}
+
+TEST_CASE("the clock reads from a source when one is set", "[core]") {
+  Clock::SetSource(&FixedTime);
+  REQUIRE(Clock::now() == FixedTime());
+
+  TimeSpacer spacer;
+  REQUIRE_FALSE(spacer(std::chrono::milliseconds(1)));
+
+  Clock::SetSource(nullptr);
+  REQUIRE(Clock::now() != FixedTime());
+  REQUIRE(spacer(std::chrono::milliseconds(1)));
+}
+
+TEST_CASE("slot map handles go stale when their slot is reused", "[core]") {
+  SlotMap<int> map;
+  auto first  = map.Insert(std::make_unique<int>(1));
+  auto second = map.Insert(std::make_unique<int>(2));
+  REQUIRE(map.Size() == 2);
+  REQUIRE(*map.Get(first) == 1);
+  REQUIRE(map.Find(*map.Get(second)) == second);
+
+  int* address = map.Get(second);
+  REQUIRE(map.Erase(first));
+  REQUIRE(!map.Erase(first));
+  REQUIRE(map.Get(first) == nullptr);
+  REQUIRE(map.Get(second) == address);
+
+  auto third = map.Insert(std::make_unique<int>(3));
+  REQUIRE(third.index == first.index);
+  REQUIRE(map.Get(first) == nullptr);
+  REQUIRE(*map.Get(third) == 3);
+
+  int sum = 0;
+  for(auto &value : map) {
+    sum += value;
+  }
+  REQUIRE(sum == 5);
+}
+
+TEST_CASE("rings pass values between threads in order", "[core]") {
+  SpscRing<uint64_t, 8> ring;
+  uint64_t value = 0;
+  REQUIRE(!ring.TryPop(value));
+
+  for(uint64_t i = 0; i < 8; i++) {
+    REQUIRE(ring.TryPush(std::move(i)));
+  }
+  REQUIRE(!ring.TryPush(8));
+  REQUIRE(ring.TryPop(value));
+  REQUIRE(value == 0);
+  while(ring.TryPop(value))
+  {}
+  REQUIRE(ring.IsEmpty());
+
+  const uint64_t count = 100000;
+  std::thread producer([&ring, count]() {
+    for(uint64_t i = 1; i <= count;) {
+      if(ring.TryPush(uint64_t(i))) {
+        i++;
+      }
+    }
+  });
+
+  uint64_t expected = 1;
+  bool ordered      = true;
+  while(expected <= count) {
+    if(ring.TryPop(value)) {
+      ordered = ordered && value == expected;
+      expected++;
+    }
+  }
+  producer.join();
+  REQUIRE(ordered);
+}
+
+/**
+ * Connect a socket to the given port on the loopback interface, waiting for the connection to complete.
+ */
+Socket ConnectLoopback(uint16_t port) {
+  auto address = Socket::GetAddressForHostname("127.0.0.1", port);
+  REQUIRE(address.DidSucceed());
+
+  Socket client;
+  REQUIRE(!client.Connect(address.GetValue()).has_value());
+  REQUIRE(client.GetState() == Socket::SocketState::CONNECTING);
+
+  struct ConnectHandler : public Reactor::Handler {
+    bool writable = false;
+    virtual void OnReadable() override {}
+    virtual void OnWritable() override { writable = true; }
+  } handler;
+
+  Reactor reactor;
+  REQUIRE(reactor.Initialize());
+  REQUIRE(reactor.Register(client.GetHandle(), &handler, Reactor::WRITABLE));
+  for(int i = 0; i < 10 && !handler.writable; i++) {
+    reactor.Poll(std::chrono::milliseconds(100));
+  }
+  reactor.Deregister(client.GetHandle());
+
+  REQUIRE(handler.writable);
+  REQUIRE(!client.CompleteConnect().has_value());
+  REQUIRE(client.GetState() == Socket::SocketState::CONNECTED);
+  return client;
+}
+
+TEST_CASE("back-to-back messages are separated by stream framing", "[networking]") {
+  Socket listener;
+  auto port = FindFreePort();
+  REQUIRE(!listener.Listen(port).has_value());
+
+  Socket client = ConnectLoopback(port);
+
+  Display::InputMap changes;
+  changes[Display(1111)] = Display::Input::DP1;
+
+  NetworkBuffer heartbeat, request;
+  Heartbeat().Serialize(heartbeat);
+  ChangeInputRequest(1, changes).Serialize(request);
+
+  REQUIRE(client.SendPartial(heartbeat, 0) == Socket::GetFrameSize(heartbeat));
+  REQUIRE(client.SendPartial(request, 0) == Socket::GetFrameSize(request));
+  REQUIRE(!client.SendPartial(request, Socket::GetFrameSize(request)).has_value());
+
+  // Under TCP Fast Open the handshake may be deferred until the first send, so accept only now.
+  auto server = listener.Accept();
+  REQUIRE(server.has_value());
+
+  std::vector<NetworkMessage::Type> received;
+  while(received.size() < 2 && server->Receive()) {
+    while(auto message = server->NextMessage()) {
+      NetworkMessage::Type type;
+      REQUIRE(message->Peek(type));
+      received.push_back(type);
+    }
+  }
+
+  REQUIRE(received.size() == 2);
+  REQUIRE(received[0] == static_cast<NetworkMessage::Type>(NetworkMessageType::HEARTBEAT));
+  REQUIRE(received[1] == static_cast<NetworkMessage::Type>(NetworkMessageType::CHANGE_INPUT_REQUEST));
+
+  client.Disconnect();
+  server->Disconnect();
+  listener.Disconnect();
+}
+
+
+TEST_CASE("send queues replace stale messages and shed load from peers that stop reading", "[networking]") {
+  Socket listener;
+  auto port = FindFreePort();
+  REQUIRE(!listener.Listen(port).has_value());
+
+  struct SupersededListener : public Node::Listener {
+    std::vector<ChangeInputRequest::RequestId> superseded;
+    virtual void OnMessageReceived(Node& sender, NetworkBuffer& buffer) override {}
+    virtual void OnMessageSuperseded(Node& node, NetworkBuffer& buffer) override {
+      ChangeInputRequest request;
+      if(request.Deserialize(buffer)) {
+        superseded.push_back(request.GetId());
+      }
+    }
+  } events;
+
+  Node node(ConnectLoopback(port));
+  node.AddListener(&events);
+  node.SetSendQueueCapacity(SIZE_MAX);
+
+  std::vector<Display::SerialNumber> serials(2000);
+  for(size_t i = 0; i < serials.size(); i++) {
+    serials[i] = 1000000 + i;
+  }
+  NetworkBuffer filler;
+  REQUIRE(DisplayAnnouncement(true, serials).Serialize(filler));
+
+  // The peer never reads, so the socket fills and the last message is left partly written at the front
+  // of the queue.
+  size_t fillers = 0;
+  auto fill = [&]() {
+    while(node.GetSendQueueDepth() == 0) {
+      REQUIRE(node.Send(filler));
+      fillers++;
+    }
+  };
+  fill();
+
+  auto server = listener.Accept();
+  REQUIRE(server.has_value());
+
+  NetworkBuffer heartbeat;
+  Heartbeat().Serialize(heartbeat);
+  REQUIRE(node.Send(heartbeat));
+  REQUIRE(node.Send(heartbeat));
+  REQUIRE(node.GetSendQueueDepth() == 2);
+  REQUIRE(node.GetStatistics().messagesShed == 1);
+
+  Display::InputMap first, second;
+  first[Display(1111)]  = Display::Input::DP1;
+  first[Display(2222)]  = Display::Input::DP1;
+  second[Display(1111)] = Display::Input::HDMI1;
+  second[Display(3333)] = Display::Input::HDMI2;
+
+  ChangeInputRequest older(1, first), newer(2, second);
+  older.SetFences({{1111, 5}, {2222, 6}});
+  newer.SetFences({{1111, 7}});
+
+  NetworkBuffer olderBuffer, newerBuffer;
+  REQUIRE(older.Serialize(olderBuffer));
+  REQUIRE(newer.Serialize(newerBuffer));
+  REQUIRE(node.Send(olderBuffer));
+  REQUIRE(node.Send(newerBuffer));
+  REQUIRE(node.GetSendQueueDepth() == 3);
+  REQUIRE(events.superseded == std::vector<ChangeInputRequest::RequestId>{1});
+
+  // Once the peer reads, every frame arrives whole, the partly written one included.
+  std::vector<NetworkMessage::Type> received;
+  std::optional<ChangeInputRequest> merged;
+  for(int i = 0; i < 100000 && received.size() < fillers + 2 && server->Receive(); i++) {
+    node.OnWritable();
+    while(auto message = server->NextMessage()) {
+      NetworkMessage::Type type;
+      REQUIRE(message->Peek(type));
+      received.push_back(type);
+      if(type == static_cast<NetworkMessage::Type>(NetworkMessageType::CHANGE_INPUT_REQUEST)) {
+        merged.emplace();
+        REQUIRE(merged->Deserialize(*message));
+      }
+    }
+  }
+
+  REQUIRE(received.size() == fillers + 2);
+  REQUIRE(std::count(received.begin(), received.end(), static_cast<NetworkMessage::Type>(NetworkMessageType::DISPLAY_ANNOUNCEMENT)) == fillers);
+  REQUIRE(received[fillers] == static_cast<NetworkMessage::Type>(NetworkMessageType::HEARTBEAT));
+  REQUIRE(merged.has_value());
+  REQUIRE(merged->GetId() == 2);
+  REQUIRE(merged->GetInputMap().at(Display(1111)) == Display::Input::HDMI1);
+  REQUIRE(merged->GetInputMap().at(Display(2222)) == Display::Input::DP1);
+  REQUIRE(merged->GetInputMap().at(Display(3333)) == Display::Input::HDMI2);
+  REQUIRE(merged->GetFences() == ChangeInputRequest::FenceMap{{1111, 7}, {2222, 6}});
+  REQUIRE(node.GetSendQueueDepth() == 0);
+
+  // Over capacity, queued heartbeats go first, and the peer is cut loose if that isn't enough.
+  fillers = 0;
+  fill();
+  REQUIRE(node.Send(heartbeat));
+  REQUIRE(node.GetSendQueueDepth() == 2);
+
+  node.SetSendQueueCapacity(node.GetStatistics().sendQueueBytes + Socket::GetFrameSize(newerBuffer) - 1);
+  REQUIRE(node.Send(newerBuffer));
+  REQUIRE(node.IsConnected());
+  REQUIRE(node.GetSendQueueDepth() == 2);
+
+  REQUIRE_FALSE(node.Send(filler));
+  REQUIRE_FALSE(node.IsConnected());
+
+  server->Disconnect();
+  listener.Disconnect();
 }
\ No newline at end of file
@@ -4,13 +4,14 @@ end
 
 add_requires("catch2")
 
-target("kvm")
-  set_kind("binary")
-  set_languages("cxx17")
-  add_files("src/*.cpp", "src/core/**.cpp", "src/usb/**.cpp", "src/display/**.cpp", "src/networking/**.cpp")
-  add_includedirs("$(projectdir)/include")
-  add_rules("mode.debug")
+option("io_uring")
+  set_default(false)
+  set_showmenu(true)
+  set_description("Use io_uring instead of epoll to watch sockets on Linux")
+option_end()
 
+-- Platform sources, defines and libraries shared by every target that runs on real sockets.
+function use_platform()
   if is_os("windows") then
     add_files("src/platform/windows/*.cpp")
     add_defines("KVM_OS_WINDOWS", "UNICODE")
@@ -22,6 +23,11 @@ target("kvm")
     add_files("src/platform/unix/*.cpp")
     add_packages("libusb")
     add_defines("KVM_OS_LINUX")
+    add_syslinks("pthread")
+
+    if has_config("io_uring") then
+      add_defines("KVM_USE_IO_URING")
+    end
   end
 
   if is_os("macosx") then
@@ -32,6 +38,15 @@ target("kvm")
     add_defines("KVM_OS_MAC")
     add_ldflags("-lobjc")
   end
+end
+
+target("kvm")
+  set_kind("binary")
+  set_languages("cxx17")
+  add_files("src/*.cpp", "src/core/**.cpp", "src/usb/**.cpp", "src/display/**.cpp", "src/networking/**.cpp")
+  add_includedirs("$(projectdir)/include")
+  add_rules("mode.debug")
+  use_platform()
 
 target("kvm_test")
   set_kind("binary")
@@ -40,24 +55,46 @@ target("kvm_test")
   add_includedirs("$(projectdir)/include")
   add_rules("mode.debug")
   add_packages("catch2")
+  use_platform()
+
+target("kvm_replay")
+  set_kind("binary")
+  set_languages("cxx17")
+  add_files("src/tools/replay.cpp", "src/core/**.cpp", "src/usb/**.cpp", "src/display/**.cpp", "src/networking/**.cpp")
+  add_includedirs("$(projectdir)/include")
+  add_rules("mode.debug")
+  use_platform()
 
+target("kvm_loadgen")
+  set_kind("binary")
+  set_languages("cxx17")
+  add_files("src/tools/loadgen.cpp", "src/core/**.cpp", "src/usb/**.cpp", "src/display/**.cpp", "src/networking/**.cpp")
+  add_includedirs("$(projectdir)/include")
+  add_rules("mode.debug")
+  use_platform()
+
+target("kvm_sim")
+  set_kind("binary")
+  set_languages("cxx17")
+  add_files("src/tools/sim/*.cpp", "src/core/**.cpp", "src/display/**.cpp", "src/networking/**.cpp")
+  add_includedirs("$(projectdir)/include")
+  add_rules("mode.debug")
+
+  -- Sockets, reactors and wakers come from the simulated network, so only the rest of the
+  -- platform layer is linked in.
   if is_os("windows") then
-    add_files("src/platform/windows/*.cpp")
-    add_defines("KVM_OS_WINDOWS", "UNICODE")
-    add_syslinks("gdi32", "msimg32", "user32", "Dxva2", "Setupapi", "Advapi32")
+    set_enabled(false)
   end
 
   if is_os("linux") then
-    add_files("src/platform/linux/*.cpp")
-    add_files("src/platform/unix/*.cpp")
-    add_packages("libusb")
+    add_files("src/platform/unix/datagram.cpp", "src/platform/unix/functions.cpp")
     add_defines("KVM_OS_LINUX")
+    add_syslinks("pthread")
   end
 
   if is_os("macosx") then
-    add_files("src/platform/mac/*.cpp")
-    add_files("src/platform/unix/*.cpp")
-    add_packages("libusb")
+    add_files("src/platform/mac/display.cpp", "src/platform/mac/ddc.cpp")
+    add_files("src/platform/unix/datagram.cpp", "src/platform/unix/functions.cpp")
     add_frameworks("CoreGraphics", "AppKit", "DriverKit", "IOKit", "CoreFoundation", "Foundation")
     add_defines("KVM_OS_MAC")
     add_ldflags("-lobjc")